@@ -1,6 +1,7 @@
 #pragma once
 #include "LuaAux.hpp"
 #include "Exception.hpp"
+#include "ExecutionBudget.hpp"
 
 namespace LTL
 {
@@ -67,6 +68,20 @@ namespace LTL
             return static_cast<PCallResult>(lua_pcallk(Unwrap(), n_args, n_results, i_errfunc, ctx, k));
         }
 
+        /**
+         * @brief Безопасно вызывает функцию на стеке с ограничением исполнения.
+         *
+         * @param n_args
+         * @param n_results
+         * @param budget
+         * @param i_errfunc
+         * @return PCallResult PCallResult::ERRBUDGET, если бюджет исчерпан
+         */
+        inline PCallResult PCall(int n_args, int n_results, const ExecutionBudget& budget, int i_errfunc = 0)
+        {
+            return PCallWithBudget(Unwrap(), n_args, n_results, budget, i_errfunc);
+        }
+
         inline PCallResult DoFile(const char* name)
         {
             auto res = LoadFile(name);
@@ -75,6 +90,14 @@ namespace LTL
             return PCall(0, LUA_MULTRET);
         }
 
+        inline PCallResult DoFile(const char* name, const ExecutionBudget& budget)
+        {
+            auto res = LoadFile(name);
+            if (res != PCallResult::Ok)
+                return res;
+            return PCall(0, LUA_MULTRET, budget);
+        }
+
         inline PCallResult LoadString(const char* s)
         {
             return static_cast<PCallResult>(luaL_loadstring(Unwrap(), s));
@@ -88,6 +111,14 @@ namespace LTL
             return PCall(0, LUA_MULTRET);
         }
 
+        inline PCallResult DoString(const char* s, const ExecutionBudget& budget)
+        {
+            auto res = LoadString(s);
+            if (res != PCallResult::Ok)
+                return res;
+            return PCall(0, LUA_MULTRET, budget);
+        }
+
         inline void Error()
         {
             lua_error(Unwrap());
@@ -143,6 +174,24 @@ namespace LTL
             return PCallFunction<TReturn>(Unwrap(), GlobalValue{ name }, std::forward<TArgs>(args)...);
         }
 
+        template<typename TReturn = void, typename ...TArgs>
+        PCallReturn<TReturn> PCall(const ExecutionBudget& budget, const char* name, TArgs&&... args)
+        {
+            return PCallFunctionWithBudget<TReturn>(Unwrap(), budget, GlobalValue{ name }, std::forward<TArgs>(args)...);
+        }
+
+        template<typename TReturn = void, typename Range>
+        BatchReturn<TReturn> CallBatch(const char* name, const Range& range)
+        {
+            return LTL::CallBatch<TReturn>(Unwrap(), GlobalValue{ name }, range);
+        }
+
+        template<typename TReturn = void, typename Range>
+        std::vector<PCallReturn<TReturn>> PCallBatch(const char* name, const Range& range)
+        {
+            return LTL::PCallBatch<TReturn>(Unwrap(), GlobalValue{ name }, range);
+        }
+
         void Run(const char* const s) noexcept(false)
         {
             if (DoString(s) != PCallResult::Ok)
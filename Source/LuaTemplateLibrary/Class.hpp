@@ -6,6 +6,11 @@
 #include "ClassConstructor.hpp"
 #include "Property.hpp"
 #include "StackObject.hpp"
+#include "FrozenIndex.hpp"
+#include "Operators.hpp"
+#include "ScratchPool.hpp"
+#include "DirtyTracker.hpp"
+#include <cstring>
 
 namespace LTL
 {
@@ -21,6 +26,7 @@ namespace LTL
         constexpr MetaMethodName metatable{ "__metatable" };
         constexpr MetaMethodName mode{ "__mode" };
         constexpr MetaMethodName gc{ "__gc" };
+        constexpr MetaMethodName close{ "__close" };
 
         constexpr MetaMethodName add{ "__add" };
         constexpr MetaMethodName sub{ "__sub" };
@@ -111,6 +117,72 @@ namespace LTL
         Method() = default;
     };
 
+    namespace Internal
+    {
+        template<auto fn, typename R, typename C, typename ...TArgs>
+        struct AssignMethodResult
+        {
+            static void Call(UserData<R> destination, UserData<C> object, TArgs... args)
+            {
+                static_cast<R&>(destination) = (static_cast<C&>(object).*fn)(args...);
+            }
+        };
+
+        template<auto fn, typename R, typename ...TArgs>
+        struct AssignFunctionResult
+        {
+            static void Call(UserData<R> destination, TArgs... args)
+            {
+                static_cast<R&>(destination) = fn(args...);
+            }
+        };
+
+        template<auto fn, typename ...TArgs>
+        using MethodResult_t = const_decay_t<std::invoke_result_t<decltype(fn), DeduceClass_t<fn>&, Unwrap_t<AUDVW_t<DeduceClass_t<fn>, TArgs>>...>>;
+    }
+
+    /**
+     * @brief Метод, записывающий результат в существующий объект вместо создания нового.
+     * Из Lua вызывается как destination:method(object, args...) и выполняет
+     * destination = object.fn(args...), не выделяя памяти в Lua.
+     * Приемник может совпадать с object или аргументами.
+     *
+     * @tparam fn метод класса, возвращающий значение
+     * @tparam TArgs
+     */
+    template<auto fn, typename ...TArgs>
+    class MethodInto :
+        public CFunction<
+        &Internal::AssignMethodResult<fn, Internal::MethodResult_t<fn, TArgs...>, Internal::DeduceClass_t<fn>, Unwrap_t<Internal::AUDVW_t<Internal::DeduceClass_t<fn>, TArgs>>...>::Call,
+        UserData<Internal::MethodResult_t<fn, TArgs...>>, UserData<Internal::DeduceClass_t<fn>>, Internal::AUDVW_t<Internal::DeduceClass_t<fn>, TArgs>...>,
+        public Internal::MethodBase
+    {
+    public:
+        using TClass = Class<Internal::MethodResult_t<fn, TArgs...>>;
+
+        MethodInto() = default;
+    };
+
+    /**
+     * @brief Функция, записывающая результат в объект класса R, переданный первым аргументом:
+     * destination:method(args...) выполняет destination = fn(args...).
+     * Подходит для свободных операторов вроде operator*(double, const T&).
+     *
+     * @tparam fn функция, возвращающая R
+     * @tparam R класс приемника
+     * @tparam TArgs
+     */
+    template<auto fn, typename R, typename ...TArgs>
+    class FunctionInto :
+        public CFunction<&Internal::AssignFunctionResult<fn, R, Unwrap_t<Internal::AUDVW_t<R, TArgs>>...>::Call, UserData<R>, Internal::AUDVW_t<R, TArgs>...>,
+        public Internal::MethodBase
+    {
+    public:
+        using TClass = Class<R>;
+
+        FunctionInto() = default;
+    };
+
     /**
      * @brief Класс для добавления пользовательского класса в ВМ Lua.
      * 
@@ -130,6 +202,7 @@ namespace LTL
                 //std::cout << "Assigning dtor for " << typeid(T).name() << std::endl;
                 Add(MetaMethods::gc, UData::DestructorFunction);
             }
+            Add(MetaMethods::close, UData::DestructorFunction);
             UData::MetaTable::Push(m_state);
             StackObjectView metatable{ m_state };
             metatable.RawSet(MetaMethods::metatable, true);
@@ -149,6 +222,7 @@ namespace LTL
 
         Class& AddGetter(const char* key, lua_CFunction func)
         {
+            Internal::FrozenIndex<T>::Invalidate(m_state);
             MakeIndexTable();
             UData::IndexTable::Push(m_state);
             RawSetFunction(key, func);
@@ -162,6 +236,7 @@ namespace LTL
             UData::NewIndexTable::Push(m_state);
             RawSetFunction(key, func);
             Pop();
+            DirtyTracker<T>::Update(m_state);
             return *this;
         }
 
@@ -175,12 +250,142 @@ namespace LTL
 
         Class& AddMethod(const char* name, lua_CFunction func)
         {
+            Internal::FrozenIndex<T>::Invalidate(m_state);
             UData::MethodsTable::Push(m_state);
             RawSetFunction(name, func);
             Pop();
             return *this;
         }
 
+        /**
+         * @brief Замораживает набор методов и геттеров класса.
+         * __index заменяется совершенной хеш-таблицей по адресам имен членов,
+         * что быстрее поиска по таблицам геттеров и методов.
+         * Вызывается после добавления всех членов; добавление новых снимает заморозку.
+         *
+         * @return Class&
+         */
+        Class& Finalize()
+        {
+            Internal::FrozenIndex<T>::Build(m_state);
+            return *this;
+        }
+
+        /**
+         * @brief Делает класс наследником зарегистрированного класса Base.
+         * Методы, свойства и метаметоды Base, которых нет у класса, копируются в его таблицы,
+         * а методы и свойства Base принимают объекты класса.
+         * Base должен быть зарегистрирован (и унаследован от своего предка) раньше.
+         * Если у Base разрешены произвольные поля (EnableExpando), они разрешаются и классу.
+         *
+         * @tparam Base
+         * @return Class&
+         */
+        template<typename Base>
+        Class& Inherits()
+        {
+            using BaseData = UserData<Base>;
+
+            if (BaseData::MetaTable::Push(m_state) == LUA_TNIL)
+            {
+                luaL_error(m_state, "Base class of %s wasn't registered", m_name.c_str());
+            }
+            Pop();
+
+            if (!UData::template SetBase<Base>())
+            {
+                luaL_error(m_state, "Class hierarchy of %s is deeper than %d", m_name.c_str(), static_cast<int>(Internal::ClassType::MaxDepth));
+            }
+            Internal::FrozenIndex<T>::Invalidate(m_state);
+
+            CopyMissing<typename BaseData::MethodsTable, typename UData::MethodsTable>();
+            if (BaseData::IndexTable::Push(m_state) != LUA_TNIL)
+            {
+                MakeIndexTable();
+                CopyMissing<typename BaseData::IndexTable, typename UData::IndexTable>();
+            }
+            Pop();
+            if (BaseData::NewIndexTable::Push(m_state) != LUA_TNIL)
+            {
+                MakeNewIndexTable();
+                CopyMissing<typename BaseData::NewIndexTable, typename UData::NewIndexTable>();
+            }
+            Pop();
+            CopyMissing<typename BaseData::MetaTable, typename UData::MetaTable>(true);
+
+            BaseData::MetaTable::Push(m_state);
+            const int expando = lua_rawgetp(m_state, -1, Internal::ClassType::ExpandoKey());
+            Pop(2);
+            if (expando != LUA_TNIL)
+            {
+                EnableExpando();
+            }
+            DirtyTracker<T>::Update(m_state);
+            return *this;
+        }
+
+        /**
+         * @brief Разрешает записывать в объекты класса произвольные поля из Lua.
+         * Поля хранятся в таблице, которая создается при первой записи и лежит в user value объекта,
+         * поэтому живет и собирается вместе с ним. Методы и свойства класса имеют приоритет над такими полями.
+         * Действует на объекты, созданные после вызова; ссылки на вложенные поля (AView) произвольных полей не имеют.
+         *
+         * @return Class&
+         */
+        Class& EnableExpando()
+        {
+            MakeIndexTable();
+            MakeNewIndexTable();
+            UData::MetaTable::Push(m_state);
+            lua_pushboolean(m_state, true);
+            lua_rawsetp(m_state, -2, Internal::ClassType::ExpandoKey());
+            Pop();
+            return *this;
+        }
+
+        /**
+         * @brief Регистрирует метаметоды для операторов C++, которые определены у T:
+         * арифметических, побитовых и сравнений с объектами T и с числами.
+         * Метаметоды, добавленные раньше вручную, не заменяются.
+         *
+         * @return Class&
+         */
+        Class& AddOperators()
+        {
+            Internal::Operators<T>::Register(m_state);
+            return *this;
+        }
+
+        /**
+         * @brief Добавляет пул временных объектов класса: глобальная функция acquire
+         * выдает объект из пула (или новый), метод release возвращает его обратно.
+         * Вместе с MethodInto и FunctionInto позволяет вести вычисления в цикле без выделения памяти.
+         *
+         * @param acquire имя глобальной функции
+         * @param release имя метода
+         * @return Class&
+         */
+        Class& AddScratchPool(const char* acquire, const char* release)
+        {
+            RegisterFunction(m_state, acquire, Internal::ScratchPool<T>::Acquire);
+            return AddMethod(release, Internal::ScratchPool<T>::Release);
+        }
+
+        /**
+         * @brief Включает отслеживание записей свойств класса из Lua.
+         * Каждое свойство с сеттером и каждая ссылка на поле (AView), в том числе добавленные позже,
+         * получают бит, а измененные объекты обходятся через DirtyTracker<T>::ForEachDirty.
+         * Действует на объекты, созданные после вызова.
+         *
+         * @return Class&
+         */
+        Class& EnableDirtyTracking()
+        {
+            MakeNewIndexTable();
+            DirtyTracker<T>::Enable(m_state);
+            return *this;
+        }
+
         Class& SetIndexFunction(lua_CFunction func)
         {
             return Add(MetaMethods::index, func);
@@ -266,6 +471,10 @@ namespace LTL
         {
             static_assert(std::is_same_v<T, typename Element::TClass>, "Getter must be of the same class");
             AddGetter(key, Element::Function);
+            if constexpr (std::is_base_of_v<ViewGetterBase, Element>)
+            {
+                DirtyTracker<T>::AddView(m_state, key, Element::Function);
+            }
             return *this;
         }
 
@@ -307,6 +516,53 @@ namespace LTL
             table.RawSet(name, func);
         }
 
+        /**
+         * @brief Копирует в таблицу To строковые ключи From, которых в ней нет
+         *
+         * @tparam From
+         * @tparam To
+         * @param metatable пропускать служебные метаметоды
+         */
+        template<typename From, typename To>
+        void CopyMissing(bool metatable = false)
+        {
+            From::Push(m_state);
+            const int from = lua_gettop(m_state);
+            To::Push(m_state);
+            const int to = lua_gettop(m_state);
+
+            lua_pushnil(m_state);
+            while (lua_next(m_state, from))
+            {
+                if (lua_type(m_state, -2) != LUA_TSTRING || (metatable && IsServiceMetaMethod(lua_tostring(m_state, -2))))
+                {
+                    Pop();
+                    continue;
+                }
+                lua_pushvalue(m_state, -2);
+                if (lua_rawget(m_state, to) != LUA_TNIL)
+                {
+                    Pop(2);
+                    continue;
+                }
+                Pop();
+                lua_pushvalue(m_state, -2);
+                lua_insert(m_state, -2);
+                lua_rawset(m_state, to);
+            }
+            Pop(2);
+        }
+
+        static bool IsServiceMetaMethod(const char* name)
+        {
+            for (const MetaMethodName& method : { MetaMethods::index, MetaMethods::newindex, MetaMethods::gc, MetaMethods::metatable })
+            {
+                if (std::strcmp(name, method.method) == 0)
+                    return true;
+            }
+            return std::strcmp(name, "__name") == 0;
+        }
+
         void MakeMetaTable()
         {
             if (UData::MetaTable::Push(m_state) != LUA_TNIL)
@@ -320,6 +576,8 @@ namespace LTL
             lua_newtable(m_state);
             StackObjectView methodsTable{ m_state };
             metaTable.RawSet(MetaMethods::index, methodsTable);
+            lua_pushboolean(m_state, true);
+            lua_rawsetp(m_state, -3, Internal::ClassType::MarkerKey());
             lua_setregp(m_state, UData::MethodsTable::GetKey());
             lua_setregp(m_state, UData::MetaTable::GetKey());
         }
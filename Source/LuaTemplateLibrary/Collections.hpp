@@ -0,0 +1,845 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "Types.hpp"
+#include "Libs.hpp"
+#include "NumericArray.hpp"
+#include <vector>
+#include <cmath>
+#include <cstring>
+
+namespace LTL
+{
+    /**
+     * @brief Непрерывный массив чисел Lua.
+     * Хранится в userdata, функции библиотеки collections обрабатывают его
+     * простыми циклами по памяти без обращения к ВМ.
+     * В Lua поддерживает #buffer, buffer[i] и buffer[i] = x (i от 1 до #buffer + 1).
+     */
+    class NumberBuffer
+    {
+    public:
+        NumberBuffer() = default;
+
+        explicit NumberBuffer(size_t size, lua_Number value = 0) : m_data(size, value) {}
+
+        lua_Number* Data() noexcept
+        {
+            return m_data.data();
+        }
+
+        const lua_Number* Data()const noexcept
+        {
+            return m_data.data();
+        }
+
+        size_t Size()const noexcept
+        {
+            return m_data.size();
+        }
+
+        std::vector<lua_Number>& Values() noexcept
+        {
+            return m_data;
+        }
+
+        const std::vector<lua_Number>& Values()const noexcept
+        {
+            return m_data;
+        }
+
+        /**
+         * @brief Помещает на стек новый буфер данного размера.
+         *
+         * @param l
+         * @param size
+         * @param value начальное значение элементов
+         * @return NumberBuffer*
+         */
+        static NumberBuffer* New(lua_State* l, size_t size = 0, lua_Number value = 0)
+        {
+            NumberBuffer* const buffer = new (lua_newuserdata(l, sizeof(NumberBuffer))) NumberBuffer{ size, value };
+            PushMetaTable(l);
+            lua_setmetatable(l, -2);
+            return buffer;
+        }
+
+        /**
+         * @brief Возвращает буфер по индексу на стеке или nullptr, если там не буфер.
+         *
+         * @param l
+         * @param index
+         * @return NumberBuffer*
+         */
+        static NumberBuffer* To(lua_State* l, int index)
+        {
+            if (lua_type(l, index) != LUA_TUSERDATA || !lua_getmetatable(l, index))
+                return nullptr;
+
+            const bool same = MetaTable::Push(l) == LUA_TTABLE && lua_rawequal(l, -1, -2);
+            lua_pop(l, 2);
+            return same ? static_cast<NumberBuffer*>(lua_touserdata(l, index)) : nullptr;
+        }
+
+        static NumberBuffer* Check(lua_State* l, int index)
+        {
+            NumberBuffer* const buffer = To(l, index);
+            if (buffer == nullptr)
+            {
+                luaL_typeerror(l, index, "NumberBuffer");
+            }
+            return buffer;
+        }
+
+    private:
+        struct MetaTable : public RegistryTableBase<MetaTable> {};
+
+        static void PushMetaTable(lua_State* l)
+        {
+            if (MetaTable::Push(l) != LUA_TNIL)
+                return;
+
+            lua_pop(l, 1);
+            lua_createtable(l, 0, 5);
+            lua_pushcfunction(l, GC);
+            lua_setfield(l, -2, "__gc");
+            lua_pushcfunction(l, Len);
+            lua_setfield(l, -2, "__len");
+            lua_pushcfunction(l, Index);
+            lua_setfield(l, -2, "__index");
+            lua_pushcfunction(l, NewIndex);
+            lua_setfield(l, -2, "__newindex");
+            lua_pushcfunction(l, ToString);
+            lua_setfield(l, -2, "__tostring");
+            lua_pushvalue(l, -1);
+            lua_setregp(l, MetaTable::GetKey());
+        }
+
+        static int GC(lua_State* l)
+        {
+            static_cast<NumberBuffer*>(lua_touserdata(l, 1))->~NumberBuffer();
+            return 0;
+        }
+
+        static int Len(lua_State* l)
+        {
+            lua_pushinteger(l, static_cast<lua_Integer>(Check(l, 1)->Size()));
+            return 1;
+        }
+
+        static int Index(lua_State* l)
+        {
+            const NumberBuffer* const buffer = Check(l, 1);
+            int isnum = 0;
+            const lua_Integer i = lua_tointegerx(l, 2, &isnum);
+            if (isnum && i >= 1 && static_cast<size_t>(i) <= buffer->Size())
+            {
+                lua_pushnumber(l, buffer->m_data[static_cast<size_t>(i) - 1]);
+            }
+            else
+            {
+                lua_pushnil(l);
+            }
+            return 1;
+        }
+
+        static int NewIndex(lua_State* l)
+        {
+            NumberBuffer* const buffer = Check(l, 1);
+            const lua_Integer i = luaL_checkinteger(l, 2);
+            const lua_Number value = luaL_checknumber(l, 3);
+            const size_t size = buffer->Size();
+            if (i < 1 || static_cast<size_t>(i) > size + 1)
+            {
+                return luaL_error(l, "index %I is out of range [1, %I]", i, static_cast<lua_Integer>(size + 1));
+            }
+
+            if (static_cast<size_t>(i) == size + 1)
+            {
+                buffer->m_data.push_back(value);
+            }
+            else
+            {
+                buffer->m_data[static_cast<size_t>(i) - 1] = value;
+            }
+            return 0;
+        }
+
+        static int ToString(lua_State* l)
+        {
+            lua_pushfstring(l, "NumberBuffer: %I", static_cast<lua_Integer>(Check(l, 1)->Size()));
+            return 1;
+        }
+
+        std::vector<lua_Number> m_data;
+    };
+
+    template<>
+    struct StackType<NumberBuffer*>
+    {
+        static NumberBuffer* Get(lua_State* l, int index)
+        {
+            return NumberBuffer::Check(l, index);
+        }
+
+        static bool Check(lua_State* l, int index)
+        {
+            return NumberBuffer::To(l, index) != nullptr;
+        }
+    };
+
+    /// @brief Размер NumberView, известный только во время выполнения
+    inline constexpr size_t DynamicExtent = static_cast<size_t>(-1);
+
+    /**
+     * @brief Представление непрерывного массива чисел без копирования, аналог std::span для C++17.
+     * Как аргумент CFunction указывает на данные NumberBuffer и действительно,
+     * пока буфер не собран сборщиком мусора и не изменил размер, например, на время вызова.
+     * Помещается на стек как новая таблица.
+     *
+     * @tparam T lua_Number или const lua_Number
+     * @tparam Extent число элементов или DynamicExtent
+     */
+    template<typename T, size_t Extent = DynamicExtent>
+    class NumberView
+    {
+    public:
+        static_assert(std::is_same_v<std::remove_const_t<T>, lua_Number>, "NumberView holds lua_Number");
+
+        constexpr NumberView() noexcept = default;
+
+        constexpr NumberView(T* data, size_t size) noexcept : m_data{ data }, m_size{ size } {}
+
+        constexpr T* data()const noexcept
+        {
+            return m_data;
+        }
+
+        constexpr size_t size()const noexcept
+        {
+            return m_size;
+        }
+
+        constexpr bool empty()const noexcept
+        {
+            return m_size == 0;
+        }
+
+        constexpr T& operator[](size_t i)const noexcept
+        {
+            return m_data[i];
+        }
+
+        constexpr T* begin()const noexcept
+        {
+            return m_data;
+        }
+
+        constexpr T* end()const noexcept
+        {
+            return m_data + m_size;
+        }
+
+    private:
+        T* m_data = nullptr;
+        size_t m_size = 0;
+    };
+
+    template<typename T, size_t Extent>
+    struct StackType<NumberView<T, Extent>>
+    {
+        using Type = NumberView<T, Extent>;
+
+        static Type Get(lua_State* l, int index)
+        {
+            NumberBuffer* const buffer = NumberBuffer::Check(l, index);
+            if constexpr (Extent != DynamicExtent)
+            {
+                if (buffer->Size() != Extent)
+                {
+                    luaL_error(l, "expected NumberBuffer of %I elements but got %I", static_cast<lua_Integer>(Extent), static_cast<lua_Integer>(buffer->Size()));
+                }
+            }
+            return Type{ buffer->Data(), buffer->Size() };
+        }
+
+        static bool Check(lua_State* l, int index)
+        {
+            const NumberBuffer* const buffer = NumberBuffer::To(l, index);
+            return buffer != nullptr && (Extent == DynamicExtent || buffer->Size() == Extent);
+        }
+
+        static void Push(lua_State* l, const Type& value)
+        {
+            Internal::NumericArray<lua_Number>::Push(l, value.data(), value.size());
+        }
+    };
+
+    namespace Internal
+    {
+        /**
+         * @brief Циклы над непрерывными массивами чисел.
+         * Тела циклов не обращаются к ВМ и не имеют зависимостей между итерациями,
+         * поэтому компилятор может их векторизовать.
+         */
+        struct NumberKernels
+        {
+            template<typename F>
+            static void Transform(const lua_Number* in, lua_Number* out, size_t n, F f)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    out[i] = f(in[i]);
+                }
+            }
+
+            /**
+             * @brief Копирует в out элементы, удовлетворяющие условию, без ветвлений.
+             * Размер out должен быть не меньше n.
+             *
+             * @return size_t число скопированных элементов
+             */
+            template<typename F>
+            static size_t Compact(const lua_Number* in, lua_Number* out, size_t n, F pred)
+            {
+                size_t k = 0;
+                for (size_t i = 0; i < n; i++)
+                {
+                    out[k] = in[i];
+                    k += pred(in[i]) ? 1 : 0;
+                }
+                return k;
+            }
+
+            /**
+             * @brief Свертка с четырьмя независимыми накопителями.
+             *
+             * @param identity нейтральный элемент операции
+             */
+            template<typename F>
+            static lua_Number Reduce(const lua_Number* in, size_t n, lua_Number identity, F f)
+            {
+                lua_Number acc[4] = { identity, identity, identity, identity };
+                size_t i = 0;
+                for (; i + 4 <= n; i += 4)
+                {
+                    acc[0] = f(acc[0], in[i]);
+                    acc[1] = f(acc[1], in[i + 1]);
+                    acc[2] = f(acc[2], in[i + 2]);
+                    acc[3] = f(acc[3], in[i + 3]);
+                }
+                lua_Number result = f(f(acc[0], acc[1]), f(acc[2], acc[3]));
+                for (; i < n; i++)
+                {
+                    result = f(result, in[i]);
+                }
+                return result;
+            }
+
+            static lua_Number Dot(const lua_Number* a, const lua_Number* b, size_t n)
+            {
+                lua_Number acc[4] = {};
+                size_t i = 0;
+                for (; i + 4 <= n; i += 4)
+                {
+                    acc[0] += a[i] * b[i];
+                    acc[1] += a[i + 1] * b[i + 1];
+                    acc[2] += a[i + 2] * b[i + 2];
+                    acc[3] += a[i + 3] * b[i + 3];
+                }
+                lua_Number result = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+                for (; i < n; i++)
+                {
+                    result += a[i] * b[i];
+                }
+                return result;
+            }
+
+            static void Axpy(lua_Number alpha, const lua_Number* x, lua_Number* y, size_t n)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    y[i] += alpha * x[i];
+                }
+            }
+        };
+
+        /**
+         * @brief Реализация библиотеки collections.
+         * Аргументами служат NumberBuffer или массивы-таблицы.
+         * Встроенные операции задаются именем и требуют чисел,
+         * функции Lua вызываются для каждого элемента и принимают любые значения таблиц.
+         * Результат имеет тот же вид, что и исходный массив.
+         */
+        struct CollectionsLib
+        {
+            static constexpr const char* MapOps[] = {
+                "neg", "abs", "sqrt", "floor", "ceil", "exp", "log",
+                "add", "sub", "mul", "div", "pow", "min", "max",
+                nullptr
+            };
+            static constexpr int MapUnaryOpsCount = 7;
+
+            static constexpr const char* FilterOps[] = { "lt", "le", "gt", "ge", "eq", "ne", nullptr };
+
+            static constexpr const char* ReduceOps[] = { "add", "mul", "min", "max", nullptr };
+
+            /**
+             * @brief Массив чисел, полученный из аргумента.
+             */
+            struct Numbers
+            {
+                const lua_Number* data;
+                size_t size;
+                bool isBuffer;
+            };
+
+            /**
+             * @brief Возвращает числа аргумента. Таблица копируется во временный
+             * NumberBuffer на вершине стека, чтобы память освободилась при ошибке.
+             *
+             * @param l
+             * @param index
+             * @return Numbers
+             */
+            static Numbers ToNumbers(lua_State* l, int index)
+            {
+                if (const NumberBuffer* const buffer = NumberBuffer::To(l, index))
+                {
+                    return { buffer->Data(), buffer->Size(), true };
+                }
+
+                luaL_checktype(l, index, LUA_TTABLE);
+                index = lua_absindex(l, index);
+                const size_t n = static_cast<size_t>(lua_rawlen(l, index));
+                NumberBuffer* const copy = NumberBuffer::New(l, n);
+                lua_Number* const data = copy->Data();
+                for (size_t i = 0; i < n; i++)
+                {
+                    int isnum = 0;
+                    lua_rawgeti(l, index, static_cast<lua_Integer>(i + 1));
+                    data[i] = lua_tonumberx(l, -1, &isnum);
+                    lua_pop(l, 1);
+                    if (!isnum)
+                    {
+                        luaL_error(l, "array element %I is not a number", static_cast<lua_Integer>(i + 1));
+                    }
+                }
+                return { data, n, false };
+            }
+
+            /**
+             * @brief Заменяет буфер на вершине стека таблицей с его элементами.
+             *
+             * @param l
+             */
+            static void BufferToTable(lua_State* l)
+            {
+                const NumberBuffer* const buffer = static_cast<const NumberBuffer*>(lua_touserdata(l, -1));
+                const size_t n = buffer->Size();
+                lua_createtable(l, static_cast<int>(n), 0);
+                for (size_t i = 0; i < n; i++)
+                {
+                    lua_pushnumber(l, buffer->Data()[i]);
+                    lua_rawseti(l, -2, static_cast<lua_Integer>(i + 1));
+                }
+                lua_remove(l, -2);
+            }
+
+            /**
+             * @brief Возвращает длину массива: буфера или таблицы.
+             */
+            static size_t Length(lua_State* l, int index)
+            {
+                if (const NumberBuffer* const buffer = NumberBuffer::To(l, index))
+                {
+                    return buffer->Size();
+                }
+                luaL_checktype(l, index, LUA_TTABLE);
+                return static_cast<size_t>(lua_rawlen(l, index));
+            }
+
+            /**
+             * @brief Помещает на стек i-й элемент массива, начиная с 1.
+             */
+            static void PushElement(lua_State* l, int index, const NumberBuffer* buffer, lua_Integer i)
+            {
+                if (buffer)
+                {
+                    if (static_cast<size_t>(i) <= buffer->Size())
+                    {
+                        lua_pushnumber(l, buffer->Data()[i - 1]);
+                    }
+                    else
+                    {
+                        lua_pushnil(l);
+                    }
+                }
+                else
+                {
+                    lua_rawgeti(l, index, i);
+                }
+            }
+
+            static lua_Number CheckResultNumber(lua_State* l, const char* name)
+            {
+                int isnum = 0;
+                const lua_Number value = lua_tonumberx(l, -1, &isnum);
+                if (!isnum)
+                {
+                    luaL_error(l, "'%s' callback must return a number for NumberBuffer", name);
+                }
+                lua_pop(l, 1);
+                return value;
+            }
+
+            /**
+             * @brief collections.buffer(n [, value]) или collections.buffer(array)
+             */
+            static int Buffer(lua_State* l)
+            {
+                if (lua_isinteger(l, 1))
+                {
+                    const lua_Integer n = lua_tointeger(l, 1);
+                    luaL_argcheck(l, n >= 0, 1, "size must be non-negative");
+                    NumberBuffer::New(l, static_cast<size_t>(n), luaL_optnumber(l, 2, 0));
+                    return 1;
+                }
+
+                const Numbers numbers = ToNumbers(l, 1);
+                if (numbers.isBuffer)
+                {
+                    NumberBuffer* const copy = NumberBuffer::New(l, numbers.size);
+                    if (numbers.size)
+                    {
+                        std::memcpy(copy->Data(), numbers.data, numbers.size * sizeof(lua_Number));
+                    }
+                }
+                return 1;
+            }
+
+            /**
+             * @brief collections.totable(buffer)
+             */
+            static int ToTable(lua_State* l)
+            {
+                NumberBuffer::Check(l, 1);
+                lua_settop(l, 1);
+                BufferToTable(l);
+                return 1;
+            }
+
+            /**
+             * @brief collections.map(array, op [, scalar]) или collections.map(array, function(x, i) end)
+             */
+            static int Map(lua_State* l)
+            {
+                if (lua_isfunction(l, 2))
+                {
+                    return MapCallback(l);
+                }
+
+                const int op = luaL_checkoption(l, 2, nullptr, MapOps);
+                const lua_Number s = op < MapUnaryOpsCount ? 0 : luaL_checknumber(l, 3);
+                const Numbers in = ToNumbers(l, 1);
+                lua_Number* const out = NumberBuffer::New(l, in.size)->Data();
+                const size_t n = in.size;
+
+                using K = NumberKernels;
+                switch (op)
+                {
+                case 0: K::Transform(in.data, out, n, [](lua_Number x) { return -x; }); break;
+                case 1: K::Transform(in.data, out, n, [](lua_Number x) { return std::fabs(x); }); break;
+                case 2: K::Transform(in.data, out, n, [](lua_Number x) { return std::sqrt(x); }); break;
+                case 3: K::Transform(in.data, out, n, [](lua_Number x) { return std::floor(x); }); break;
+                case 4: K::Transform(in.data, out, n, [](lua_Number x) { return std::ceil(x); }); break;
+                case 5: K::Transform(in.data, out, n, [](lua_Number x) { return std::exp(x); }); break;
+                case 6: K::Transform(in.data, out, n, [](lua_Number x) { return std::log(x); }); break;
+                case 7: K::Transform(in.data, out, n, [s](lua_Number x) { return x + s; }); break;
+                case 8: K::Transform(in.data, out, n, [s](lua_Number x) { return x - s; }); break;
+                case 9: K::Transform(in.data, out, n, [s](lua_Number x) { return x * s; }); break;
+                case 10: K::Transform(in.data, out, n, [s](lua_Number x) { return x / s; }); break;
+                case 11: K::Transform(in.data, out, n, [s](lua_Number x) { return std::pow(x, s); }); break;
+                case 12: K::Transform(in.data, out, n, [s](lua_Number x) { return x < s ? x : s; }); break;
+                case 13: K::Transform(in.data, out, n, [s](lua_Number x) { return x > s ? x : s; }); break;
+                }
+
+                if (!in.isBuffer)
+                {
+                    BufferToTable(l);
+                }
+                return 1;
+            }
+
+            /**
+             * @brief collections.filter(array, op, scalar) или collections.filter(array, function(x, i) end)
+             */
+            static int Filter(lua_State* l)
+            {
+                if (lua_isfunction(l, 2))
+                {
+                    return FilterCallback(l);
+                }
+
+                const int op = luaL_checkoption(l, 2, nullptr, FilterOps);
+                const lua_Number s = luaL_checknumber(l, 3);
+                const Numbers in = ToNumbers(l, 1);
+                NumberBuffer* const result = NumberBuffer::New(l, in.size);
+                lua_Number* const out = result->Data();
+                const size_t n = in.size;
+
+                using K = NumberKernels;
+                size_t count = 0;
+                switch (op)
+                {
+                case 0: count = K::Compact(in.data, out, n, [s](lua_Number x) { return x < s; }); break;
+                case 1: count = K::Compact(in.data, out, n, [s](lua_Number x) { return x <= s; }); break;
+                case 2: count = K::Compact(in.data, out, n, [s](lua_Number x) { return x > s; }); break;
+                case 3: count = K::Compact(in.data, out, n, [s](lua_Number x) { return x >= s; }); break;
+                case 4: count = K::Compact(in.data, out, n, [s](lua_Number x) { return x == s; }); break;
+                case 5: count = K::Compact(in.data, out, n, [s](lua_Number x) { return x != s; }); break;
+                }
+                result->Values().resize(count);
+
+                if (!in.isBuffer)
+                {
+                    BufferToTable(l);
+                }
+                return 1;
+            }
+
+            /**
+             * @brief collections.reduce(array, op [, init]) или collections.reduce(array, function(acc, x, i) end [, init])
+             * Без init для функции начальным значением служит первый элемент.
+             */
+            static int Reduce(lua_State* l)
+            {
+                if (lua_isfunction(l, 2))
+                {
+                    return ReduceCallback(l);
+                }
+
+                static constexpr lua_Number identities[] = { 0, 1, HUGE_VAL, -HUGE_VAL };
+                const int op = luaL_checkoption(l, 2, nullptr, ReduceOps);
+                const lua_Number init = luaL_optnumber(l, 3, identities[op]);
+                const Numbers in = ToNumbers(l, 1);
+
+                using K = NumberKernels;
+                lua_Number result = 0;
+                switch (op)
+                {
+                case 0:
+                    result = init + K::Reduce(in.data, in.size, 0, [](lua_Number a, lua_Number b) { return a + b; });
+                    break;
+                case 1:
+                    result = init * K::Reduce(in.data, in.size, 1, [](lua_Number a, lua_Number b) { return a * b; });
+                    break;
+                case 2:
+                    result = K::Reduce(in.data, in.size, init, [](lua_Number a, lua_Number b) { return b < a ? b : a; });
+                    break;
+                case 3:
+                    result = K::Reduce(in.data, in.size, init, [](lua_Number a, lua_Number b) { return b > a ? b : a; });
+                    break;
+                }
+                lua_pushnumber(l, result);
+                return 1;
+            }
+
+            /**
+             * @brief collections.sum(array)
+             */
+            static int Sum(lua_State* l)
+            {
+                const Numbers in = ToNumbers(l, 1);
+                lua_pushnumber(l, NumberKernels::Reduce(in.data, in.size, 0, [](lua_Number a, lua_Number b) { return a + b; }));
+                return 1;
+            }
+
+            /**
+             * @brief collections.dot(a, b)
+             */
+            static int Dot(lua_State* l)
+            {
+                // ToNumbers кладет копию таблицы на вершину, она не должна занять место аргумента
+                luaL_checkany(l, 2);
+                lua_settop(l, 2);
+                const Numbers a = ToNumbers(l, 1);
+                const Numbers b = ToNumbers(l, 2);
+                if (a.size != b.size)
+                {
+                    return luaL_error(l, "arrays have different length: %I and %I", static_cast<lua_Integer>(a.size), static_cast<lua_Integer>(b.size));
+                }
+                lua_pushnumber(l, NumberKernels::Dot(a.data, b.data, a.size));
+                return 1;
+            }
+
+            /**
+             * @brief collections.axpy(alpha, x, y): y = alpha * x + y на месте, возвращает y.
+             */
+            static int Axpy(lua_State* l)
+            {
+                const lua_Number alpha = luaL_checknumber(l, 1);
+                luaL_checkany(l, 3);
+                lua_settop(l, 3);
+                const Numbers x = ToNumbers(l, 2);
+                NumberBuffer* const y = NumberBuffer::To(l, 3);
+                if (y)
+                {
+                    if (x.size != y->Size())
+                    {
+                        return luaL_error(l, "arrays have different length: %I and %I", static_cast<lua_Integer>(x.size), static_cast<lua_Integer>(y->Size()));
+                    }
+                    NumberKernels::Axpy(alpha, x.data, y->Data(), x.size);
+                    lua_pushvalue(l, 3);
+                    return 1;
+                }
+
+                const Numbers ynumbers = ToNumbers(l, 3);
+                if (x.size != ynumbers.size)
+                {
+                    return luaL_error(l, "arrays have different length: %I and %I", static_cast<lua_Integer>(x.size), static_cast<lua_Integer>(ynumbers.size));
+                }
+                lua_Number* const data = static_cast<NumberBuffer*>(lua_touserdata(l, -1))->Data();
+                NumberKernels::Axpy(alpha, x.data, data, x.size);
+                for (size_t i = 0; i < x.size; i++)
+                {
+                    lua_pushnumber(l, data[i]);
+                    lua_rawseti(l, 3, static_cast<lua_Integer>(i + 1));
+                }
+                lua_pushvalue(l, 3);
+                return 1;
+            }
+
+        private:
+            static int MapCallback(lua_State* l)
+            {
+                const NumberBuffer* const buffer = NumberBuffer::To(l, 1);
+                const size_t n = Length(l, 1);
+                if (buffer)
+                {
+                    NumberBuffer* const result = NumberBuffer::New(l, n);
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        lua_pushvalue(l, 2);
+                        PushElement(l, 1, buffer, static_cast<lua_Integer>(i + 1));
+                        lua_pushinteger(l, static_cast<lua_Integer>(i + 1));
+                        lua_call(l, 2, 1);
+                        result->Data()[i] = CheckResultNumber(l, "map");
+                    }
+                    return 1;
+                }
+
+                lua_createtable(l, static_cast<int>(n), 0);
+                for (size_t i = 0; i < n; i++)
+                {
+                    lua_pushvalue(l, 2);
+                    PushElement(l, 1, nullptr, static_cast<lua_Integer>(i + 1));
+                    lua_pushinteger(l, static_cast<lua_Integer>(i + 1));
+                    lua_call(l, 2, 1);
+                    lua_rawseti(l, -2, static_cast<lua_Integer>(i + 1));
+                }
+                return 1;
+            }
+
+            static int FilterCallback(lua_State* l)
+            {
+                const NumberBuffer* const buffer = NumberBuffer::To(l, 1);
+                const size_t n = Length(l, 1);
+                NumberBuffer* const result = buffer ? NumberBuffer::New(l) : nullptr;
+                if (!buffer)
+                {
+                    lua_createtable(l, 0, 0);
+                }
+                const int out = lua_gettop(l);
+
+                lua_Integer count = 0;
+                for (size_t i = 0; i < n; i++)
+                {
+                    const lua_Integer index = static_cast<lua_Integer>(i + 1);
+                    PushElement(l, 1, buffer, index);
+                    lua_pushvalue(l, 2);
+                    lua_pushvalue(l, -2);
+                    lua_pushinteger(l, index);
+                    lua_call(l, 2, 1);
+                    const bool keep = lua_toboolean(l, -1);
+                    lua_pop(l, 1);
+                    if (!keep)
+                    {
+                        lua_pop(l, 1);
+                    }
+                    else if (result)
+                    {
+                        result->Values().push_back(lua_tonumber(l, -1));
+                        lua_pop(l, 1);
+                    }
+                    else
+                    {
+                        lua_rawseti(l, out, ++count);
+                    }
+                }
+                return 1;
+            }
+
+            static int ReduceCallback(lua_State* l)
+            {
+                const NumberBuffer* const buffer = NumberBuffer::To(l, 1);
+                const size_t n = Length(l, 1);
+                size_t first = 0;
+                if (lua_isnoneornil(l, 3))
+                {
+                    if (n == 0)
+                    {
+                        return luaL_error(l, "reduce of empty array with no initial value");
+                    }
+                    PushElement(l, 1, buffer, 1);
+                    first = 1;
+                }
+                else
+                {
+                    lua_pushvalue(l, 3);
+                }
+
+                for (size_t i = first; i < n; i++)
+                {
+                    const lua_Integer index = static_cast<lua_Integer>(i + 1);
+                    lua_pushvalue(l, 2);
+                    lua_insert(l, -2);
+                    PushElement(l, 1, buffer, index);
+                    lua_pushinteger(l, index);
+                    lua_call(l, 3, 1);
+                }
+                return 1;
+            }
+        };
+
+        inline int OpenCollectionsLib(lua_State* l)
+        {
+            lua_createtable(l, 0, 8);
+            lua_pushcfunction(l, CollectionsLib::Buffer);
+            lua_setfield(l, -2, "buffer");
+            lua_pushcfunction(l, CollectionsLib::ToTable);
+            lua_setfield(l, -2, "totable");
+            lua_pushcfunction(l, CollectionsLib::Map);
+            lua_setfield(l, -2, "map");
+            lua_pushcfunction(l, CollectionsLib::Filter);
+            lua_setfield(l, -2, "filter");
+            lua_pushcfunction(l, CollectionsLib::Reduce);
+            lua_setfield(l, -2, "reduce");
+            lua_pushcfunction(l, CollectionsLib::Sum);
+            lua_setfield(l, -2, "sum");
+            lua_pushcfunction(l, CollectionsLib::Dot);
+            lua_setfield(l, -2, "dot");
+            lua_pushcfunction(l, CollectionsLib::Axpy);
+            lua_setfield(l, -2, "axpy");
+            return 1;
+        }
+    }
+
+    namespace Libs
+    {
+        /**
+         * @brief Библиотека collections: buffer, totable, map, filter, reduce, sum, dot и axpy
+         *
+         */
+        constexpr Lib collections{ "collections", Internal::OpenCollectionsLib };
+    }
+}
@@ -0,0 +1,297 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "Types.hpp"
+#include "StackObject.hpp"
+#include "UserData.hpp"
+#include <unordered_map>
+#include <unordered_set>
+
+namespace LTL
+{
+    /**
+     * @brief Политика копирования userdata, запрещающая копирование.
+     */
+    struct RejectUserData
+    {
+        static bool Copy(lua_State*, int, lua_State*)
+        {
+            return false;
+        }
+    };
+
+    /**
+     * @brief Политика копирования userdata, создающая копии объектов
+     * перечисленных пользовательских типов.
+     * Классы должны быть зарегистрированы в обоих состояниях.
+     *
+     * @tparam Ts пользовательские типы
+     */
+    template<typename ...Ts>
+    struct CopyUserData
+    {
+        static bool Copy(lua_State* from, int index, lua_State* to)
+        {
+            return (TryCopy<Ts>(from, index, to) || ...);
+        }
+
+    private:
+        template<typename T>
+        static bool TryCopy(lua_State* from, int index, lua_State* to)
+        {
+            if (!UserData<T>::IsUserData(from, index))
+                return false;
+            UserData<T>::PushCopy(to, *UserData<T>::ValidateUserData(from, index));
+            return true;
+        }
+    };
+
+    namespace Internal
+    {
+        /// @brief Максимальная вложенность копируемых таблиц
+        constexpr int CopyMaxDepth = 200;
+
+        /**
+         * @brief Обходит значение в одном состоянии и создает его копию в другом.
+         *
+         * @tparam UserDataPolicy политика копирования userdata
+         * @tparam Shared сохранять ли общие подтаблицы общими в копии
+         */
+        template<typename UserDataPolicy, bool Shared>
+        class ValueCopier
+        {
+        public:
+            ValueCopier(lua_State* from, lua_State* to) : m_from(from), m_to(to)
+            {
+                if constexpr (Shared)
+                {
+                    lua_createtable(m_to, 0, 0);
+                    m_copies_index = lua_gettop(m_to);
+                }
+            }
+
+            bool Copy(int index)
+            {
+                lua_State* const from = m_from;
+                lua_State* const to = m_to;
+                index = lua_absindex(from, index);
+
+                switch (lua_type(from, index))
+                {
+                case LUA_TNIL:
+                    lua_pushnil(to);
+                    return true;
+                case LUA_TBOOLEAN:
+                    lua_pushboolean(to, lua_toboolean(from, index));
+                    return true;
+                case LUA_TNUMBER:
+                    if (lua_isinteger(from, index))
+                    {
+                        lua_pushinteger(to, lua_tointeger(from, index));
+                    }
+                    else
+                    {
+                        lua_pushnumber(to, lua_tonumber(from, index));
+                    }
+                    return true;
+                case LUA_TSTRING:
+                {
+                    size_t len = 0;
+                    const char* s = lua_tolstring(from, index, &len);
+                    lua_pushlstring(to, s, len);
+                    return true;
+                }
+                case LUA_TLIGHTUSERDATA:
+                    lua_pushlightuserdata(to, lua_touserdata(from, index));
+                    return true;
+                case LUA_TTABLE:
+                    return CopyTable(index);
+                case LUA_TFUNCTION:
+                    return CopyFunction(index);
+                case LUA_TUSERDATA:
+                    if (UserDataPolicy::Copy(from, index, to))
+                        return true;
+                    return Fail("can't copy userdata");
+                default:
+                    return Fail("can't copy value of this type");
+                }
+            }
+
+            /**
+             * @brief Удаляет служебные данные со стека целевого состояния,
+             * оставляя копию на вершине.
+             */
+            void Finish()
+            {
+                if constexpr (Shared)
+                {
+                    lua_remove(m_to, m_copies_index);
+                }
+            }
+
+            const char* Error()const noexcept
+            {
+                return m_error;
+            }
+
+        private:
+            bool Fail(const char* error)
+            {
+                m_error = error;
+                return false;
+            }
+
+            bool CopyFunction(int index)
+            {
+                const lua_CFunction func = lua_tocfunction(m_from, index);
+                if (func == nullptr)
+                    return Fail("can't copy Lua function");
+                if (lua_getupvalue(m_from, index, 1) != nullptr)
+                {
+                    lua_pop(m_from, 1);
+                    return Fail("can't copy C closure with upvalues");
+                }
+                lua_pushcfunction(m_to, func);
+                return true;
+            }
+
+            bool CopyTable(int index)
+            {
+                lua_State* const from = m_from;
+                lua_State* const to = m_to;
+                const void* const source = lua_topointer(from, index);
+
+                if constexpr (Shared)
+                {
+                    const auto [it, inserted] = m_copies.try_emplace(source, static_cast<lua_Integer>(m_copies.size() + 1));
+                    if (!inserted)
+                    {
+                        lua_rawgeti(to, m_copies_index, it->second);
+                        return true;
+                    }
+                }
+                else
+                {
+                    if (!m_path.insert(source).second)
+                        return Fail("can't copy table with cycles");
+                }
+
+                if (m_depth >= CopyMaxDepth || !lua_checkstack(from, 3) || !lua_checkstack(to, 4))
+                    return Fail("table nesting is too deep");
+                m_depth++;
+
+                const lua_Integer narr = static_cast<lua_Integer>(lua_rawlen(from, index));
+                lua_createtable(to, static_cast<int>(narr), 0);
+                const int target = lua_gettop(to);
+
+                if constexpr (Shared)
+                {
+                    lua_pushvalue(to, target);
+                    lua_rawseti(to, m_copies_index, m_copies[source]);
+                }
+
+                for (lua_Integer i = 1; i <= narr; i++)
+                {
+                    lua_rawgeti(from, index, i);
+                    if (!Copy(-1))
+                        return false;
+                    lua_rawseti(to, target, i);
+                    lua_pop(from, 1);
+                }
+
+                lua_pushnil(from);
+                while (lua_next(from, index))
+                {
+                    if (lua_isinteger(from, -2))
+                    {
+                        const lua_Integer key = lua_tointeger(from, -2);
+                        if (key >= 1 && key <= narr)
+                        {
+                            lua_pop(from, 1);
+                            continue;
+                        }
+                    }
+                    const int key_index = lua_absindex(from, -2);
+                    if (!Copy(key_index) || !Copy(key_index + 1))
+                        return false;
+                    lua_rawset(to, target);
+                    lua_pop(from, 1);
+                }
+
+                if constexpr (!Shared)
+                {
+                    m_path.erase(source);
+                }
+                m_depth--;
+                return true;
+            }
+
+            lua_State* const m_from;
+            lua_State* const m_to;
+            int m_copies_index = 0;
+            int m_depth = 0;
+            std::unordered_map<const void*, lua_Integer> m_copies;
+            std::unordered_set<const void*> m_path;
+            const char* m_error = nullptr;
+        };
+
+        template<typename UserDataPolicy, bool Shared>
+        void CopyValue(const StackObjectView& from, lua_State* to)
+        {
+            lua_State* const l = from.GetState();
+            const int from_top = lua_gettop(l);
+            const int to_top = lua_gettop(to);
+            const char* error = nullptr;
+            {
+                ValueCopier<UserDataPolicy, Shared> copier{ l, to };
+                if (copier.Copy(from.GetIndex()))
+                {
+                    copier.Finish();
+                }
+                else
+                {
+                    error = copier.Error();
+                }
+            }
+            lua_settop(l, from_top);
+            if (error)
+            {
+                lua_settop(to, to_top);
+                luaL_error(l, "%s", error);
+            }
+        }
+    }
+
+    /**
+     * @brief Создает копию значения в другом состоянии и помещает ее на стек to
+     * без промежуточного преобразования в типы C++.
+     * Повторяющиеся подтаблицы копируются отдельно, циклы приводят к ошибке.
+     * Метатаблицы не копируются.
+     *
+     * @tparam UserDataPolicy политика копирования userdata
+     * @param from копируемое значение
+     * @param to целевое состояние
+     * @return StackObjectView копия на стеке to
+     */
+    template<typename UserDataPolicy = RejectUserData>
+    StackObjectView CopyValue(const StackObjectView& from, lua_State* to)
+    {
+        Internal::CopyValue<UserDataPolicy, false>(from, to);
+        return { to };
+    }
+
+    /**
+     * @brief Создает копию значения в другом состоянии, сохраняя общие подтаблицы
+     * и циклы: каждая исходная таблица копируется ровно один раз.
+     *
+     * @tparam UserDataPolicy политика копирования userdata
+     * @param from копируемое значение
+     * @param to целевое состояние
+     * @return StackObjectView копия на стеке to
+     */
+    template<typename UserDataPolicy = RejectUserData>
+    StackObjectView CopyValueShared(const StackObjectView& from, lua_State* to)
+    {
+        Internal::CopyValue<UserDataPolicy, true>(from, to);
+        return { to };
+    }
+}
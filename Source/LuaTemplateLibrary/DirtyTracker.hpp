@@ -0,0 +1,332 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "UserData.hpp"
+#include <cstdint>
+
+namespace LTL
+{
+    /**
+     * @brief Отслеживание записей свойств класса T из Lua.
+     * Каждое свойство с сеттером и каждая ссылка на поле (AView) получают свой бит.
+     * Маска измененных свойств хранится словом в памяти самого объекта после T,
+     * поэтому запись свойства через __newindex только добавляет бит в это слово.
+     * Объект попадает в общий для класса список измененных при первой отметке,
+     * так что C++ обходит только измененные объекты и поля, а не все объекты.
+     * Запись через ссылку на поле отмечает объект-владелец битом этой ссылки,
+     * в том числе через вложенные ссылки: obj.transform.pos.x = 1 отмечает obj битом transform.
+     * Слово маски есть только у объектов, созданных после включения отслеживания.
+     * Список удерживает объекты до ForEachDirty или Clear.
+     * Включается Class<T>::EnableDirtyTracking.
+     *
+     * @tparam T класс
+     */
+    template<typename T>
+    struct DirtyTracker
+    {
+        using UData = UserData<T>;
+
+        /// @brief Наибольшее число отслеживаемых свойств
+        static constexpr lua_Integer MaxProperties = 64;
+
+        /**
+         * @brief Включает отслеживание и назначает биты свойствам, у которых их еще нет.
+         * Требует существующей таблицы сеттеров класса.
+         *
+         * @param l
+         */
+        static void Enable(lua_State* l)
+        {
+            if (BitsTable::Push(l) == LUA_TNIL)
+            {
+                lua_pop(l, 1);
+                lua_newtable(l);
+                lua_setregp(l, BitsTable::GetKey());
+                lua_newtable(l);
+                lua_setregp(l, ViewBitsTable::GetKey());
+                NewDirtyList(l);
+
+                UData::MetaTable::Push(l);
+                lua_pushboolean(l, true);
+                lua_rawsetp(l, -2, Internal::ClassType::DirtyKey());
+                BitsTable::Push(l);
+                lua_pushcclosure(l, NewIndexFunction, 1);
+                lua_setfield(l, -2, "__newindex");
+            }
+            lua_pop(l, 1);
+            Update(l);
+        }
+
+        /**
+         * @brief Запоминает ссылку на поле getter с именем name, чтобы запись через нее
+         * отмечала владельца. Вызывается при регистрации AView класса.
+         *
+         * @param l
+         * @param name
+         * @param getter
+         */
+        static void AddView(lua_State* l, const char* name, lua_CFunction getter)
+        {
+            if (ViewNamesTable::Push(l) == LUA_TNIL)
+            {
+                lua_pop(l, 1);
+                lua_newtable(l);
+                lua_pushvalue(l, -1);
+                lua_setregp(l, ViewNamesTable::GetKey());
+            }
+            lua_pushcfunction(l, getter);
+            lua_pushstring(l, name);
+            lua_rawset(l, -3);
+            lua_pop(l, 1);
+            Update(l);
+        }
+
+        /**
+         * @brief Назначает биты новым свойствам и ссылкам на поля, если отслеживание включено.
+         *
+         * @param l
+         */
+        static void Update(lua_State* l)
+        {
+            if (BitsTable::Push(l) == LUA_TNIL)
+            {
+                lua_pop(l, 1);
+                return;
+            }
+            const int bits = lua_gettop(l);
+            lua_Integer count = 0;
+            lua_pushnil(l);
+            while (lua_next(l, bits))
+            {
+                count++;
+                lua_pop(l, 1);
+            }
+
+            UData::NewIndexTable::Push(l);
+            const int setters = lua_gettop(l);
+            lua_pushnil(l);
+            while (lua_next(l, setters))
+            {
+                lua_pop(l, 1);
+                if (lua_type(l, -1) == LUA_TSTRING)
+                {
+                    AssignBit(l, bits, count);
+                }
+            }
+
+            if (ViewNamesTable::Push(l) != LUA_TNIL)
+            {
+                const int views = lua_gettop(l);
+                ViewBitsTable::Push(l);
+                const int viewBits = lua_gettop(l);
+                lua_pushnil(l);
+                while (lua_next(l, views))
+                {
+                    const lua_Integer bit = AssignBit(l, bits, count);
+                    lua_pop(l, 1);
+                    lua_pushvalue(l, -1);
+                    lua_pushinteger(l, bit);
+                    lua_rawset(l, viewBits);
+                }
+            }
+            lua_settop(l, bits - 1);
+        }
+
+        static bool IsEnabled(lua_State* l)
+        {
+            const bool enabled = BitsTable::Push(l) != LUA_TNIL;
+            lua_pop(l, 1);
+            return enabled;
+        }
+
+        /**
+         * @brief Возвращает номер бита свойства или -1, если свойство не отслеживается
+         *
+         * @param l
+         * @param name
+         * @return int
+         */
+        static int Bit(lua_State* l, const char* name)
+        {
+            if (BitsTable::Push(l) == LUA_TNIL)
+            {
+                lua_pop(l, 1);
+                return -1;
+            }
+            const int type = lua_getfield(l, -1, name);
+            const int bit = type == LUA_TNUMBER ? static_cast<int>(lua_tointeger(l, -1)) : -1;
+            lua_pop(l, 2);
+            return bit;
+        }
+
+        /**
+         * @brief Возвращает маску бита ссылки на поле getter или 0, если она не отслеживается
+         *
+         * @param l
+         * @param getter
+         * @return uint64_t
+         */
+        static uint64_t ViewBits(lua_State* l, lua_CFunction getter)
+        {
+            if (ViewBitsTable::Push(l) == LUA_TNIL)
+            {
+                lua_pop(l, 1);
+                return 0;
+            }
+            lua_pushcfunction(l, getter);
+            const uint64_t bits = lua_rawget(l, -2) == LUA_TNUMBER ? uint64_t{ 1 } << lua_tointeger(l, -1) : 0;
+            lua_pop(l, 2);
+            return bits;
+        }
+
+        /**
+         * @brief Возвращает маску измененных свойств объекта по индексу на стеке
+         *
+         * @param l
+         * @param index
+         * @return uint64_t
+         */
+        static uint64_t GetMask(lua_State* l, int index)
+        {
+            if (!UData::IsUserData(l, index))
+                return 0;
+            const uint64_t* const mask = UData::DirtyMask(l, index);
+            return mask == nullptr ? 0 : *mask;
+        }
+
+        /**
+         * @brief Отмечает свойство bit объекта по индексу на стеке измененным
+         *
+         * @param l
+         * @param index
+         * @param bit
+         */
+        static void Mark(lua_State* l, int index, int bit)
+        {
+            MarkBits(l, index, uint64_t{ 1 } << bit);
+        }
+
+        /**
+         * @brief Добавляет bits в маску объекта T по индексу на стеке
+         * и вносит его в список измененных при первой отметке.
+         * Объекты без слова маски не отмечаются.
+         *
+         * @param l
+         * @param index
+         * @param bits
+         */
+        static void MarkBits(lua_State* l, int index, uint64_t bits)
+        {
+            uint64_t* const mask = UData::DirtyMask(l, index);
+            if (mask == nullptr)
+                return;
+            if (*mask == 0)
+            {
+                index = lua_absindex(l, index);
+                DirtyList::Push(l);
+                lua_pushvalue(l, index);
+                lua_rawseti(l, -2, static_cast<lua_Integer>(lua_rawlen(l, -2)) + 1);
+                lua_pop(l, 1);
+            }
+            *mask |= bits;
+        }
+
+        /**
+         * @brief Вызывает f(T& object, uint64_t mask) для каждого измененного объекта и очищает список.
+         * Уничтоженные объекты пропускаются. Записи, сделанные во время обхода, попадают в новый список.
+         *
+         * @tparam F
+         * @param l
+         * @param f
+         */
+        template<typename F>
+        static void ForEachDirty(lua_State* l, F&& f)
+        {
+            if (DirtyList::Push(l) == LUA_TNIL)
+            {
+                lua_pop(l, 1);
+                return;
+            }
+            const int dirty = lua_gettop(l);
+            NewDirtyList(l);
+
+            const lua_Integer n = static_cast<lua_Integer>(lua_rawlen(l, dirty));
+            for (lua_Integer i = 1; i <= n; i++)
+            {
+                lua_rawgeti(l, dirty, i);
+                Internal::UserDataHeader* const header = static_cast<Internal::UserDataHeader*>(lua_touserdata(l, -1));
+                uint64_t* const mask = UData::Layout::Mask(header);
+                const uint64_t bits = *mask;
+                *mask = 0;
+                if (!header->IsDestroyed())
+                {
+                    f(*UData::Layout::Object(header), bits);
+                }
+                lua_pop(l, 1);
+            }
+            lua_settop(l, dirty - 1);
+        }
+
+        /**
+         * @brief Очищает маски и список измененных объектов
+         *
+         * @param l
+         */
+        static void Clear(lua_State* l)
+        {
+            ForEachDirty(l, [](T&, uint64_t) {});
+        }
+
+    private:
+        struct BitsTable : public RegistryTableBase<BitsTable> {};
+        struct DirtyList : public RegistryTableBase<DirtyList> {};
+        struct ViewNamesTable : public RegistryTableBase<ViewNamesTable> {};
+        struct ViewBitsTable : public RegistryTableBase<ViewBitsTable> {};
+
+        static void NewDirtyList(lua_State* l)
+        {
+            lua_newtable(l);
+            lua_setregp(l, DirtyList::GetKey());
+        }
+
+        /**
+         * @brief Возвращает бит имени на вершине стека, назначая новый, если его еще нет
+         */
+        static lua_Integer AssignBit(lua_State* l, int bits, lua_Integer& count)
+        {
+            lua_pushvalue(l, -1);
+            if (lua_rawget(l, bits) == LUA_TNUMBER)
+            {
+                const lua_Integer bit = lua_tointeger(l, -1);
+                lua_pop(l, 1);
+                return bit;
+            }
+            lua_pop(l, 1);
+
+            if (count == MaxProperties)
+            {
+                luaL_error(l, "Can't track more than %d properties of %s", static_cast<int>(MaxProperties), UData::GetClassName(l));
+            }
+            lua_pushvalue(l, -1);
+            lua_pushinteger(l, count);
+            lua_rawset(l, bits);
+            return count++;
+        }
+
+        /**
+         * @brief __newindex класса с отслеживанием: запись как обычно, затем отметка бита свойства.
+         * Таблица битов лежит в upvalue.
+         */
+        static int NewIndexFunction(lua_State* l)
+        {
+            UData::NewIndexMethod(l);
+            lua_settop(l, 3);
+
+            lua_pushvalue(l, 2);
+            if (lua_rawget(l, lua_upvalueindex(1)) == LUA_TNUMBER)
+            {
+                MarkBits(l, 1, uint64_t{ 1 } << lua_tointeger(l, -1));
+            }
+            return 0;
+        }
+    };
+}
@@ -0,0 +1,396 @@
+#pragma once
+#include "LuaAux.hpp"
+#include <chrono>
+#include <limits>
+#include <vector>
+
+namespace LTL
+{
+    /**
+     * @brief Ограничение на исполнение кода Lua в рамках одного вызова.
+     * Задается максимальным количеством инструкций ВМ и/или крайним сроком.
+     * Пустой бюджет не ограничивает исполнение и не устанавливает хук.
+     */
+    struct ExecutionBudget
+    {
+        using Clock = std::chrono::steady_clock;
+
+        /// @brief Максимальное количество инструкций, 0 - без ограничения
+        size_t max_instructions = 0;
+        /// @brief Крайний срок исполнения
+        Clock::time_point deadline = Clock::time_point::max();
+        /// @brief Количество инструкций между проверками крайнего срока
+        int check_interval = 1000;
+
+        /**
+         * @brief Бюджет на заданное количество инструкций.
+         *
+         * @param n
+         * @return ExecutionBudget
+         */
+        static ExecutionBudget Instructions(size_t n)
+        {
+            ExecutionBudget budget{};
+            budget.max_instructions = n;
+            return budget;
+        }
+
+        /**
+         * @brief Бюджет с крайним сроком исполнения.
+         *
+         * @param deadline
+         * @return ExecutionBudget
+         */
+        static ExecutionBudget Until(Clock::time_point deadline)
+        {
+            ExecutionBudget budget{};
+            budget.deadline = deadline;
+            return budget;
+        }
+
+        /**
+         * @brief Бюджет на заданное время с момента вызова.
+         *
+         * @tparam Rep
+         * @tparam Period
+         * @param duration
+         * @return ExecutionBudget
+         */
+        template<typename Rep, typename Period>
+        static ExecutionBudget For(const std::chrono::duration<Rep, Period>& duration)
+        {
+            return Until(Clock::now() + std::chrono::duration_cast<Clock::duration>(duration));
+        }
+
+        bool HasInstructionLimit()const noexcept
+        {
+            return max_instructions != 0;
+        }
+
+        bool HasDeadline()const noexcept
+        {
+            return deadline != Clock::time_point::max();
+        }
+
+        bool IsUnlimited()const noexcept
+        {
+            return !HasInstructionLimit() && !HasDeadline();
+        }
+    };
+
+    namespace Internal
+    {
+        /**
+         * @brief Устанавливает хук, следящий за бюджетом, и восстанавливает
+         * предыдущие хуки при уничтожении или вызове Remove. Вложенные бюджеты поддерживаются.
+         * Count-хук считает инструкции, call-хук подключает бюджет к потокам:
+         * при вызове C функции, получившей поток первым аргументом или upvalue
+         * (coroutine.resume, функции coroutine.wrap), хук устанавливается и в этот поток,
+         * поэтому корутины, созданные до вызова, тоже исполняются под бюджетом.
+         * Подключенные потоки удерживаются до снятия бюджета, после чего их хуки восстанавливаются.
+         * Корутины, созданные во время вызова и не запущенные под ним, наследуют хук;
+         * после снятия бюджета при первом срабатывании они получают хук главного потока.
+         */
+        class BudgetHook
+        {
+        public:
+            BudgetHook(lua_State* l, const ExecutionBudget& budget)
+                : m_state(l),
+                m_budget(budget),
+                m_prev_hook(lua_gethook(l)),
+                m_prev_mask(lua_gethookmask(l)),
+                m_prev_count(lua_gethookcount(l))
+            {
+                lua_getregp(l, GetKey());
+                m_prev_guard = lua_touserdata(l, -1);
+                lua_pop(l, 1);
+
+                lua_newtable(l);
+                m_threads = luaL_ref(l, LUA_REGISTRYINDEX);
+
+                lua_pushlightuserdata(l, this);
+                lua_setregp(l, GetKey());
+                Arm(l);
+            }
+
+            BudgetHook(const BudgetHook&) = delete;
+            BudgetHook(BudgetHook&&) = delete;
+            BudgetHook& operator=(const BudgetHook&) = delete;
+            BudgetHook& operator=(BudgetHook&&) = delete;
+
+            /**
+             * @brief Снимает хук и возвращает предыдущие хуки всем подключенным потокам.
+             * Повторный вызов ничего не делает.
+             */
+            void Remove()
+            {
+                if (m_removed)
+                    return;
+                m_removed = true;
+
+                for (const SavedHook& saved : m_saved)
+                {
+                    lua_sethook(saved.thread, saved.hook, saved.mask, saved.count);
+                }
+                m_saved.clear();
+                luaL_unref(m_state, LUA_REGISTRYINDEX, m_threads);
+
+                lua_sethook(m_state, m_prev_hook, m_prev_mask, m_prev_count);
+                if (m_prev_guard)
+                {
+                    lua_pushlightuserdata(m_state, m_prev_guard);
+                }
+                else
+                {
+                    lua_pushnil(m_state);
+                }
+                lua_setregp(m_state, GetKey());
+            }
+
+            bool Exceeded()const noexcept
+            {
+                return m_exceeded;
+            }
+
+            ~BudgetHook()
+            {
+                Remove();
+            }
+
+        private:
+            struct SavedHook
+            {
+                lua_State* thread;
+                lua_Hook hook;
+                int mask;
+                int count;
+            };
+
+            static constexpr int Mask = LUA_MASKCOUNT | LUA_MASKCALL;
+
+            static const void* GetKey()
+            {
+                static const char key = 0;
+                return &key;
+            }
+
+            static void Hook(lua_State* l, lua_Debug* ar)
+            {
+                lua_getregp(l, GetKey());
+                BudgetHook* const self = static_cast<BudgetHook*>(lua_touserdata(l, -1));
+                lua_pop(l, 1);
+
+                if (self == nullptr)
+                {
+                    // поток, созданный под уже снятым бюджетом, получает хук главного потока
+                    lua_rawgeti(l, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+                    lua_State* const main = lua_tothread(l, -1);
+                    lua_pop(l, 1);
+                    lua_sethook(l, lua_gethook(main), lua_gethookmask(main), lua_gethookcount(main));
+                    return;
+                }
+                if (ar->event != LUA_HOOKCOUNT)
+                {
+                    self->OnCall(l, ar);
+                    return;
+                }
+                if (self->Consume(l))
+                    return;
+
+                luaL_error(l, "%s", "execution budget exceeded");
+            }
+
+            /**
+             * @brief Подключает поток, который вызываемая C функция получила аргументом или upvalue.
+             */
+            void OnCall(lua_State* l, lua_Debug* ar)
+            {
+                lua_getinfo(l, "f", ar);
+                if (!lua_iscfunction(l, -1))
+                {
+                    lua_pop(l, 1);
+                    return;
+                }
+                if (lua_getlocal(l, ar, 1) != nullptr)
+                {
+                    Attach(l, lua_gettop(l));
+                    lua_pop(l, 1);
+                }
+                if (lua_getupvalue(l, -1, 1) != nullptr)
+                {
+                    Attach(l, lua_gettop(l));
+                    lua_pop(l, 1);
+                }
+                lua_pop(l, 1);
+            }
+
+            /**
+             * @brief Устанавливает хук бюджета в поток, запоминая его прежний хук.
+             *
+             * @param l текущий поток
+             * @param index абсолютный индекс значения, если это поток - он подключается
+             */
+            void Attach(lua_State* l, int index)
+            {
+                lua_State* const thread = lua_tothread(l, index);
+                if (thread == nullptr || thread == m_state)
+                    return;
+
+                lua_rawgeti(l, LUA_REGISTRYINDEX, m_threads);
+                lua_pushvalue(l, index);
+                if (lua_rawget(l, -2) != LUA_TNIL)
+                {
+                    lua_pop(l, 2);
+                    return;
+                }
+                lua_pop(l, 1);
+                lua_pushvalue(l, index);
+                lua_pushboolean(l, true);
+                lua_rawset(l, -3);
+                lua_pop(l, 1);
+
+                // унаследованный хук бюджета заменяется прежним хуком вызывающего потока
+                const lua_Hook hook = lua_gethook(thread);
+                if (hook == Hook)
+                {
+                    m_saved.push_back({ thread, m_prev_hook, m_prev_mask, m_prev_count });
+                }
+                else
+                {
+                    m_saved.push_back({ thread, hook, lua_gethookmask(thread), lua_gethookcount(thread) });
+                }
+                lua_sethook(thread, Hook, Mask, m_step);
+            }
+
+            /**
+             * @brief Учитывает исполненный потоком l отрезок инструкций.
+             * Длина отрезка берется из хука потока: у корутин она может отличаться от m_step.
+             *
+             * @param l поток, в котором сработал хук
+             * @return true бюджет не исчерпан
+             * @return false бюджет исчерпан
+             */
+            bool Consume(lua_State* l)
+            {
+                m_executed += static_cast<size_t>(lua_gethookcount(l));
+                if (m_budget.HasInstructionLimit() && m_executed >= m_budget.max_instructions)
+                {
+                    m_exceeded = true;
+                }
+                else if (m_budget.HasDeadline() && ExecutionBudget::Clock::now() >= m_budget.deadline)
+                {
+                    m_exceeded = true;
+                }
+
+                if (m_exceeded)
+                {
+                    // Следующая инструкция снова вызовет хук, если скрипт перехватит ошибку
+                    m_step = 1;
+                    m_executed = m_budget.max_instructions;
+                    lua_sethook(l, Hook, Mask, m_step);
+                    if (l != m_state)
+                    {
+                        lua_sethook(m_state, Hook, Mask, m_step);
+                    }
+                    return false;
+                }
+
+                Arm(l);
+                return true;
+            }
+
+            void Arm(lua_State* l)
+            {
+                int step = std::numeric_limits<int>::max();
+                if (m_budget.HasDeadline())
+                {
+                    step = m_budget.check_interval > 0 ? m_budget.check_interval : 1;
+                }
+                if (m_budget.HasInstructionLimit())
+                {
+                    const size_t left = m_budget.max_instructions - m_executed;
+                    if (left < static_cast<size_t>(step))
+                    {
+                        step = static_cast<int>(left);
+                    }
+                }
+                if (step != m_step || step != lua_gethookcount(l))
+                {
+                    m_step = step;
+                    lua_sethook(l, Hook, Mask, m_step);
+                }
+            }
+
+            lua_State* const m_state;
+            const ExecutionBudget m_budget;
+            const lua_Hook m_prev_hook;
+            const int m_prev_mask;
+            const int m_prev_count;
+            void* m_prev_guard = nullptr;
+            int m_threads = LUA_NOREF;
+            std::vector<SavedHook> m_saved;
+            size_t m_executed = 0;
+            int m_step = 0;
+            bool m_exceeded = false;
+            bool m_removed = false;
+        };
+    }
+
+    /**
+     * @brief Безопасно вызывает функцию на стеке с ограничением исполнения.
+     * При исчерпании бюджета возвращает PCallResult::ERRBUDGET,
+     * сообщение об ошибке остается на стеке.
+     *
+     * @param l
+     * @param n_args
+     * @param n_results
+     * @param budget
+     * @param i_errfunc
+     * @return PCallResult
+     */
+    inline PCallResult PCallWithBudget(lua_State* l, int n_args, int n_results, const ExecutionBudget& budget, int i_errfunc = 0)
+    {
+        if (budget.IsUnlimited())
+        {
+            return static_cast<PCallResult>(lua_pcall(l, n_args, n_results, i_errfunc));
+        }
+
+        Internal::BudgetHook hook{ l, budget };
+        PCallResult status = static_cast<PCallResult>(lua_pcall(l, n_args, n_results, i_errfunc));
+        hook.Remove();
+        // обработчик ошибок тоже исполняется под исчерпанным бюджетом и получает ERRERR
+        if ((status == PCallResult::ERRRUN || status == PCallResult::ERRERR) && hook.Exceeded())
+        {
+            status = PCallResult::ERRBUDGET;
+        }
+        return status;
+    }
+
+    template<typename TReturn = void>
+    inline PCallReturn<TReturn> PCallStack(lua_State* l, const size_t n_args, const ExecutionBudget& budget)
+    {
+        PCallResult status = PCallWithBudget(l, static_cast<int>(n_args), ResulltNum<TReturn>::value, budget);
+        if constexpr (std::is_void_v<TReturn>)
+        {
+            return status;
+        }
+        else
+        {
+            if (status != PCallResult::Ok)
+            {
+                return { status };
+            }
+            TReturn result = StackResultGetter<TReturn>::Get(l);
+            lua_pop(l, ResulltNum<TReturn>::value);
+            return { result, status };
+        }
+    }
+
+    template<typename TReturn = void, typename F, typename ...TArgs>
+    inline PCallReturn<TReturn> PCallFunctionWithBudget(lua_State* l, const ExecutionBudget& budget, const F& func, TArgs&& ...args)
+    {
+        PushValue(l, func);
+        const size_t n = PushArgs(l, std::forward<TArgs>(args)...);
+        return PCallStack<TReturn>(l, n, budget);
+    }
+}
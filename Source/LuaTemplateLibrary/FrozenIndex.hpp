@@ -0,0 +1,258 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "UserData.hpp"
+#include <vector>
+
+namespace LTL::Internal
+{
+    /**
+     * @brief Неизменяемый __index класса на основе совершенного хеширования.
+     * Ключами служат адреса строк имен членов: короткие строки в Lua единственны,
+     * поэтому поиск - это хеш указателя и одно сравнение.
+     * Методы хранятся в таблице-upvalue, геттеры без upvalue вызываются напрямую.
+     * Ключи, которых нет в таблице (в том числе длинные строки и не строки),
+     * ищутся как раньше, через таблицы геттеров и методов.
+     *
+     * @tparam T класс
+     */
+    template<typename T>
+    class FrozenIndex
+    {
+        using UData = UserData<T>;
+
+        enum class Kind : uint8_t
+        {
+            Method,
+            Getter,
+            GetterValue
+        };
+
+        struct Slot
+        {
+            const void* key;
+            lua_CFunction getter;
+            int value;
+            Kind kind;
+        };
+
+        struct Dispatch
+        {
+            uint64_t seed;
+            unsigned shift;
+            size_t size;
+
+            Slot* Slots() noexcept
+            {
+                return reinterpret_cast<Slot*>(this + 1);
+            }
+
+            const Slot& Find(const void* key)const noexcept
+            {
+                const uint64_t h = (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key)) * seed) >> shift;
+                return reinterpret_cast<const Slot*>(this + 1)[h];
+            }
+        };
+
+        struct FrozenFlag : public RegistryTableBase<FrozenFlag> {};
+
+        /// @brief Число попыток подобрать множитель для одного размера таблицы
+        static constexpr int SeedAttempts = 64;
+
+    public:
+        /**
+         * @brief Строит таблицу по текущим методам и геттерам и устанавливает ее как __index.
+         * Если у класса нет геттеров, __index уже является таблицей методов и не меняется.
+         *
+         * @param l
+         */
+        static void Build(lua_State* l)
+        {
+            if (UData::IndexTable::Push(l) == LUA_TNIL)
+            {
+                lua_pop(l, 1);
+                return;
+            }
+            const int getters = lua_gettop(l);
+            UData::MethodsTable::Push(l);
+            const int methods = lua_gettop(l);
+
+            lua_newtable(l);
+            const int values = lua_gettop(l);
+            int value_count = 0;
+
+            std::vector<Slot> entries;
+            Collect(l, methods, values, value_count, entries, false);
+            Collect(l, getters, values, value_count, entries, true);
+
+            unsigned bits = 1;
+            while ((size_t{ 1 } << bits) < entries.size() * 4)
+            {
+                bits++;
+            }
+
+            uint64_t state = 0x9E3779B97F4A7C15ull;
+            for (;; bits++)
+            {
+                const size_t size = size_t{ 1 } << bits;
+                for (int attempt = 0; attempt < SeedAttempts; attempt++)
+                {
+                    const uint64_t seed = NextSeed(state);
+                    if (!IsPerfect(entries, seed, 64 - bits, size))
+                        continue;
+
+                    Dispatch* const dispatch = static_cast<Dispatch*>(lua_newuserdata(l, sizeof(Dispatch) + size * sizeof(Slot)));
+                    dispatch->seed = seed;
+                    dispatch->shift = 64 - bits;
+                    dispatch->size = size;
+                    Slot* const slots = dispatch->Slots();
+                    for (size_t i = 0; i < size; i++)
+                    {
+                        slots[i] = { nullptr, nullptr, 0, Kind::Method };
+                    }
+                    for (const Slot& entry : entries)
+                    {
+                        slots[&dispatch->Find(entry.key) - slots] = entry;
+                    }
+
+                    lua_pushvalue(l, values);
+                    lua_pushcclosure(l, IndexFunction, 2);
+                    UData::MetaTable::Push(l);
+                    lua_insert(l, -2);
+                    lua_setfield(l, -2, "__index");
+                    lua_pop(l, 1);
+
+                    lua_pushboolean(l, true);
+                    lua_setregp(l, FrozenFlag::GetKey());
+                    lua_settop(l, getters - 1);
+                    return;
+                }
+            }
+        }
+
+        /**
+         * @brief Возвращает __index к поиску по таблицам, если таблица была построена.
+         * Вызывается при добавлении методов и геттеров после Build.
+         *
+         * @param l
+         */
+        static void Invalidate(lua_State* l)
+        {
+            if (FrozenFlag::Push(l) == LUA_TNIL)
+            {
+                lua_pop(l, 1);
+                return;
+            }
+            lua_pop(l, 1);
+            lua_pushnil(l);
+            lua_setregp(l, FrozenFlag::GetKey());
+
+            UData::MetaTable::Push(l);
+            lua_pushcfunction(l, UData::IndexMethod);
+            lua_setfield(l, -2, "__index");
+            lua_pop(l, 1);
+        }
+
+        static bool IsBuilt(lua_State* l)
+        {
+            const bool built = FrozenFlag::Push(l) != LUA_TNIL;
+            lua_pop(l, 1);
+            return built;
+        }
+
+    private:
+        static void Collect(lua_State* l, int table, int values, int& value_count, std::vector<Slot>& entries, bool getters)
+        {
+            lua_pushnil(l);
+            while (lua_next(l, table))
+            {
+                if (lua_type(l, -2) != LUA_TSTRING)
+                {
+                    lua_pop(l, 1);
+                    continue;
+                }
+
+                Slot slot{ lua_tostring(l, -2), nullptr, 0, Kind::Method };
+                lua_CFunction const func = lua_tocfunction(l, -1);
+                if (getters && func && lua_getupvalue(l, -1, 1) == nullptr)
+                {
+                    slot.kind = Kind::Getter;
+                    slot.getter = func;
+                    lua_pop(l, 1);
+                }
+                else
+                {
+                    if (getters && func)
+                    {
+                        lua_pop(l, 1); // upvalue
+                    }
+                    slot.kind = getters ? Kind::GetterValue : Kind::Method;
+                    slot.value = ++value_count;
+                    lua_rawseti(l, values, value_count);
+                }
+
+                bool replaced = false;
+                for (Slot& entry : entries)
+                {
+                    if (entry.key == slot.key)
+                    {
+                        entry = slot;
+                        replaced = true;
+                    }
+                }
+                if (!replaced)
+                {
+                    entries.push_back(slot);
+                }
+            }
+        }
+
+        static uint64_t NextSeed(uint64_t& state)
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return (z ^ (z >> 31)) | 1;
+        }
+
+        static bool IsPerfect(const std::vector<Slot>& entries, uint64_t seed, unsigned shift, size_t size)
+        {
+            std::vector<bool> used(size);
+            for (const Slot& entry : entries)
+            {
+                const uint64_t h = (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(entry.key)) * seed) >> shift;
+                if (used[h])
+                    return false;
+                used[h] = true;
+            }
+            return true;
+        }
+
+        static int IndexFunction(lua_State* l)
+        {
+            if (lua_type(l, 2) == LUA_TSTRING)
+            {
+                const Dispatch* const dispatch = static_cast<const Dispatch*>(lua_touserdata(l, lua_upvalueindex(1)));
+                const char* const key = lua_tostring(l, 2);
+                const Slot& slot = dispatch->Find(key);
+                if (slot.key == key)
+                {
+                    switch (slot.kind)
+                    {
+                    case Kind::Method:
+                        lua_rawgeti(l, lua_upvalueindex(2), slot.value);
+                        return 1;
+                    case Kind::Getter:
+                        lua_settop(l, 1);
+                        return slot.getter(l);
+                    case Kind::GetterValue:
+                        lua_rawgeti(l, lua_upvalueindex(2), slot.value);
+                        lua_pushvalue(l, 1);
+                        lua_call(l, 1, 1);
+                        return 1;
+                    }
+                }
+            }
+            return UData::IndexMethod(l);
+        }
+    };
+}
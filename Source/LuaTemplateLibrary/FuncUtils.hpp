@@ -2,6 +2,7 @@
 #include "FuncArguments.hpp"
 #include "LuaAux.hpp"
 #include "Types.hpp"
+#include "ScratchArena.hpp"
 
 namespace LTL
 {
@@ -23,6 +24,11 @@ namespace LTL
         {
         };
 
+        template <>
+        struct NoIncrement<ScratchArena*> : std::true_type
+        {
+        };
+
         template <size_t Value>
         using ValueContainer = std::integral_constant<size_t, Value>;
 
@@ -85,6 +91,23 @@ namespace LTL
             }
         };
 
+        /**
+         * @brief Забирает ли аргумент объект у Lua (StackType<T>::TransfersOwnership).
+         * Такие аргументы читаются после всех остальных, чтобы ошибка Lua в другом аргументе
+         * не оставила забранный объект без владельца.
+         *
+         * @tparam T
+         */
+        template <typename T, typename = void>
+        struct IsTransferArgument : std::false_type
+        {
+        };
+
+        template <typename T>
+        struct IsTransferArgument<T, std::enable_if_t<StackType<T>::TransfersOwnership>> : std::true_type
+        {
+        };
+
 #pragma region GetArgs logic
         template <size_t TupleIndex, size_t ArgIndex, size_t UpvalueIndex, typename TArgsTuple>
         constexpr size_t GetArgs(lua_State* l, TArgsTuple& args)
@@ -95,7 +118,10 @@ namespace LTL
         template <size_t TupleIndex, size_t ArgIndex, size_t UpvalueIndex, typename TArgsTuple, typename TArg, typename... TArgs>
         constexpr size_t GetArgs(lua_State* l, TArgsTuple& args)
         {
-            std::get<TupleIndex>(args) = ArgExtractor<TArg>::Get<ArgIndex, UpvalueIndex>(l);
+            if constexpr (!IsTransferArgument<TArg>::value)
+            {
+                std::get<TupleIndex>(args) = ArgExtractor<TArg>::Get<ArgIndex, UpvalueIndex>(l);
+            }
             return GetArgs<
                 TupleIndex + 1,
                 IncrementArgIndex<TArg, ArgIndex>::value,
@@ -103,10 +129,73 @@ namespace LTL
                 TArgsTuple, TArgs...>(l, args);
         }
 
+        template <size_t Index, size_t ArgIndex>
+        constexpr void CheckTransferDistinct(lua_State* l)
+        {
+        }
+
+        /**
+         * @brief Сообщает об ошибке, если объект аргумента Index передан и другим забирающим аргументом:
+         * второй не смог бы его забрать после первого.
+         */
+        template <size_t Index, size_t ArgIndex, typename TArg, typename... TArgs>
+        constexpr void CheckTransferDistinct(lua_State* l)
+        {
+            if constexpr (IsTransferArgument<TArg>::value)
+            {
+                if (lua_rawequal(l, static_cast<int>(Index) + 1, static_cast<int>(ArgIndex) + 1))
+                {
+                    luaL_argerror(l, static_cast<int>(ArgIndex) + 1, "object is already passed as another owning argument");
+                }
+            }
+            CheckTransferDistinct<Index, IncrementArgIndex<TArg, ArgIndex>::value, TArgs...>(l);
+        }
+
+        template <size_t ArgIndex>
+        constexpr void CheckTransferArgs(lua_State* l)
+        {
+        }
+
+        template <size_t ArgIndex, typename TArg, typename... TArgs>
+        constexpr void CheckTransferArgs(lua_State* l)
+        {
+            if constexpr (IsTransferArgument<TArg>::value)
+            {
+                if (!StackType<TArg>::Check(l, ArgIndex + 1))
+                {
+                    // Get неподходящего аргумента сообщает об ошибке, ничего не забирая
+                    StackType<TArg>::Get(l, ArgIndex + 1);
+                }
+                CheckTransferDistinct<ArgIndex, IncrementArgIndex<TArg, ArgIndex>::value, TArgs...>(l);
+            }
+            CheckTransferArgs<IncrementArgIndex<TArg, ArgIndex>::value, TArgs...>(l);
+        }
+
+        template <size_t TupleIndex, size_t ArgIndex, typename TArgsTuple>
+        constexpr void GetTransferArgs(lua_State* l, TArgsTuple& args)
+        {
+        }
+
+        template <size_t TupleIndex, size_t ArgIndex, typename TArgsTuple, typename TArg, typename... TArgs>
+        constexpr void GetTransferArgs(lua_State* l, TArgsTuple& args)
+        {
+            if constexpr (IsTransferArgument<TArg>::value)
+            {
+                std::get<TupleIndex>(args) = StackType<TArg>::Get(l, ArgIndex + 1);
+            }
+            GetTransferArgs<TupleIndex + 1, IncrementArgIndex<TArg, ArgIndex>::value, TArgsTuple, TArgs...>(l, args);
+        }
+
         template <typename TArgsTuple, typename... TArgs>
         constexpr size_t GetArgs(lua_State* l, TArgsTuple& args)
         {
-            return GetArgs<0, 0, 0, TArgsTuple, TArgs...>(l, args);
+            const size_t count = GetArgs<0, 0, 0, TArgsTuple, TArgs...>(l, args);
+            if constexpr ((IsTransferArgument<TArgs>::value || ...))
+            {
+                CheckTransferArgs<0, TArgs...>(l);
+                GetTransferArgs<0, 0, TArgsTuple, TArgs...>(l, args);
+            }
+            return count;
         }
 #pragma endregion
 
@@ -129,6 +129,10 @@ namespace LTL
         struct FunctionHelper : CFunctionBase
         {
             using ArgsTuple = std::tuple<Unwrap_t<TArgs>...>;
+
+            /// @brief Аргументы используют временную память вызова
+            static constexpr bool UsesScratch = (Internal::IsScratchArgument<Unwrap_t<TArgs>>::value || ...);
+
             static constexpr size_t GetArgs(lua_State* l, ArgsTuple& args)
             {
                 return FuncUtility::GetArgs<ArgsTuple, TArgs...>(l, args);
@@ -331,6 +335,24 @@ namespace LTL
         }
 
         static int _Caller(lua_State* l)
+        {
+            if constexpr (_FunctionHelper::UsesScratch)
+            {
+                ScratchArena* const nested = ScratchArena::Enter(l, static_cast<int>(max_arg_count));
+                const int n = _Call(l);
+                if (nested != nullptr)
+                {
+                    nested->Leave();
+                }
+                return n;
+            }
+            else
+            {
+                return _Call(l);
+            }
+        }
+
+        static int _Call(lua_State* l)
         {
             ArgsTuple args;
             _FunctionHelper::GetArgs(l, args);
@@ -344,7 +366,7 @@ namespace LTL
             {
                 auto result = _FunctionCaller::Call(args);
                 _FunctionHelper::ReplaceUpvalues(l, args);
-                size_t n_results = PushResult(l, result);
+                size_t n_results = PushResult(l, std::move(result));
                 return static_cast<int>(n_results);
             }
         }
@@ -396,6 +418,24 @@ namespace LTL
         }
 
         static int _Caller(lua_State* l)
+        {
+            if constexpr (_FunctionHelper::UsesScratch)
+            {
+                ScratchArena* const nested = ScratchArena::Enter(l, static_cast<int>(max_arg_count));
+                const int n = _Call(l);
+                if (nested != nullptr)
+                {
+                    nested->Leave();
+                }
+                return n;
+            }
+            else
+            {
+                return _Call(l);
+            }
+        }
+
+        static int _Call(lua_State* l)
         {
             ArgsTuple args;
             _FunctionHelper::GetArgs(l, args);
@@ -409,7 +449,7 @@ namespace LTL
             {
                 TUnwrappedReturn result = _FunctionCaller::Call(args);
                 _FunctionHelper::ReplaceUpvalues(l, args);
-                return PushResult<TUnwrappedReturn, TRet>(l, result);
+                return PushResult<TUnwrappedReturn, TRet>(l, std::forward<TUnwrappedReturn>(result));
             }
         }
     };
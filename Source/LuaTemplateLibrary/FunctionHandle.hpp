@@ -0,0 +1,281 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "Types.hpp"
+#include "UserData.hpp"
+#include "RefObject.hpp"
+#include "StackObject.hpp"
+#include "Key.hpp"
+
+namespace LTL
+{
+    /**
+     * @brief Счетчик версий таблиц.
+     * Счетчик создается для таблицы при первом отслеживающем FunctionHandle
+     * и хранится в реестре в таблице со слабыми ключами.
+     * Версии ведутся вручную: Lua не сообщает о записи в существующий ключ,
+     * поэтому изменение функций таблицы нужно отмечать вызовом Touch (из C++ или из Lua).
+     * Без Touch отслеживающий FunctionHandle продолжает вызывать прежнюю функцию.
+     */
+    class TableVersion
+    {
+    public:
+        /**
+         * @brief Помещает на стек счетчик версий таблицы, создавая его при необходимости.
+         *
+         * @param l
+         * @param index индекс таблицы на стеке
+         * @return const uint64_t* текущее значение счетчика
+         */
+        static const uint64_t* Push(lua_State* l, int index)
+        {
+            index = lua_absindex(l, index);
+            PushVersions(l);
+            lua_pushvalue(l, index);
+            if (lua_rawget(l, -2) != LUA_TUSERDATA)
+            {
+                lua_pop(l, 1);
+                uint64_t* const counter = static_cast<uint64_t*>(lua_newuserdata(l, sizeof(uint64_t)));
+                *counter = 0;
+                lua_pushvalue(l, index);
+                lua_pushvalue(l, -2);
+                lua_rawset(l, -4);
+            }
+            lua_remove(l, -2);
+            return static_cast<const uint64_t*>(lua_touserdata(l, -1));
+        }
+
+        /**
+         * @brief Увеличивает версию таблицы, из-за чего отслеживающие ее
+         * FunctionHandle заново найдут функцию при следующем вызове.
+         *
+         * @param l
+         * @param index индекс таблицы на стеке
+         */
+        static void Touch(lua_State* l, int index)
+        {
+            index = lua_absindex(l, index);
+            PushVersions(l);
+            lua_pushvalue(l, index);
+            if (lua_rawget(l, -2) == LUA_TUSERDATA)
+            {
+                ++*static_cast<uint64_t*>(lua_touserdata(l, -1));
+            }
+            lua_pop(l, 2);
+        }
+
+        /**
+         * @brief Функция для Lua: увеличивает версию таблицы, переданной первым аргументом.
+         *
+         * @param l
+         * @return int
+         */
+        static int TouchFunction(lua_State* l)
+        {
+            luaL_checktype(l, 1, LUA_TTABLE);
+            Touch(l, 1);
+            return 0;
+        }
+
+    private:
+        struct VersionsTable : public RegistryTableBase<VersionsTable> {};
+
+        static void PushVersions(lua_State* l)
+        {
+            if (VersionsTable::Push(l) != LUA_TNIL)
+                return;
+
+            lua_pop(l, 1);
+            lua_createtable(l, 0, 0);
+            lua_createtable(l, 0, 1);
+            lua_pushstring(l, "k");
+            lua_setfield(l, -2, "__mode");
+            lua_setmetatable(l, -2);
+            lua_pushvalue(l, -1);
+            lua_setregp(l, VersionsTable::GetKey());
+        }
+    };
+
+    /**
+     * @brief Функция, найденная по ключу один раз и хранимая по ссылке.
+     * Вызов помещает на стек только функцию и аргументы, без поиска по имени.
+     * При отслеживании версии таблицы-владельца функция ищется заново
+     * после TableVersion::Touch для этой таблицы; каждый вызов при этом
+     * проверяет только счетчик версии. Переприсваивание функции без Touch не замечается.
+     */
+    class FunctionHandle
+    {
+    public:
+        FunctionHandle() = default;
+
+        /**
+         * @brief Находит функцию в таблице.
+         *
+         * @param owner таблица с функцией
+         * @param key имя функции
+         * @param track отслеживать версию таблицы
+         */
+        FunctionHandle(const StackObjectView& owner, const char* key, bool track = false)
+            : m_owner(GRefObject::FromStack(owner.GetState(), owner.GetIndex())),
+            m_key(owner.GetState(), key)
+        {
+            if (track)
+            {
+                lua_State* const l = owner.GetState();
+                m_counter_value = TableVersion::Push(l, owner.GetIndex());
+                m_counter = GRefObject::FromTop(l);
+            }
+            Resolve();
+        }
+
+        /**
+         * @brief Находит глобальную функцию.
+         *
+         * @param l
+         * @param name имя функции
+         * @param track отслеживать версию таблицы глобальных значений
+         */
+        FunctionHandle(lua_State* l, const char* name, bool track = false)
+            : FunctionHandle(PushGlobals(l), name, track)
+        {
+            lua_pop(l, 1);
+        }
+
+        template<typename T>
+        FunctionHandle(const State<T>& state, const char* name, bool track = false)
+            : FunctionHandle(state.GetState()->Unwrap(), name, track) {}
+
+        /**
+         * @brief Вызывает функцию с данными аргументами.
+         *
+         * @tparam TReturn тип возвращаемого значения. По ум. void.
+         * @tparam TArgs типы аргументов
+         * @param args
+         * @return TReturn
+         */
+        template<typename TReturn = void, typename ...TArgs>
+        TReturn Call(TArgs&& ...args)const
+        {
+            Push();
+            const size_t n = PushArgs(GetState(), std::forward<TArgs>(args)...);
+            return CallStack<TReturn>(GetState(), n);
+        }
+
+        /**
+         * @brief Безопасно вызывает функцию с данными аргументами.
+         *
+         * @tparam TReturn тип возвращаемого значения. По ум. void.
+         * @tparam TArgs типы аргументов
+         * @param args
+         * @return PCallReturn<TReturn>
+         */
+        template<typename TReturn = void, typename ...TArgs>
+        PCallReturn<TReturn> PCall(TArgs&& ...args)const
+        {
+            Push();
+            const size_t n = PushArgs(GetState(), std::forward<TArgs>(args)...);
+            return PCallStack<TReturn>(GetState(), n);
+        }
+
+        /**
+         * @brief Помещает функцию на стек, при необходимости найдя ее заново.
+         */
+        void Push()const
+        {
+            if (m_counter_value && *m_counter_value != m_version)
+            {
+                Resolve();
+            }
+            m_function.Push();
+        }
+
+        /**
+         * @brief Заново находит функцию в таблице-владельце.
+         */
+        void Resolve()const
+        {
+            lua_State* const l = GetState();
+            m_owner.Push();
+            m_key.Push(l);
+            lua_gettable(l, -2);
+            m_function = GRefObject::FromTop(l);
+            lua_pop(l, 1);
+            if (m_counter_value)
+            {
+                m_version = *m_counter_value;
+            }
+        }
+
+        bool IsTracked()const noexcept
+        {
+            return m_counter_value != nullptr;
+        }
+
+        lua_State* const GetState()const noexcept
+        {
+            return m_owner.GetState();
+        }
+
+    private:
+        static StackObjectView PushGlobals(lua_State* l)
+        {
+            lua_pushglobaltable(l);
+            return { l };
+        }
+
+        GRefObject m_owner;
+        Key m_key;
+        GRefObject m_counter;
+        const uint64_t* m_counter_value = nullptr;
+        mutable GRefObject m_function;
+        mutable uint64_t m_version = 0;
+    };
+
+    /**
+     * @brief Метод объекта, найденный один раз и привязанный к объекту.
+     * Вызов эквивалентен SelfCall, но без поиска метода по имени.
+     * При отслеживании учитывается версия самого объекта, а не его метатаблицы.
+     */
+    class BoundMethod
+    {
+    public:
+        BoundMethod() = default;
+
+        BoundMethod(const StackObjectView& self, const char* name, bool track = false)
+            : m_method(self, name, track),
+            m_self(GRefObject::FromStack(self.GetState(), self.GetIndex())) {}
+
+        template<typename RefAccess>
+        BoundMethod(const RefObject<RefAccess>& self, const char* name, bool track = false)
+            : BoundMethod(self.PushView(), name, track)
+        {
+            lua_pop(self.GetState(), 1);
+        }
+
+        template<typename TReturn = void, typename ...TArgs>
+        TReturn Call(TArgs&& ...args)const
+        {
+            m_method.Push();
+            m_self.Push();
+            const size_t n = PushArgs(GetState(), std::forward<TArgs>(args)...) + 1;
+            return CallStack<TReturn>(GetState(), n);
+        }
+
+        template<typename TReturn = void, typename ...TArgs>
+        PCallReturn<TReturn> PCall(TArgs&& ...args)const
+        {
+            m_method.Push();
+            m_self.Push();
+            const size_t n = PushArgs(GetState(), std::forward<TArgs>(args)...) + 1;
+            return PCallStack<TReturn>(GetState(), n);
+        }
+
+        lua_State* const GetState()const noexcept
+        {
+            return m_self.GetState();
+        }
+
+    private:
+        FunctionHandle m_method;
+        GRefObject m_self;
+    };
+}
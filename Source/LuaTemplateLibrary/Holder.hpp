@@ -0,0 +1,272 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "Types.hpp"
+#include "UserData.hpp"
+#include <memory>
+
+namespace LTL
+{
+    /**
+     * @brief Описывает владеющий указатель для UserData<T, Holder>.
+     * По умолчанию подходит любой указатель с методом get(): std::unique_ptr, std::shared_ptr
+     * и указатели с интрузивным счетчиком ссылок вроде boost::intrusive_ptr.
+     * Для указателей без get() специализация должна определить Get.
+     *
+     * @tparam Holder
+     */
+    template<typename Holder, typename = void>
+    struct HolderTraits
+    {
+        static auto Get(const Holder& holder) noexcept
+        {
+            return holder.get();
+        }
+    };
+
+    /**
+     * @brief UserData, владеющий объектом T через указатель Holder.
+     * Использует метатаблицу класса T, поэтому методы и свойства T работают без изменений
+     * и получают T* напрямую: указатель на объект хранится рядом с Holder.
+     * Если у класса нет __gc (T тривиально разрушаем), метатаблица класса не меняется:
+     * указатель освобождает отдельный объект-финализатор в последнем user value,
+     * и объекты T, хранящиеся на месте, по-прежнему не регистрируются для финализации.
+     *
+     * @tparam T пользовательский тип
+     * @tparam Holder владеющий указатель: std::unique_ptr, std::shared_ptr или указатель с интрузивным счетчиком
+     */
+    template<typename T, typename Holder>
+    struct UserData : Internal::UserDataPtr<T>
+    {
+        using _UserDataValue = Internal::UserDataPtr<T>;
+        using _UserDataValue::_UserDataValue;
+        using Object = UserData<T>;
+
+        struct Data : Internal::UserDataHeader
+        {
+            T* object;
+            Holder holder;
+        };
+
+    private:
+        static void* ObjectOf(Internal::UserDataHeader* header)
+        {
+            return static_cast<Data*>(header)->object;
+        }
+
+        static void DestroyHolder(Internal::UserDataHeader* header)
+        {
+            static_cast<Data*>(header)->holder.~Holder();
+        }
+
+        static inline const Internal::StorageType s_storage{ &Object::GetType(), &ObjectOf, &DestroyHolder };
+
+    public:
+        /**
+         * @brief Помещает на стек UserData, забирающий holder. Пустой указатель помещается как nil.
+         *
+         * @param l
+         * @param holder
+         * @return T* объект
+         */
+        static T* Push(lua_State* l, Holder holder)
+        {
+            T* const object = HolderTraits<Holder>::Get(holder);
+            if (object == nullptr)
+            {
+                lua_pushnil(l);
+                return nullptr;
+            }
+
+            const int uservalues = Object::PushNewObjectMetaTable(l);
+            const bool has_gc = lua_getfield(l, -1, "__gc") != LUA_TNIL;
+            lua_pop(l, 1);
+            Data* const data = static_cast<Data*>(lua_newuserdatauv(l, sizeof(Data), has_gc ? uservalues : uservalues + 1));
+            data->Init(&s_storage);
+            data->MarkDestroyed();
+            lua_insert(l, -2);
+            lua_setmetatable(l, -2);
+            if (!has_gc)
+            {
+                PushFinalizer(l, -1);
+                lua_setiuservalue(l, -2, uservalues + 1);
+            }
+            new(&data->holder) Holder(std::move(holder));
+            data->object = object;
+            data->Init(&s_storage);
+            return object;
+        }
+
+        /**
+         * @brief Проверяет является ли объект по индексу на стеке UserData<T, Holder>
+         *
+         * @param l
+         * @param index
+         * @return true
+         * @return false
+         */
+        static bool IsUserData(lua_State* l, int index)
+        {
+            return ToHolder(l, index) != nullptr;
+        }
+
+        /**
+         * @brief Возвращает указатель, которым владеет UserData по индексу на стеке,
+         * или nullptr, если объект хранится иначе или уничтожен.
+         *
+         * @param l
+         * @param index
+         * @return Holder*
+         */
+        static Holder* ToHolder(lua_State* l, int index)
+        {
+            if (!Object::IsInstance(l, index))
+                return nullptr;
+
+            Internal::UserDataHeader* const header = static_cast<Internal::UserDataHeader*>(lua_touserdata(l, index));
+            if (!header->Is(&s_storage))
+                return nullptr;
+            return &static_cast<Data*>(header)->holder;
+        }
+
+        /**
+         * @brief Забирает указатель у UserData по индексу на стеке без копирования объекта.
+         * После этого объект в Lua считается уничтоженным.
+         *
+         * @param l
+         * @param index
+         * @return Holder
+         */
+        static Holder Release(lua_State* l, int index)
+        {
+            Holder* const holder = CheckHolder(l, index);
+            Holder result = std::move(*holder);
+            holder->~Holder();
+            static_cast<Internal::UserDataHeader*>(lua_touserdata(l, index))->MarkDestroyed();
+            return result;
+        }
+
+        /**
+         * @brief Возвращает копию указателя UserData по индексу на стеке
+         *
+         * @param l
+         * @param index
+         * @return Holder
+         */
+        static Holder GetHolder(lua_State* l, int index)
+        {
+            return *CheckHolder(l, index);
+        }
+
+        static T* ValidateUserData(lua_State* l, int index)
+        {
+            return Object::ValidateUserData(l, index);
+        }
+
+    private:
+        static Holder* CheckHolder(lua_State* l, int index)
+        {
+            Holder* const holder = ToHolder(l, index);
+            if (holder == nullptr)
+            {
+                Object::ValidateUserData(l, index);
+                luaL_argerror(l, index, "userdata doesn't own object through this pointer type");
+            }
+            return holder;
+        }
+
+        struct FinalizerMetaTable : public RegistryTableBase<FinalizerMetaTable> {};
+
+        /**
+         * @brief Помещает на стек финализатор объекта по индексу index.
+         * Объект и финализатор ссылаются друг на друга через user value, поэтому объект
+         * остается в памяти, пока не выполнен __gc финализатора.
+         *
+         * @param l
+         * @param index
+         */
+        static void PushFinalizer(lua_State* l, int index)
+        {
+            index = lua_absindex(l, index);
+            lua_newuserdatauv(l, 0, 1);
+            lua_pushvalue(l, index);
+            lua_setiuservalue(l, -2, 1);
+
+            if (FinalizerMetaTable::Push(l) == LUA_TNIL)
+            {
+                lua_pop(l, 1);
+                lua_createtable(l, 0, 1);
+                lua_pushcfunction(l, FinalizerFunction);
+                lua_setfield(l, -2, "__gc");
+                lua_pushvalue(l, -1);
+                lua_setregp(l, FinalizerMetaTable::GetKey());
+            }
+            lua_setmetatable(l, -2);
+        }
+
+        static int FinalizerFunction(lua_State* l)
+        {
+            lua_getiuservalue(l, 1, 1);
+            Object::Destroy(l, 2);
+            return 0;
+        }
+    };
+
+    template<typename T>
+    struct StackType<std::shared_ptr<T>>
+    {
+        using UD = UserData<T, std::shared_ptr<T>>;
+
+        static bool Check(lua_State* l, int index)
+        {
+            return UD::IsUserData(l, index);
+        }
+
+        static std::shared_ptr<T> Get(lua_State* l, int index)
+        {
+            return UD::GetHolder(l, index);
+        }
+
+        static void Push(lua_State* l, const std::shared_ptr<T>& value)
+        {
+            UD::Push(l, value);
+        }
+    };
+
+    /**
+     * @brief std::unique_ptr аргументом функции забирает объект у Lua,
+     * функция должна принимать его по ссылке: std::unique_ptr<T>&.
+     * Объект забирается после успешного чтения остальных аргументов и проверки всех
+     * таких аргументов, поэтому при ошибке в аргументах он остается у Lua.
+     * Один и тот же объект, переданный двумя такими аргументами, - ошибка аргумента.
+     *
+     * @tparam T
+     * @tparam D
+     */
+    template<typename T, typename D>
+    struct StackType<std::unique_ptr<T, D>>
+    {
+        using UD = UserData<T, std::unique_ptr<T, D>>;
+
+        static constexpr bool TransfersOwnership = true;
+
+        static bool Check(lua_State* l, int index)
+        {
+            return UD::IsUserData(l, index);
+        }
+
+        static std::unique_ptr<T, D> Get(lua_State* l, int index)
+        {
+            return UD::Release(l, index);
+        }
+
+        static void Push(lua_State* l, std::unique_ptr<T, D>& value)
+        {
+            UD::Push(l, std::move(value));
+        }
+
+        static void Push(lua_State* l, std::unique_ptr<T, D>&& value)
+        {
+            UD::Push(l, std::move(value));
+        }
+    };
+}
@@ -0,0 +1,907 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "Types.hpp"
+#include "Libs.hpp"
+#include "StackObject.hpp"
+#include "RefObject.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+
+namespace LTL
+{
+    namespace Internal
+    {
+        /**
+         * @brief Поиск символов, требующих особой обработки в строках JSON:
+         * кавычки, обратной косой черты и управляющих символов.
+         * Данные просматриваются словами по 8 байт (SWAR), что позволяет
+         * пропускать обычный текст без побайтового ветвления.
+         */
+        namespace JsonScanner
+        {
+            constexpr uint64_t Ones = ~uint64_t(0) / 255;
+            constexpr uint64_t High = Ones * 0x80;
+
+            inline uint64_t Load(const char* p)
+            {
+                uint64_t word;
+                std::memcpy(&word, p, sizeof(word));
+                return word;
+            }
+
+            constexpr uint64_t HasZero(uint64_t word)
+            {
+                return (word - Ones) & ~word & High;
+            }
+
+            constexpr uint64_t HasByte(uint64_t word, uint8_t byte)
+            {
+                return HasZero(word ^ (Ones * byte));
+            }
+
+            constexpr uint64_t HasLess(uint64_t word, uint8_t n)
+            {
+                return (word - Ones * n) & ~word & High;
+            }
+
+            constexpr bool IsSpecial(char c)
+            {
+                return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+            }
+
+            /**
+             * @brief Возвращает указатель на первый особый символ или end.
+             *
+             * @param p
+             * @param end
+             * @return const char*
+             */
+            inline const char* FindSpecial(const char* p, const char* end)
+            {
+                while (end - p >= static_cast<ptrdiff_t>(sizeof(uint64_t)))
+                {
+                    const uint64_t word = Load(p);
+                    if (HasByte(word, '"') | HasByte(word, '\\') | HasLess(word, 0x20))
+                        break;
+                    p += sizeof(uint64_t);
+                }
+                while (p != end && !IsSpecial(*p))
+                {
+                    ++p;
+                }
+                return p;
+            }
+        }
+
+        /// @brief Максимальная вложенность таблиц и массивов JSON
+        constexpr int JsonMaxDepth = 200;
+
+        /**
+         * @brief Записывает значение со стека в буфер в формате JSON.
+         * Таблица с ключами 1..n записывается массивом, иначе объектом.
+         * Ключи объекта должны быть строками или целыми числами.
+         */
+        class JsonEncoder
+        {
+        public:
+            JsonEncoder(lua_State* l, std::string& out) : m_state(l), m_out(out) {}
+
+            bool Encode(int index, int depth = 0)
+            {
+                lua_State* const l = m_state;
+                index = lua_absindex(l, index);
+                switch (lua_type(l, index))
+                {
+                case LUA_TNIL:
+                    m_out.append("null", 4);
+                    return true;
+                case LUA_TBOOLEAN:
+                    if (lua_toboolean(l, index))
+                    {
+                        m_out.append("true", 4);
+                    }
+                    else
+                    {
+                        m_out.append("false", 5);
+                    }
+                    return true;
+                case LUA_TNUMBER:
+                    return EncodeNumber(index);
+                case LUA_TSTRING:
+                {
+                    size_t len = 0;
+                    const char* s = lua_tolstring(l, index, &len);
+                    EncodeString(s, len);
+                    return true;
+                }
+                case LUA_TTABLE:
+                    return EncodeTable(index, depth);
+                case LUA_TLIGHTUSERDATA:
+                    if (lua_touserdata(l, index) == nullptr)
+                    {
+                        m_out.append("null", 4);
+                        return true;
+                    }
+                    return Fail("can't encode light userdata");
+                default:
+                    return Fail("can't encode value of this type");
+                }
+            }
+
+            const char* Error()const noexcept
+            {
+                return m_error;
+            }
+
+        private:
+            bool Fail(const char* error)
+            {
+                m_error = error;
+                return false;
+            }
+
+            void EncodeInteger(lua_Integer value)
+            {
+                char buffer[32];
+                const auto result = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<long long>(value));
+                m_out.append(buffer, result.ptr);
+            }
+
+            bool EncodeNumber(int index)
+            {
+                if (lua_isinteger(m_state, index))
+                {
+                    EncodeInteger(lua_tointeger(m_state, index));
+                    return true;
+                }
+
+                const double value = static_cast<double>(lua_tonumber(m_state, index));
+                if (!std::isfinite(value))
+                    return Fail("can't encode NaN or infinity");
+
+                char buffer[32];
+                const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+                m_out.append(buffer, result.ptr);
+                // Сохраняем подтип числа: 1.0 не должно стать целым после декодирования
+                if (std::find_if(buffer, result.ptr, [](char c) { return c == '.' || c == 'e'; }) == result.ptr)
+                {
+                    m_out.append(".0", 2);
+                }
+                return true;
+            }
+
+            void EncodeString(const char* s, size_t len)
+            {
+                static constexpr char hex[] = "0123456789abcdef";
+                const char* p = s;
+                const char* const end = s + len;
+
+                m_out.push_back('"');
+                while (true)
+                {
+                    const char* special = JsonScanner::FindSpecial(p, end);
+                    m_out.append(p, special);
+                    if (special == end)
+                        break;
+
+                    switch (*special)
+                    {
+                    case '"': m_out.append("\\\"", 2); break;
+                    case '\\': m_out.append("\\\\", 2); break;
+                    case '\n': m_out.append("\\n", 2); break;
+                    case '\r': m_out.append("\\r", 2); break;
+                    case '\t': m_out.append("\\t", 2); break;
+                    case '\b': m_out.append("\\b", 2); break;
+                    case '\f': m_out.append("\\f", 2); break;
+                    default:
+                    {
+                        const unsigned char c = static_cast<unsigned char>(*special);
+                        const char escape[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+                        m_out.append(escape, sizeof(escape));
+                    }
+                    }
+                    p = special + 1;
+                }
+                m_out.push_back('"');
+            }
+
+            bool IsArray(int index, lua_Integer n)
+            {
+                lua_State* const l = m_state;
+                if (n == 0)
+                    return false;
+
+                lua_Integer count = 0;
+                lua_pushnil(l);
+                while (lua_next(l, index))
+                {
+                    lua_pop(l, 1);
+                    if (!lua_isinteger(l, -1))
+                    {
+                        lua_pop(l, 1);
+                        return false;
+                    }
+                    const lua_Integer key = lua_tointeger(l, -1);
+                    if (key < 1 || key > n)
+                    {
+                        lua_pop(l, 1);
+                        return false;
+                    }
+                    count++;
+                }
+                return count == n;
+            }
+
+            bool EncodeTable(int index, int depth)
+            {
+                lua_State* const l = m_state;
+                if (depth >= JsonMaxDepth)
+                    return Fail("table nesting is too deep or has cycles");
+                if (!lua_checkstack(l, 3))
+                    return Fail("table nesting is too deep");
+
+                const lua_Integer n = static_cast<lua_Integer>(lua_rawlen(l, index));
+                if (IsArray(index, n))
+                {
+                    m_out.push_back('[');
+                    for (lua_Integer i = 1; i <= n; i++)
+                    {
+                        if (i != 1)
+                        {
+                            m_out.push_back(',');
+                        }
+                        lua_rawgeti(l, index, i);
+                        if (!Encode(-1, depth + 1))
+                            return false;
+                        lua_pop(l, 1);
+                    }
+                    m_out.push_back(']');
+                    return true;
+                }
+
+                bool first = true;
+                m_out.push_back('{');
+                lua_pushnil(l);
+                while (lua_next(l, index))
+                {
+                    if (!first)
+                    {
+                        m_out.push_back(',');
+                    }
+                    first = false;
+
+                    switch (lua_type(l, -2))
+                    {
+                    case LUA_TSTRING:
+                    {
+                        size_t len = 0;
+                        const char* s = lua_tolstring(l, -2, &len);
+                        EncodeString(s, len);
+                        break;
+                    }
+                    case LUA_TNUMBER:
+                        // Нельзя вызывать lua_tolstring для ключа: это сломает lua_next
+                        if (!lua_isinteger(l, -2))
+                            return Fail("can't encode non-integer number key");
+                        m_out.push_back('"');
+                        EncodeInteger(lua_tointeger(l, -2));
+                        m_out.push_back('"');
+                        break;
+                    default:
+                        return Fail("can't encode table key of this type");
+                    }
+                    m_out.push_back(':');
+                    if (!Encode(-1, depth + 1))
+                        return false;
+                    lua_pop(l, 1);
+                }
+                m_out.push_back('}');
+                return true;
+            }
+
+            lua_State* const m_state;
+            std::string& m_out;
+            const char* m_error = nullptr;
+        };
+
+        /**
+         * @brief Разбирает текст JSON и помещает результат на стек.
+         * Строки без escape-последовательностей передаются в ВМ без копирования,
+         * остальные собираются в переиспользуемом буфере.
+         * null декодируется в JSON null (легкая userdata NULL).
+         */
+        class JsonDecoder
+        {
+        public:
+            JsonDecoder(lua_State* l, std::string_view text, std::string& scratch)
+                : m_state(l), m_begin(text.data()), m_pos(text.data()), m_end(text.data() + text.size()), m_scratch(scratch) {}
+
+            bool Decode()
+            {
+                SkipWhitespace();
+                if (!ParseValue(0))
+                    return false;
+                SkipWhitespace();
+                if (m_pos != m_end)
+                    return Fail("unexpected data after value");
+                return true;
+            }
+
+            const char* Error()const noexcept
+            {
+                return m_error;
+            }
+
+            /**
+             * @brief Смещение в байтах, на котором произошла ошибка.
+             *
+             * @return size_t
+             */
+            size_t Position()const noexcept
+            {
+                return static_cast<size_t>(m_pos - m_begin);
+            }
+
+        private:
+            bool Fail(const char* error)
+            {
+                m_error = error;
+                return false;
+            }
+
+            static constexpr bool IsDigit(char c)
+            {
+                return c >= '0' && c <= '9';
+            }
+
+            void SkipWhitespace()
+            {
+                while (m_pos != m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+                {
+                    ++m_pos;
+                }
+            }
+
+            bool Expect(std::string_view word)
+            {
+                if (static_cast<size_t>(m_end - m_pos) < word.size() || std::memcmp(m_pos, word.data(), word.size()) != 0)
+                    return Fail("invalid literal");
+                m_pos += word.size();
+                return true;
+            }
+
+            bool ParseValue(int depth)
+            {
+                lua_State* const l = m_state;
+                if (m_pos == m_end)
+                    return Fail("unexpected end of data");
+
+                switch (*m_pos)
+                {
+                case '{':
+                    return ParseObject(depth);
+                case '[':
+                    return ParseArray(depth);
+                case '"':
+                    ++m_pos;
+                    return ParseString();
+                case 't':
+                    if (!Expect("true"))
+                        return false;
+                    lua_pushboolean(l, true);
+                    return true;
+                case 'f':
+                    if (!Expect("false"))
+                        return false;
+                    lua_pushboolean(l, false);
+                    return true;
+                case 'n':
+                    if (!Expect("null"))
+                        return false;
+                    lua_pushlightuserdata(l, nullptr);
+                    return true;
+                default:
+                    return ParseNumber();
+                }
+            }
+
+            bool ParseNumber()
+            {
+                const char* const start = m_pos;
+                const char* p = m_pos;
+                bool is_float = false;
+
+                if (p != m_end && *p == '-')
+                {
+                    ++p;
+                }
+                if (p == m_end || !IsDigit(*p))
+                    return Fail("unexpected character");
+                if (*p == '0')
+                {
+                    ++p;
+                }
+                else
+                {
+                    while (p != m_end && IsDigit(*p)) ++p;
+                }
+                if (p != m_end && *p == '.')
+                {
+                    ++p;
+                    if (p == m_end || !IsDigit(*p))
+                        return Fail("invalid number");
+                    while (p != m_end && IsDigit(*p)) ++p;
+                    is_float = true;
+                }
+                if (p != m_end && (*p == 'e' || *p == 'E'))
+                {
+                    ++p;
+                    if (p != m_end && (*p == '+' || *p == '-'))
+                    {
+                        ++p;
+                    }
+                    if (p == m_end || !IsDigit(*p))
+                        return Fail("invalid number");
+                    while (p != m_end && IsDigit(*p)) ++p;
+                    is_float = true;
+                }
+
+                if (!is_float)
+                {
+                    long long value = 0;
+                    const auto result = std::from_chars(start, p, value);
+                    if (result.ec == std::errc{})
+                    {
+                        m_pos = p;
+                        lua_pushinteger(m_state, static_cast<lua_Integer>(value));
+                        return true;
+                    }
+                    // Не помещается в целое - читаем как вещественное
+                }
+
+                double value = 0;
+                const auto result = std::from_chars(start, p, value);
+                if (result.ec != std::errc{})
+                    return Fail("number is out of range");
+                m_pos = p;
+                lua_pushnumber(m_state, static_cast<lua_Number>(value));
+                return true;
+            }
+
+            bool ReadHex4(uint32_t& value)
+            {
+                if (m_end - m_pos < 4)
+                    return Fail("invalid unicode escape");
+                value = 0;
+                for (int i = 0; i < 4; i++)
+                {
+                    const char c = *m_pos++;
+                    value <<= 4;
+                    if (c >= '0' && c <= '9') value |= c - '0';
+                    else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+                    else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+                    else return Fail("invalid unicode escape");
+                }
+                return true;
+            }
+
+            void AppendUtf8(uint32_t cp)
+            {
+                if (cp < 0x80)
+                {
+                    m_scratch.push_back(static_cast<char>(cp));
+                }
+                else if (cp < 0x800)
+                {
+                    m_scratch.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+                    m_scratch.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+                }
+                else if (cp < 0x10000)
+                {
+                    m_scratch.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+                    m_scratch.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                    m_scratch.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+                }
+                else
+                {
+                    m_scratch.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+                    m_scratch.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+                    m_scratch.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                    m_scratch.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+                }
+            }
+
+            bool ParseEscape()
+            {
+                if (m_pos == m_end)
+                    return Fail("unterminated string");
+
+                const char c = *m_pos++;
+                switch (c)
+                {
+                case '"': case '\\': case '/': m_scratch.push_back(c); return true;
+                case 'b': m_scratch.push_back('\b'); return true;
+                case 'f': m_scratch.push_back('\f'); return true;
+                case 'n': m_scratch.push_back('\n'); return true;
+                case 'r': m_scratch.push_back('\r'); return true;
+                case 't': m_scratch.push_back('\t'); return true;
+                case 'u':
+                {
+                    uint32_t cp = 0;
+                    if (!ReadHex4(cp))
+                        return false;
+                    if (cp >= 0xD800 && cp <= 0xDBFF)
+                    {
+                        uint32_t low = 0;
+                        if (m_end - m_pos < 2 || m_pos[0] != '\\' || m_pos[1] != 'u')
+                            return Fail("invalid unicode escape");
+                        m_pos += 2;
+                        if (!ReadHex4(low))
+                            return false;
+                        if (low < 0xDC00 || low > 0xDFFF)
+                            return Fail("invalid unicode escape");
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    else if (cp >= 0xDC00 && cp <= 0xDFFF)
+                    {
+                        return Fail("invalid unicode escape");
+                    }
+                    AppendUtf8(cp);
+                    return true;
+                }
+                default:
+                    return Fail("invalid escape");
+                }
+            }
+
+            bool ParseString()
+            {
+                lua_State* const l = m_state;
+                const char* special = JsonScanner::FindSpecial(m_pos, m_end);
+                if (special != m_end && *special == '"')
+                {
+                    lua_pushlstring(l, m_pos, static_cast<size_t>(special - m_pos));
+                    m_pos = special + 1;
+                    return true;
+                }
+
+                m_scratch.clear();
+                while (true)
+                {
+                    m_scratch.append(m_pos, special);
+                    m_pos = special;
+                    if (special == m_end)
+                        return Fail("unterminated string");
+                    if (*special == '"')
+                        break;
+                    if (*special != '\\')
+                        return Fail("control character in string");
+
+                    ++m_pos;
+                    if (!ParseEscape())
+                        return false;
+                    special = JsonScanner::FindSpecial(m_pos, m_end);
+                }
+                lua_pushlstring(l, m_scratch.data(), m_scratch.size());
+                ++m_pos;
+                return true;
+            }
+
+            bool ParseArray(int depth)
+            {
+                lua_State* const l = m_state;
+                if (depth >= JsonMaxDepth || !lua_checkstack(l, 3))
+                    return Fail("nesting is too deep");
+
+                ++m_pos;
+                lua_createtable(l, 0, 0);
+                const int table = lua_gettop(l);
+
+                SkipWhitespace();
+                if (m_pos != m_end && *m_pos == ']')
+                {
+                    ++m_pos;
+                    return true;
+                }
+
+                for (lua_Integer i = 1;; i++)
+                {
+                    SkipWhitespace();
+                    if (!ParseValue(depth + 1))
+                        return false;
+                    lua_rawseti(l, table, i);
+
+                    SkipWhitespace();
+                    if (m_pos == m_end)
+                        return Fail("unexpected end of data");
+                    const char c = *m_pos++;
+                    if (c == ']')
+                        return true;
+                    if (c != ',')
+                    {
+                        --m_pos;
+                        return Fail("expected ',' or ']'");
+                    }
+                }
+            }
+
+            bool ParseObject(int depth)
+            {
+                lua_State* const l = m_state;
+                if (depth >= JsonMaxDepth || !lua_checkstack(l, 4))
+                    return Fail("nesting is too deep");
+
+                ++m_pos;
+                lua_createtable(l, 0, 0);
+                const int table = lua_gettop(l);
+
+                SkipWhitespace();
+                if (m_pos != m_end && *m_pos == '}')
+                {
+                    ++m_pos;
+                    return true;
+                }
+
+                while (true)
+                {
+                    SkipWhitespace();
+                    if (m_pos == m_end || *m_pos != '"')
+                        return Fail("expected string key");
+                    ++m_pos;
+                    if (!ParseString())
+                        return false;
+
+                    SkipWhitespace();
+                    if (m_pos == m_end || *m_pos != ':')
+                        return Fail("expected ':'");
+                    ++m_pos;
+
+                    SkipWhitespace();
+                    if (!ParseValue(depth + 1))
+                        return false;
+                    lua_rawset(l, table);
+
+                    SkipWhitespace();
+                    if (m_pos == m_end)
+                        return Fail("unexpected end of data");
+                    const char c = *m_pos++;
+                    if (c == '}')
+                        return true;
+                    if (c != ',')
+                    {
+                        --m_pos;
+                        return Fail("expected ',' or '}'");
+                    }
+                }
+            }
+
+            lua_State* const m_state;
+            const char* const m_begin;
+            const char* m_pos;
+            const char* const m_end;
+            std::string& m_scratch;
+            const char* m_error = nullptr;
+        };
+    }
+
+    /**
+     * @brief Кодирование и декодирование JSON без промежуточного представления в C++.
+     * JSON null представлен легкой userdata NULL.
+     */
+    namespace Json
+    {
+        inline void PushNull(lua_State* l)
+        {
+            lua_pushlightuserdata(l, nullptr);
+        }
+
+        inline bool IsNull(lua_State* l, int index)
+        {
+            return lua_islightuserdata(l, index) && lua_touserdata(l, index) == nullptr;
+        }
+
+        /**
+         * @brief Дописывает значение в конец буфера в формате JSON.
+         * Буфер можно переиспользовать между вызовами, чтобы не выделять память заново.
+         *
+         * @param value
+         * @param out
+         */
+        inline void Encode(const StackObjectView& value, std::string& out)
+        {
+            lua_State* const l = value.GetState();
+            const int top = lua_gettop(l);
+            const char* error = nullptr;
+            {
+                Internal::JsonEncoder encoder{ l, out };
+                if (!encoder.Encode(value.GetIndex()))
+                {
+                    error = encoder.Error();
+                }
+            }
+            lua_settop(l, top);
+            if (error)
+            {
+                luaL_error(l, "%s", error);
+            }
+        }
+
+        /**
+         * @brief Возвращает значение в формате JSON.
+         *
+         * @param value
+         * @return std::string
+         */
+        inline std::string Encode(const StackObjectView& value)
+        {
+            std::string out;
+            Encode(value, out);
+            return out;
+        }
+
+        template<typename RefAccess>
+        inline void Encode(const RefObject<RefAccess>& value, std::string& out)
+        {
+            value.Push();
+            Encode(StackObjectView{ value.GetState() }, out);
+            lua_pop(value.GetState(), 1);
+        }
+
+        template<typename RefAccess>
+        inline std::string Encode(const RefObject<RefAccess>& value)
+        {
+            std::string out;
+            Encode(value, out);
+            return out;
+        }
+
+        /**
+         * @brief Разбирает текст JSON и помещает результат на стек.
+         *
+         * @param l
+         * @param text
+         * @param scratch буфер для строк с escape-последовательностями
+         * @return StackObjectView
+         */
+        inline StackObjectView Decode(lua_State* l, std::string_view text, std::string& scratch)
+        {
+            const int top = lua_gettop(l);
+            const char* error = nullptr;
+            size_t position = 0;
+            {
+                Internal::JsonDecoder decoder{ l, text, scratch };
+                if (!decoder.Decode())
+                {
+                    error = decoder.Error();
+                    position = decoder.Position();
+                }
+            }
+            if (error)
+            {
+                lua_settop(l, top);
+                luaL_error(l, "%s at position %I", error, static_cast<lua_Integer>(position + 1));
+            }
+            return { l };
+        }
+
+        inline StackObjectView Decode(lua_State* l, std::string_view text)
+        {
+            std::string scratch;
+            return Decode(l, text, scratch);
+        }
+    }
+
+    namespace Internal
+    {
+        /**
+         * @brief Общий буфер функций библиотеки json, хранится в их upvalue.
+         */
+        struct JsonLibState
+        {
+            std::string buffer;
+
+            /// @brief Буферы большего размера освобождаются после вызова
+            static constexpr size_t MaxRetainedCapacity = 1 << 20;
+
+            static JsonLibState& Get(lua_State* l)
+            {
+                return *static_cast<JsonLibState*>(lua_touserdata(l, lua_upvalueindex(1)));
+            }
+
+            void Trim()
+            {
+                if (buffer.capacity() > MaxRetainedCapacity)
+                {
+                    std::string{}.swap(buffer);
+                }
+            }
+
+            static int GC(lua_State* l)
+            {
+                static_cast<JsonLibState*>(lua_touserdata(l, 1))->~JsonLibState();
+                return 0;
+            }
+        };
+
+        inline int JsonEncode(lua_State* l)
+        {
+            luaL_checkany(l, 1);
+            JsonLibState& state = JsonLibState::Get(l);
+            state.buffer.clear();
+
+            const char* error = nullptr;
+            {
+                JsonEncoder encoder{ l, state.buffer };
+                if (!encoder.Encode(1))
+                {
+                    error = encoder.Error();
+                }
+            }
+            if (error)
+            {
+                return luaL_error(l, "%s", error);
+            }
+
+            lua_pushlstring(l, state.buffer.data(), state.buffer.size());
+            state.Trim();
+            return 1;
+        }
+
+        inline int JsonDecode(lua_State* l)
+        {
+            size_t len = 0;
+            const char* s = luaL_checklstring(l, 1, &len);
+            JsonLibState& state = JsonLibState::Get(l);
+
+            const char* error = nullptr;
+            size_t position = 0;
+            {
+                JsonDecoder decoder{ l, { s, len }, state.buffer };
+                if (!decoder.Decode())
+                {
+                    error = decoder.Error();
+                    position = decoder.Position();
+                }
+            }
+            state.Trim();
+            if (error)
+            {
+                return luaL_error(l, "%s at position %I", error, static_cast<lua_Integer>(position + 1));
+            }
+            return 1;
+        }
+
+        inline int OpenJsonLib(lua_State* l)
+        {
+            lua_createtable(l, 0, 3);
+
+            new (lua_newuserdata(l, sizeof(JsonLibState))) JsonLibState{};
+            lua_createtable(l, 0, 1);
+            lua_pushcfunction(l, JsonLibState::GC);
+            lua_setfield(l, -2, "__gc");
+            lua_setmetatable(l, -2);
+
+            lua_pushvalue(l, -1);
+            lua_pushcclosure(l, JsonEncode, 1);
+            lua_setfield(l, -3, "encode");
+            lua_pushcclosure(l, JsonDecode, 1);
+            lua_setfield(l, -2, "decode");
+
+            Json::PushNull(l);
+            lua_setfield(l, -2, "null");
+            return 1;
+        }
+    }
+
+    namespace Libs
+    {
+        /**
+         * @brief Библиотека json: encode, decode и null
+         *
+         */
+        constexpr Lib json{ "json", Internal::OpenJsonLib };
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "Types.hpp"
+#include "CState.hpp"
+#include <string_view>
+
+namespace LTL
+{
+    template <typename T>
+    class State;
+
+    /**
+     * @brief Заранее созданный в ВМ строковый ключ.
+     * Строка создается один раз и хранится в реестре, после чего помещается
+     * на стек по ссылке без повторного хеширования и поиска в таблице строк.
+     * Используется вместо const char* в Get/Set, RawGet/RawSet, operator[] и SelfCall.
+     * Ключ действителен для всех потоков ВМ, в которой был создан.
+     */
+    class Key
+    {
+    public:
+        Key() = default;
+
+        Key(lua_State* l, std::string_view name) : m_state(l)
+        {
+            lua_pushlstring(m_state, name.data(), name.size());
+            m_ref = RefGlobalAccess::GetRef(m_state);
+        }
+
+        template <typename T>
+        Key(const State<T>& state, std::string_view name) : Key(state.GetState()->Unwrap(), name) {}
+
+        Key(const Key& other) : m_state(other.m_state)
+        {
+            if (other.IsValid())
+            {
+                other.Push();
+                m_ref = RefGlobalAccess::GetRef(m_state);
+            }
+        }
+
+        Key(Key&& other) noexcept : m_state(other.m_state), m_ref(other.m_ref)
+        {
+            other.m_state = nullptr;
+            other.m_ref = LUA_NOREF;
+        }
+
+        Key& operator=(const Key& other)
+        {
+            if (this != &other)
+            {
+                *this = Key{ other };
+            }
+            return *this;
+        }
+
+        Key& operator=(Key&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Unref();
+                m_state = other.m_state;
+                m_ref = other.m_ref;
+                other.m_state = nullptr;
+                other.m_ref = LUA_NOREF;
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Помещает строку ключа на стек.
+         */
+        void Push()const
+        {
+            Push(m_state);
+        }
+
+        /**
+         * @brief Помещает строку ключа на стек другого потока той же ВМ.
+         *
+         * @param l
+         */
+        void Push(lua_State* l)const
+        {
+            RefGlobalAccess::PushRef(l, m_ref);
+        }
+
+        /**
+         * @brief Возвращает строку ключа, память принадлежит ВМ.
+         *
+         * @return std::string_view
+         */
+        std::string_view Name()const
+        {
+            Push();
+            size_t len = 0;
+            const char* s = lua_tolstring(m_state, -1, &len);
+            lua_pop(m_state, 1);
+            return { s, len };
+        }
+
+        bool IsValid()const noexcept
+        {
+            return m_state != nullptr && m_ref != LUA_NOREF;
+        }
+
+        lua_State* const GetState()const noexcept
+        {
+            return m_state;
+        }
+
+        ~Key()
+        {
+            Unref();
+        }
+
+    private:
+        void Unref()
+        {
+            if (IsValid())
+            {
+                RefGlobalAccess::Unref(m_state, m_ref);
+            }
+            m_ref = LUA_NOREF;
+        }
+
+        lua_State* m_state = nullptr;
+        int m_ref = LUA_NOREF;
+    };
+
+    template <>
+    struct StackType<Key>
+    {
+        static bool Check(lua_State* l, int index)
+        {
+            return lua_type(l, index) == LUA_TSTRING;
+        }
+
+        static void Push(lua_State* l, const Key& key)
+        {
+            key.Push(l);
+        }
+    };
+}
@@ -2,6 +2,7 @@
 #include "Internal.hpp"
 #include "Types.hpp"
 #include "LuaAux.hpp"
+#include "ExecutionBudget.hpp"
 #include "CState.hpp"
 #include "Libs.hpp"
 #include "Property.hpp"
@@ -17,3 +18,18 @@
 #include "Ref.hpp"
 #include "State.hpp"
 #include "STDContainers.hpp"
+#include "Serialization.hpp"
+#include "CopyValue.hpp"
+#include "Json.hpp"
+#include "Reflection.hpp"
+#include "Key.hpp"
+#include "FunctionHandle.hpp"
+#include "LuaFunction.hpp"
+#include "Collections.hpp"
+#include "NumericArray.hpp"
+#include "ScratchArena.hpp"
+#include "FrozenIndex.hpp"
+#include "Holder.hpp"
+#include "Operators.hpp"
+#include "ScratchPool.hpp"
+#include "DirtyTracker.hpp"
@@ -2,6 +2,7 @@
 #include "Types.hpp"
 #include "FuncArguments.hpp"
 #include <optional>
+#include <iterator>
 
 namespace LTL
 {
@@ -99,6 +100,16 @@ namespace LTL
         StackType<const_decay_t<T>>::Push(l, arg);
     }
 
+    /**
+     * @brief Помещает на стек временный объект.
+     * StackType с перегрузкой Push для T&& может забрать его содержимое вместо копирования.
+     */
+    template<typename T, typename = std::enable_if_t<!std::is_reference_v<T>>>
+    inline void PushValue(lua_State* l, T&& arg)
+    {
+        StackType<const_decay_t<T>>::Push(l, std::move(arg));
+    }
+
 #pragma region Push Args
 
     template<size_t N>
@@ -229,6 +240,7 @@ namespace LTL
         ERRSYNTAX = LUA_ERRSYNTAX,
         ERRMEM = LUA_ERRMEM,
         ERRERR = LUA_ERRERR,
+        ERRBUDGET = LUA_ERRERR + 2,
     };
 
     struct PCallReturnBase
@@ -313,6 +325,156 @@ namespace LTL
 
 #pragma endregion
 
+#pragma region Batch call functions
+
+    namespace Internal
+    {
+        template<typename T, typename = void>
+        struct IsTupleLike : std::false_type {};
+
+        template<typename T>
+        struct IsTupleLike<T, std::void_t<decltype(std::tuple_size<T>::value)>> : std::true_type {};
+
+        template<typename T>
+        constexpr int BatchArgsCount()
+        {
+            if constexpr (IsTupleLike<T>::value)
+            {
+                return static_cast<int>(std::tuple_size_v<T>);
+            }
+            else
+            {
+                return 1;
+            }
+        }
+
+        /**
+         * @brief Помещает на стек аргументы одного вызова пакета.
+         * Кортежи и пары раскрываются в несколько аргументов.
+         */
+        template<typename T>
+        size_t PushBatchArgs(lua_State* l, const T& args)
+        {
+            if constexpr (IsTupleLike<T>::value)
+            {
+                return std::apply([l](const auto& ...values) { return PushArgs(l, values...); }, args);
+            }
+            else
+            {
+                PushValue(l, args);
+                return 1;
+            }
+        }
+
+        template<typename Range>
+        size_t BatchSize(const Range& range)
+        {
+            using Iterator = decltype(std::begin(range));
+            using Category = typename std::iterator_traits<Iterator>::iterator_category;
+            if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>)
+            {
+                return static_cast<size_t>(std::distance(std::begin(range), std::end(range)));
+            }
+            else
+            {
+                return 0;
+            }
+        }
+
+        template<typename TReturn, typename Range>
+        constexpr int BatchStackSize()
+        {
+            using Element = std::decay_t<decltype(*std::begin(std::declval<const Range&>()))>;
+            constexpr int n_args = BatchArgsCount<Element>() + 1;
+            constexpr int n_results = std::is_void_v<TReturn> ? 0 : ResulltNum<TReturn>::value;
+            return 1 + (n_args > n_results ? n_args : n_results);
+        }
+    }
+
+    template<typename TReturn>
+    using BatchReturn = std::conditional_t<std::is_void_v<TReturn>, void, std::vector<TReturn>>;
+
+    /**
+     * @brief Вызывает функцию для каждого элемента диапазона.
+     * Функция помещается на стек один раз, место на стеке проверяется один раз.
+     * Элемент-кортеж передается как несколько аргументов.
+     * Ошибка в любом вызове прерывает весь пакет.
+     *
+     * @tparam TReturn тип результата одного вызова
+     * @param l
+     * @param func
+     * @param range диапазон аргументов
+     * @return BatchReturn<TReturn> результаты в порядке элементов
+     */
+    template<typename TReturn = void, typename F, typename Range>
+    inline BatchReturn<TReturn> CallBatch(lua_State* l, const F& func, const Range& range)
+    {
+        luaL_checkstack(l, Internal::BatchStackSize<TReturn, Range>(), "not enough stack space for batch call");
+        PushValue(l, func);
+        const int func_index = lua_gettop(l);
+
+        if constexpr (std::is_void_v<TReturn>)
+        {
+            for (const auto& args : range)
+            {
+                lua_pushvalue(l, func_index);
+                const size_t n = Internal::PushBatchArgs(l, args);
+                CallStack<void>(l, n);
+            }
+            lua_pop(l, 1);
+        }
+        else
+        {
+            std::vector<TReturn> results;
+            results.reserve(Internal::BatchSize(range));
+            for (const auto& args : range)
+            {
+                lua_pushvalue(l, func_index);
+                const size_t n = Internal::PushBatchArgs(l, args);
+                results.push_back(CallStack<TReturn>(l, n));
+            }
+            lua_pop(l, 1);
+            return results;
+        }
+    }
+
+    /**
+     * @brief Безопасно вызывает функцию для каждого элемента диапазона.
+     * Каждый вызов защищен отдельно: ошибка записывается в результат
+     * соответствующего элемента, сообщение снимается со стека,
+     * остальные элементы продолжают обрабатываться.
+     *
+     * @tparam TReturn тип результата одного вызова
+     * @param l
+     * @param func
+     * @param range диапазон аргументов
+     * @return std::vector<PCallReturn<TReturn>> результаты в порядке элементов
+     */
+    template<typename TReturn = void, typename F, typename Range>
+    inline std::vector<PCallReturn<TReturn>> PCallBatch(lua_State* l, const F& func, const Range& range)
+    {
+        luaL_checkstack(l, Internal::BatchStackSize<TReturn, Range>(), "not enough stack space for batch call");
+        PushValue(l, func);
+        const int func_index = lua_gettop(l);
+
+        std::vector<PCallReturn<TReturn>> results;
+        results.reserve(Internal::BatchSize(range));
+        for (const auto& args : range)
+        {
+            lua_pushvalue(l, func_index);
+            const size_t n = Internal::PushBatchArgs(l, args);
+            results.push_back(PCallStack<TReturn>(l, n));
+            if (!results.back().IsOk())
+            {
+                lua_pop(l, 1);
+            }
+        }
+        lua_pop(l, 1);
+        return results;
+    }
+
+#pragma endregion
+
 #pragma region Push Result
 
     template<size_t Index, typename TResult>
@@ -353,6 +515,53 @@ namespace LTL
         return result.n_results;
     }
 
+    template<size_t Index, typename TResult>
+    inline size_t _PushMovedResult(lua_State* l, TResult& result)
+    {
+        return Index;
+    }
+
+    template<size_t Index, typename TResult, typename T, typename ...Ts>
+    inline size_t _PushMovedResult(lua_State* l, TResult& result)
+    {
+        PushValue<T>(l, std::move(std::get<Index>(result)));
+        return _PushMovedResult<Index + 1, TResult, Ts...>(l, result);
+    }
+
+    template<typename ...Ts>
+    inline size_t _PushMovedResult(lua_State* l, MultReturn<Ts...>& result)
+    {
+        return _PushMovedResult<0, MultReturn<Ts...>, Ts...>(l, result);
+    }
+
+    /**
+     * @brief Помещает на стек результат функции, который больше не нужен.
+     * Результат передается в StackType как rvalue, так что объекты и контейнеры перемещаются.
+     *
+     * @tparam UnwrappedT тип результата
+     * @tparam T тип, определяющий StackType
+     * @param l
+     * @param result
+     * @return size_t число значений на стеке
+     */
+    template<typename UnwrappedT, typename T = UnwrappedT, typename = std::enable_if_t<!std::is_reference_v<UnwrappedT>>>
+    inline size_t PushResult(lua_State* l, UnwrappedT&& result)
+    {
+        if constexpr (std::is_same_v<UnwrappedT, StackResult>)
+        {
+            return result.n_results;
+        }
+        else if constexpr (std::is_base_of_v<MultReturnBase, UnwrappedT>)
+        {
+            return _PushMovedResult(l, result);
+        }
+        else
+        {
+            StackType<T>::Push(l, std::move(result));
+            return 1;
+        }
+    }
+
 #pragma endregion
 
 #pragma region Upvalues Replace
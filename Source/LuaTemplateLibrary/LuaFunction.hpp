@@ -0,0 +1,271 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "Types.hpp"
+#include "FuncArguments.hpp"
+#include "RefObject.hpp"
+#include <algorithm>
+
+namespace LTL
+{
+    /**
+     * @brief Результат безопасного вызова с сообщением об ошибке.
+     * В отличие от PCallReturn сообщение об ошибке снимается со стека и сохраняется.
+     *
+     * @tparam T тип результата
+     */
+    template<typename T>
+    struct LuaResult : PCallReturn<T>
+    {
+        std::string error;
+
+        LuaResult(const T& result) : PCallReturn<T>(result, PCallResult::Ok) {}
+
+        LuaResult(PCallResult status, std::string error) : PCallReturn<T>(status), error(std::move(error)) {}
+    };
+
+    template<>
+    struct LuaResult<void> : PCallReturn<void>
+    {
+        std::string error;
+
+        LuaResult(PCallResult status, std::string error = {}) : PCallReturn<void>(status), error(std::move(error)) {}
+    };
+
+    namespace Internal
+    {
+        template<typename T>
+        struct ResultChecker
+        {
+            static bool Check(lua_State* l)
+            {
+                return StackType<T>::Check(l, -1);
+            }
+        };
+
+        template<typename ...Ts>
+        struct ResultChecker<MultReturn<Ts...>>
+        {
+            static bool Check(lua_State* l)
+            {
+                return Check<-static_cast<int>(sizeof...(Ts)), Ts...>(l);
+            }
+
+        private:
+            template<int Index>
+            static bool Check(lua_State* l)
+            {
+                return true;
+            }
+
+            template<int Index, typename T, typename ...TRest>
+            static bool Check(lua_State* l)
+            {
+                return StackType<T>::Check(l, Index) && Check<Index + 1, TRest...>(l);
+            }
+        };
+
+        /**
+         * @brief Возвращает основной поток ВМ, которому принадлежит данный поток.
+         * Ссылки, переживающие вызов функции, должны использовать его.
+         *
+         * @param l
+         * @return lua_State*
+         */
+        inline lua_State* MainThread(lua_State* l)
+        {
+            lua_rawgeti(l, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+            lua_State* const main = lua_tothread(l, -1);
+            lua_pop(l, 1);
+            return main;
+        }
+    }
+
+    template<typename Signature>
+    class LuaFunction;
+
+    /**
+     * @brief Типизированная ссылка на функцию Lua.
+     * Типы аргументов и результата известны на этапе компиляции,
+     * место на стеке проверяется один раз на вызов.
+     * Может быть аргументом CFunction и храниться после возврата из нее.
+     *
+     * @tparam R тип результата
+     * @tparam Args типы аргументов
+     */
+    template<typename R, typename ...Args>
+    class LuaFunction<R(Args...)>
+    {
+    public:
+        LuaFunction() = default;
+
+        LuaFunction(const GRefObject& func) : m_function(func) {}
+
+        LuaFunction(GRefObject&& func) noexcept : m_function(std::move(func)) {}
+
+        /**
+         * @brief Создает ссылку на функцию на стеке.
+         * Ссылка привязывается к основному потоку ВМ.
+         *
+         * @param l
+         * @param index
+         * @return LuaFunction
+         */
+        static LuaFunction FromStack(lua_State* l, int index)
+        {
+            lua_pushvalue(l, index);
+            lua_State* const main = Internal::MainThread(l);
+            if (main != l)
+            {
+                lua_xmove(l, main, 1);
+            }
+            return { GRefObject::FromTop(main) };
+        }
+
+        /**
+         * @brief Вызывает функцию в основном потоке ВМ, ошибки Lua не перехватываются.
+         * Внутри CFunction, которая может работать в сопрограмме, используйте Call с вызывающим потоком.
+         *
+         * @param args
+         * @return R
+         */
+        R operator()(Args... args)const
+        {
+            return Call(GetState(), std::forward<Args>(args)...);
+        }
+
+        /**
+         * @brief Вызывает функцию в потоке l той же ВМ, ошибки Lua не перехватываются.
+         * Ошибка раскручивает стек именно этого потока, поэтому из CFunction
+         * передается ее собственный lua_State (или CState*).
+         *
+         * @param l
+         * @param args
+         * @return R
+         */
+        R Call(lua_State* l, Args... args)const
+        {
+            luaL_checkstack(l, StackSize, "not enough stack space to call function");
+            Push(l);
+            (PushValue(l, args), ...);
+            return CallStack<R>(l, sizeof...(Args));
+        }
+
+        /**
+         * @brief Безопасно вызывает функцию в основном потоке ВМ.
+         *
+         * @param args
+         * @return LuaResult<R>
+         */
+        LuaResult<R> PCall(Args... args)const
+        {
+            return PCall(GetState(), std::forward<Args>(args)...);
+        }
+
+        /**
+         * @brief Безопасно вызывает функцию в потоке l той же ВМ.
+         * Ошибки исполнения, нехватка стека и неверный тип результата
+         * возвращаются в LuaResult вместе с сообщением.
+         *
+         * @param l
+         * @param args
+         * @return LuaResult<R>
+         */
+        LuaResult<R> PCall(lua_State* l, Args... args)const
+        {
+            if (!lua_checkstack(l, StackSize))
+                return { PCallResult::ERRMEM, "not enough stack space to call function" };
+
+            Push(l);
+            (PushValue(l, args), ...);
+            const PCallResult status = static_cast<PCallResult>(lua_pcall(l, static_cast<int>(sizeof...(Args)), NResults, 0));
+            if (status != PCallResult::Ok)
+            {
+                const char* message = lua_tostring(l, -1);
+                LuaResult<R> result{ status, message ? message : "unknown error" };
+                lua_pop(l, 1);
+                return result;
+            }
+
+            if constexpr (std::is_void_v<R>)
+            {
+                return { status };
+            }
+            else
+            {
+                if (!Internal::ResultChecker<R>::Check(l))
+                {
+                    lua_pop(l, NResults);
+                    return { PCallResult::ERRRUN, "function returned value of unexpected type" };
+                }
+                LuaResult<R> result{ StackResultGetter<R>::Get(l) };
+                lua_pop(l, NResults);
+                return result;
+            }
+        }
+
+        void Push()const
+        {
+            m_function.Push();
+        }
+
+        /**
+         * @brief Помещает функцию на стек данного потока той же ВМ.
+         *
+         * @param l
+         */
+        void Push(lua_State* l)const
+        {
+            m_function.Push(l);
+        }
+
+        bool IsValid()const noexcept
+        {
+            return GetState() != nullptr;
+        }
+
+        lua_State* const GetState()const noexcept
+        {
+            return m_function.GetState();
+        }
+
+        const GRefObject& GetRef()const noexcept
+        {
+            return m_function;
+        }
+
+    private:
+        static constexpr int NResults = std::is_void_v<R> ? 0 : ResulltNum<R>::value;
+        static constexpr int StackSize = std::max(static_cast<int>(sizeof...(Args)) + 1, NResults);
+
+        GRefObject m_function;
+    };
+
+    template<typename R, typename ...Args>
+    struct StackType<LuaFunction<R(Args...)>>
+    {
+        using Type = LuaFunction<R(Args...)>;
+
+        static Type Get(lua_State* l, int index)
+        {
+            luaL_checktype(l, index, LUA_TFUNCTION);
+            return Type::FromStack(l, index);
+        }
+
+        static bool Check(lua_State* l, int index)
+        {
+            return lua_isfunction(l, index);
+        }
+
+        static void Push(lua_State* l, const Type& value)
+        {
+            if (value.IsValid())
+            {
+                value.Push(l);
+            }
+            else
+            {
+                lua_pushnil(l);
+            }
+        }
+    };
+}
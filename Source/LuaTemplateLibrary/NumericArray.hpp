@@ -0,0 +1,207 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "Types.hpp"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace LTL::Internal
+{
+    /**
+     * @brief Является ли T встроенным числовым типом с IntParser или FloatParser.
+     *
+     * @tparam T
+     */
+    template<typename T>
+    struct IsNumericElement : std::disjunction<
+        std::conjunction<std::is_integral<T>, std::is_base_of<IntParser<T>, StackType<T>>>,
+        std::conjunction<std::is_floating_point<T>, std::is_base_of<FloatParser<T>, StackType<T>>>> {};
+
+    /**
+     * @brief Преобразование массива-таблицы в непрерывный массив чисел и обратно.
+     * Элементы читаются из ВМ блоками во временный массив lua_Integer или lua_Number,
+     * после чего блок сужается до T с проверкой диапазона одним циклом без ветвлений,
+     * который компилятор может векторизовать.
+     *
+     * @tparam T встроенный числовой тип
+     */
+    template<typename T>
+    struct NumericArray
+    {
+        static_assert(IsNumericElement<T>::value, "Provided not numeric type");
+
+        using Source = std::conditional_t<std::is_integral_v<T>, lua_Integer, lua_Number>;
+        static constexpr size_t ChunkSize = 256;
+
+        struct Error
+        {
+            const char* message = nullptr;
+            size_t position = 0;
+        };
+
+        /**
+         * @brief Читает n элементов таблицы в out.
+         *
+         * @param l
+         * @param index абсолютный индекс таблицы
+         * @param out
+         * @param n
+         * @param error заполняется при ошибке
+         * @return true если все элементы прочитаны
+         */
+        static bool Read(lua_State* l, int index, T* out, size_t n, Error& error)
+        {
+            Source stage[ChunkSize];
+            for (size_t base = 0; base < n; base += ChunkSize)
+            {
+                const size_t count = std::min(ChunkSize, n - base);
+                for (size_t i = 0; i < count; i++)
+                {
+                    int isnum = 0;
+                    lua_rawgeti(l, index, static_cast<lua_Integer>(base + i + 1));
+                    stage[i] = ToSource(l, &isnum);
+                    lua_pop(l, 1);
+                    if (!isnum)
+                    {
+                        error = { std::is_integral_v<T> ? "array element is not an integer" : "array element is not a number", base + i };
+                        return false;
+                    }
+                }
+
+                if (!Convert(stage, out + base, count))
+                {
+                    error = { "array element is out of range", base + FindOutOfRange(stage, count) };
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Читает таблицу в std::vector<T, A>, при ошибке вызывает ошибку Lua.
+         *
+         * @param l
+         * @param index
+         * @param allocator
+         * @return std::vector<T, A>
+         */
+        template<typename A = std::allocator<T>>
+        static std::vector<T, A> GetVector(lua_State* l, int index, const A& allocator = A{})
+        {
+            index = lua_absindex(l, index);
+            Error error;
+            {
+                std::vector<T, A> result(static_cast<size_t>(lua_rawlen(l, index)), allocator);
+                if (Read(l, index, result.data(), result.size(), error))
+                {
+                    return result;
+                }
+            }
+            luaL_error(l, "%s at index %I", error.message, static_cast<lua_Integer>(error.position + 1));
+            return {};
+        }
+
+        /**
+         * @brief Помещает на стек таблицу с n элементами in.
+         *
+         * @param l
+         * @param in
+         * @param n
+         */
+        static void Push(lua_State* l, const T* in, size_t n)
+        {
+            lua_createtable(l, static_cast<int>(n), 0);
+            for (size_t i = 0; i < n; i++)
+            {
+                if constexpr (std::is_integral_v<T>)
+                {
+                    lua_pushinteger(l, static_cast<lua_Integer>(in[i]));
+                }
+                else
+                {
+                    lua_pushnumber(l, static_cast<lua_Number>(in[i]));
+                }
+                lua_rawseti(l, -2, static_cast<lua_Integer>(i + 1));
+            }
+        }
+
+        /**
+         * @brief Сужает блок до T.
+         *
+         * @return false если хотя бы один элемент вне диапазона T
+         */
+        static bool Convert(const Source* in, T* out, size_t n)
+        {
+            unsigned ok = 1;
+            for (size_t i = 0; i < n; i++)
+            {
+                ok &= InRange(in[i]);
+                out[i] = static_cast<T>(in[i]);
+            }
+            return ok;
+        }
+
+    private:
+        static Source ToSource(lua_State* l, int* isnum)
+        {
+            if constexpr (std::is_integral_v<T>)
+            {
+                return lua_tointegerx(l, -1, isnum);
+            }
+            else
+            {
+                return lua_tonumberx(l, -1, isnum);
+            }
+        }
+
+        static unsigned InRange(Source v)
+        {
+            if constexpr (std::is_floating_point_v<T>)
+            {
+                if constexpr (sizeof(T) >= sizeof(Source))
+                {
+                    return 1;
+                }
+                else
+                {
+                    // бесконечности и NaN представимы, переполняются только конечные значения
+                    constexpr Source max = static_cast<Source>(std::numeric_limits<T>::max());
+                    const Source a = v < 0 ? -v : v;
+                    return !(a > max) | (a == std::numeric_limits<Source>::infinity());
+                }
+            }
+            else if constexpr (std::is_signed_v<T>)
+            {
+                if constexpr (sizeof(T) >= sizeof(Source))
+                {
+                    return 1;
+                }
+                else
+                {
+                    return (v >= static_cast<Source>(std::numeric_limits<T>::min())) & (v <= static_cast<Source>(std::numeric_limits<T>::max()));
+                }
+            }
+            else
+            {
+                if constexpr (sizeof(T) >= sizeof(Source))
+                {
+                    return v >= 0;
+                }
+                else
+                {
+                    return (v >= 0) & (v <= static_cast<Source>(std::numeric_limits<T>::max()));
+                }
+            }
+        }
+
+        static size_t FindOutOfRange(const Source* in, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                if (!InRange(in[i]))
+                    return i;
+            }
+            return n;
+        }
+    };
+}
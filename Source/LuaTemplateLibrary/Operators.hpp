@@ -0,0 +1,239 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "UserData.hpp"
+#include <functional>
+
+namespace LTL::Internal
+{
+    /**
+     * @brief Метаметоды для операторов C++, определенных у класса T.
+     * Поддержка оператора проверяется при компиляции для операндов (T, T), (T, число) и (число, T).
+     * На каждый оператор регистрируется одна функция, которая выбирает вариант по типу Lua операндов.
+     * Результат типа T вычисляется до создания UserData и перемещается в него,
+     * исключения операторов, как и в CFunction, превращаются в ошибки Lua.
+     *
+     * @tparam T класс
+     */
+    template<typename T>
+    struct Operators
+    {
+        using UData = UserData<T>;
+
+        template<typename Op, typename A, typename B>
+        static constexpr bool Supports = std::is_invocable_v<Op, const A&, const B&>;
+
+        /**
+         * @brief Поддерживает ли T бинарный оператор Op с собой или с числом типа Scalar
+         */
+        template<typename Op, typename Scalar>
+        static constexpr bool HasBinary = Supports<Op, T, T> || Supports<Op, T, Scalar> || Supports<Op, Scalar, T>;
+
+        template<typename Op>
+        static constexpr bool HasUnary = std::is_invocable_v<Op, const T&>;
+
+        template<typename Op, typename A, typename B>
+        static constexpr bool NoThrow = !Supports<Op, A, B> || std::is_nothrow_invocable_v<Op, const A&, const B&>;
+
+        /**
+         * @brief Не выбрасывают ли исключений все варианты оператора и перемещение результата
+         */
+        template<typename Op, typename Scalar>
+        static constexpr bool NoThrowBinary = std::is_nothrow_move_constructible_v<T>
+            && NoThrow<Op, T, T> && NoThrow<Op, T, Scalar> && NoThrow<Op, Scalar, T>;
+
+        template<typename Op>
+        static constexpr bool NoThrowUnary = std::is_nothrow_move_constructible_v<T> && std::is_nothrow_invocable_v<Op, const T&>;
+
+        /**
+         * @brief Устанавливает метаметоды поддерживаемых операторов в метатаблицу класса.
+         * Уже установленные метаметоды не заменяются.
+         *
+         * @param l
+         */
+        static void Register(lua_State* l)
+        {
+            UData::MetaTable::Push(l);
+
+            AddBinary<std::plus<>, lua_Number>(l, "__add");
+            AddBinary<std::minus<>, lua_Number>(l, "__sub");
+            AddBinary<std::multiplies<>, lua_Number>(l, "__mul");
+            AddBinary<std::divides<>, lua_Number>(l, "__div");
+            AddBinary<std::modulus<>, lua_Integer>(l, "__mod");
+            AddUnary<std::negate<>>(l, "__unm");
+
+            AddBinary<std::bit_and<>, lua_Integer>(l, "__band");
+            AddBinary<std::bit_or<>, lua_Integer>(l, "__bor");
+            AddBinary<std::bit_xor<>, lua_Integer>(l, "__bxor");
+            AddUnary<std::bit_not<>>(l, "__bnot");
+
+            if constexpr (Supports<std::equal_to<>, T, T>)
+            {
+                AddMissing(l, "__eq", Protected<Equal, NoThrow<std::equal_to<>, T, T>>);
+            }
+            AddBinary<std::less<>, lua_Number>(l, "__lt");
+            AddBinary<std::less_equal<>, lua_Number>(l, "__le");
+
+            lua_pop(l, 1);
+        }
+
+    private:
+        template<typename Op, typename Scalar>
+        static void AddBinary(lua_State* l, const char* name)
+        {
+            if constexpr (HasBinary<Op, Scalar>)
+            {
+                AddMissing(l, name, Protected<Binary<Op, Scalar>, NoThrowBinary<Op, Scalar>>);
+            }
+        }
+
+        template<typename Op>
+        static void AddUnary(lua_State* l, const char* name)
+        {
+            if constexpr (HasUnary<Op>)
+            {
+                AddMissing(l, name, Protected<Unary<Op>, NoThrowUnary<Op>>);
+            }
+        }
+
+        static void AddMissing(lua_State* l, const char* name, lua_CFunction func)
+        {
+            if (lua_getfield(l, -1, name) == LUA_TNIL)
+            {
+                lua_pushcfunction(l, func);
+                lua_setfield(l, -3, name);
+            }
+            lua_pop(l, 1);
+        }
+
+        /**
+         * @brief Вызывает метаметод f, превращая исключения C++ в ошибки Lua, как CFunction
+         */
+        template<lua_CFunction f, bool nothrow>
+        static int Protected(lua_State* l)
+        {
+            if constexpr (nothrow)
+            {
+                return f(l);
+            }
+            else
+            {
+                try
+                {
+                    return f(l);
+                }
+                catch (std::exception& ex)
+                {
+                    luaL_error(l, "%s", ex.what());
+                }
+                catch (LTL::Exception&)
+                {
+                    throw;
+                }
+                catch (...)
+                {
+                    luaL_error(l, "%s", "unknown error");
+                }
+            }
+            return 0;
+        }
+
+        template<typename Scalar>
+        static Scalar ToScalar(lua_State* l, int index)
+        {
+            if constexpr (std::is_integral_v<Scalar>)
+            {
+                return luaL_checkinteger(l, index);
+            }
+            else
+            {
+                return lua_tonumber(l, index);
+            }
+        }
+
+        /**
+         * @brief Вызывает оператор Op. Scalar - тип числового операнда, void если числа не принимаются.
+         * Lua вызывает метаметод и тогда, когда объект - второй операнд.
+         */
+        template<typename Op, typename Scalar>
+        static int Binary(lua_State* l)
+        {
+            if constexpr (!std::is_void_v<Scalar>)
+            {
+                if (lua_type(l, 1) == LUA_TNUMBER)
+                {
+                    if constexpr (Supports<Op, Scalar, T>)
+                    {
+                        const Scalar a = ToScalar<Scalar>(l, 1);
+                        const T& b = *UData::ValidateUserData(l, 2);
+                        return PushResult(l, [&]() { return Op{}(a, b); });
+                    }
+                    return ThrowUnsupported(l);
+                }
+                if (lua_type(l, 2) == LUA_TNUMBER)
+                {
+                    if constexpr (Supports<Op, T, Scalar>)
+                    {
+                        const T& a = *UData::ValidateUserData(l, 1);
+                        const Scalar b = ToScalar<Scalar>(l, 2);
+                        return PushResult(l, [&]() { return Op{}(a, b); });
+                    }
+                    return ThrowUnsupported(l);
+                }
+            }
+            if constexpr (Supports<Op, T, T>)
+            {
+                const T& a = *UData::ValidateUserData(l, 1);
+                const T& b = *UData::ValidateUserData(l, 2);
+                return PushResult(l, [&]() { return Op{}(a, b); });
+            }
+            return ThrowUnsupported(l);
+        }
+
+        /**
+         * @brief __eq вызывается и для объектов других классов, они не равны объектам T
+         */
+        static int Equal(lua_State* l)
+        {
+            if (!UData::IsInstance(l, 1) || !UData::IsInstance(l, 2))
+            {
+                lua_pushboolean(l, false);
+                return 1;
+            }
+            return Binary<std::equal_to<>, void>(l);
+        }
+
+        template<typename Op>
+        static int Unary(lua_State* l)
+        {
+            const T& a = *UData::ValidateUserData(l, 1);
+            return PushResult(l, [&]() { return Op{}(a); });
+        }
+
+        template<typename F>
+        static int PushResult(lua_State* l, F&& operation)
+        {
+            using R = std::invoke_result_t<F>;
+            if constexpr (std::is_same_v<std::decay_t<R>, T>)
+            {
+                // UserData создается только после успешного вычисления
+                T result = operation();
+                UData::New(l, std::move(result));
+            }
+            else if constexpr (std::is_same_v<std::decay_t<R>, bool>)
+            {
+                lua_pushboolean(l, operation());
+            }
+            else
+            {
+                PushValue(l, operation());
+            }
+            return 1;
+        }
+
+        static int ThrowUnsupported(lua_State* l)
+        {
+            return luaL_error(l, "Unsupported operand types for %s: %s and %s",
+                UData::GetClassName(l), luaL_typename(l, 1), luaL_typename(l, 2));
+        }
+    };
+}
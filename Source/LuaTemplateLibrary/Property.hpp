@@ -13,12 +13,14 @@
 #include "Types.hpp"
 #include "FuncArguments.hpp"
 #include "UserData.hpp"
+#include "DirtyTracker.hpp"
 
 
 namespace LTL
 {
 
     struct GetterBase {};
+    struct ViewGetterBase : GetterBase {};
     struct SetterBase {};
     struct PropertyBase {};
 
@@ -43,6 +45,139 @@ namespace LTL
 
     };
 
+    namespace Internal
+    {
+        /// @brief Добавляет биты в маску измененных свойств объекта по индексу на стеке
+        using MarkFunction = void(*)(lua_State*, int, uint64_t);
+
+        /**
+         * @brief Общая для всех ссылок часть памяти UserData-ссылки.
+         * Если ссылка получена из объекта с отслеживанием записей (или из такой ссылки),
+         * mark и bits отмечают этот объект, который хранится во втором user value.
+         */
+        struct ViewHeader : UserDataHeader
+        {
+            UserDataHeader* parent;
+            MarkFunction mark;
+            uint64_t bits;
+        };
+
+        /**
+         * @brief Отмечает владельца ссылки по индексу на стеке после записи свойства через нее
+         */
+        inline void TouchOwner(lua_State* l, int index)
+        {
+            const ViewHeader* const view = static_cast<const ViewHeader*>(lua_touserdata(l, index));
+            if (view->mark == nullptr)
+                return;
+            lua_getiuservalue(l, index, 2);
+            view->mark(l, lua_gettop(l), view->bits);
+            lua_pop(l, 1);
+        }
+
+        /**
+         * @brief UserData-ссылка на объект T внутри другого UserData.
+         * Использует метатаблицу T, так что чтение и запись полей идут напрямую в родителя.
+         * Родитель хранится в user value и живет, пока жива ссылка.
+         * Если родитель уничтожен, обращение к ссылке вызывает ошибку.
+         *
+         * @tparam T
+         */
+        template<typename T>
+        struct UserDataView
+        {
+            struct Data : ViewHeader
+            {
+                T* object;
+            };
+
+            /**
+             * @brief Помещает на стек ссылку на object, принадлежащий UserData по индексу parent.
+             * Запись через ссылку отмечает родителя функцией mark с битами bits;
+             * ссылка, полученная из отслеживаемой ссылки, отмечает того же владельца, что и она.
+             *
+             * @param l
+             * @param object
+             * @param parent
+             * @param mark
+             * @param bits
+             */
+            static void Push(lua_State* l, T* object, int parent, MarkFunction mark = nullptr, uint64_t bits = 0)
+            {
+                parent = lua_absindex(l, parent);
+                UserDataHeader* const parentHeader = static_cast<UserDataHeader*>(lua_touserdata(l, parent));
+                int owner = parent;
+                if (parentHeader->Storage()->touch == &TouchOwner)
+                {
+                    const ViewHeader* const parentView = static_cast<const ViewHeader*>(parentHeader);
+                    mark = parentView->mark;
+                    bits = parentView->bits;
+                    if (mark != nullptr)
+                    {
+                        lua_getiuservalue(l, parent, 2);
+                        owner = lua_gettop(l);
+                    }
+                }
+
+                Data* const data = static_cast<Data*>(lua_newuserdatauv(l, sizeof(Data), mark == nullptr ? 1 : 2));
+                data->Init(&s_storage);
+                data->object = object;
+                data->parent = parentHeader;
+                data->mark = mark;
+                data->bits = bits;
+                UserData<T>::SetClassMetaTable(l);
+                lua_pushvalue(l, parent);
+                lua_setiuservalue(l, -2, 1);
+                if (mark != nullptr)
+                {
+                    lua_pushvalue(l, owner);
+                    lua_setiuservalue(l, -2, 2);
+                }
+                if (owner != parent)
+                {
+                    lua_remove(l, owner);
+                }
+            }
+
+        private:
+            static void* ObjectOf(UserDataHeader* header)
+            {
+                const Data* const data = static_cast<Data*>(header);
+                const UserDataHeader* const parent = data->parent;
+                if (parent->IsDestroyed() || parent->Storage()->object(data->parent) == nullptr)
+                    return nullptr;
+                return data->object;
+            }
+
+            static void Destroy(UserDataHeader*) {}
+
+            static inline const StorageType s_storage{ &UserData<T>::GetType(), &ObjectOf, &Destroy, &TouchOwner };
+        };
+    }
+
+    /**
+     * @brief Класс для описания геттера пользовательского класса,
+     * возвращающего ссылку на поле вместо копии.
+     * Поле должно быть зарегистрированным классом.
+     * @see AView
+     * @tparam C класс содержащий поле
+     * @tparam T тип поля класса
+     * @tparam Field ссылка на поле класса
+     */
+    template<class C, typename T, T C::* Field>
+    struct ViewGetter :public ViewGetterBase
+    {
+        using TClass = C;
+
+        static int Function(lua_State* l)
+        {
+            C* ud = UserData<C>::ValidateUserData(l, 1);
+            const uint64_t bits = DirtyTracker<C>::ViewBits(l, Function);
+            Internal::UserDataView<T>::Push(l, &(ud->*Field), 1, bits == 0 ? nullptr : &DirtyTracker<C>::MarkBits, bits);
+            return 1;
+        }
+    };
+
     /**
      * @brief Класс для описания сеттера пользовательского класса.
      * 
@@ -118,6 +253,15 @@ namespace LTL
     template<auto Field>
     struct ASetter : Setter<typename FieldDeductor<Field>::Class, typename FieldDeductor<Field>::Type, Field> {};
 
+    /**
+     * @brief Класс для описания геттера-ссылки на поле пользовательского класса.
+     * Автоматически определяет класс и тип поля по его ссылке.
+     *
+     * @tparam Field ссылка на поле класса
+     */
+    template<auto Field>
+    struct AView : ViewGetter<typename FieldDeductor<Field>::Class, typename FieldDeductor<Field>::Type, Field> {};
+
     /**
      * @brief Класс для описания свойства пользовательского класса.
      * Автоматически определяет класс и тип поля по его ссылке.
@@ -169,6 +169,18 @@ namespace LTL
             return PCallFunction<TReturn>(m_state, _This(), std::forward<TArgs>(args)...);
         }
 
+        template<typename TReturn = void, typename Range>
+        BatchReturn<TReturn> CallBatch(const Range& range)const
+        {
+            return LTL::CallBatch<TReturn>(m_state, _This(), range);
+        }
+
+        template<typename TReturn = void, typename Range>
+        std::vector<PCallReturn<TReturn>> PCallBatch(const Range& range)const
+        {
+            return LTL::PCallBatch<TReturn>(m_state, _This(), range);
+        }
+
         template<typename TReturn = void, typename ...TArgs>
         TReturn SelfCall(const char* key, TArgs&& ...args)const
         {
@@ -189,6 +201,28 @@ namespace LTL
             return PCallStack<TReturn>(m_state, n);
         }
 
+        template<typename TReturn = void, typename ...TArgs>
+        TReturn SelfCall(const Key& key, TArgs&& ...args)const
+        {
+            Push();
+            key.Push(m_state);
+            lua_gettable(m_state, -2);
+            lua_rotate(m_state, -2, 1);
+            size_t n = PushArgs(m_state, std::forward<TArgs>(args)...) + 1;
+            return CallStack<TReturn>(m_state, n);
+        }
+
+        template<typename TReturn = void, typename ...TArgs>
+        PCallReturn<TReturn> SelfPCall(const Key& key, TArgs&& ...args)const
+        {
+            Push();
+            key.Push(m_state);
+            lua_gettable(m_state, -2);
+            lua_rotate(m_state, -2, 1);
+            size_t n = PushArgs(m_state, std::forward<TArgs>(args)...) + 1;
+            return PCallStack<TReturn>(m_state, n);
+        }
+
         template<typename ...TArgs>
         ParentClass operator()(TArgs&& ...args)const
         {
@@ -580,6 +614,16 @@ namespace LTL
             this->PushRef(m_ref);
         }
 
+        /**
+         * @brief         
+         *
+         * @param l
+         */
+        void Push(lua_State* l)const
+        {
+            RefAccess::PushRef(l, m_ref);
+        }
+
         void Unref()
         {
             if (this->m_state)
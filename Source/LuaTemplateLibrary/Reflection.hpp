@@ -0,0 +1,161 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "Types.hpp"
+#include "Property.hpp"
+#include "UserData.hpp"
+
+namespace LTL
+{
+    /**
+     * @brief Описание поля структуры для преобразования в таблицу Lua.
+     * Класс и тип поля определяются по его ссылке, как и в AProperty.
+     *
+     * @tparam Field ссылка на поле класса
+     */
+    template<auto Field>
+    struct StructField
+    {
+        using TClass = typename FieldDeductor<Field>::Class;
+        using Type = typename FieldDeductor<Field>::Type;
+        static constexpr auto member = Field;
+
+        constexpr StructField(const char* name) : name(name) {}
+
+        const char* const name;
+    };
+
+    /**
+     * @brief Список полей структуры.
+     * Специализация должна содержать статический кортеж полей, например:
+     * static constexpr auto fields = std::make_tuple(StructField<&Point::x>{ "x" }, StructField<&Point::y>{ "y" });
+     * После этого структура передается в Lua и обратно как таблица.
+     *
+     * @tparam T структура, конструируемая по умолчанию
+     */
+    template<typename T>
+    struct StructFields {};
+
+    template<typename T, typename = void>
+    struct IsReflected : std::false_type {};
+
+    template<typename T>
+    struct IsReflected<T, std::void_t<decltype(StructFields<T>::fields)>> : std::true_type {};
+
+    template<typename T>
+    using EnableIfReflected = std::enable_if_t<IsReflected<T>::value>;
+
+    namespace Internal
+    {
+        /**
+         * @brief Преобразование структуры в таблицу и обратно по списку полей.
+         * Имена полей создаются в ВМ один раз и хранятся в реестре,
+         * поэтому при преобразовании строки не создаются и не хешируются заново.
+         *
+         * @tparam T
+         */
+        template<typename T>
+        struct StructCodec
+        {
+            using Fields = std::remove_const_t<decltype(StructFields<T>::fields)>;
+            static constexpr size_t Size = std::tuple_size_v<Fields>;
+
+            struct KeysTable : public RegistryTableBase<KeysTable> {};
+
+            /**
+             * @brief Помещает на стек массив имен полей.
+             *
+             * @param l
+             * @return int индекс массива на стеке
+             */
+            static int PushKeys(lua_State* l)
+            {
+                if (KeysTable::Push(l) == LUA_TNIL)
+                {
+                    lua_pop(l, 1);
+                    lua_createtable(l, static_cast<int>(Size), 0);
+                    ForEachField([l](const auto& field, lua_Integer i)
+                        {
+                            lua_pushstring(l, field.name);
+                            lua_rawseti(l, -2, i);
+                            return true;
+                        });
+                    lua_pushvalue(l, -1);
+                    lua_setregp(l, KeysTable::GetKey());
+                }
+                return lua_gettop(l);
+            }
+
+            static bool Check(lua_State* l, int index)
+            {
+                if (!lua_istable(l, index))
+                    return false;
+
+                index = lua_absindex(l, index);
+                const int keys = PushKeys(l);
+                const bool valid = ForEachField([l, index, keys](const auto& field, lua_Integer i)
+                    {
+                        using Field = std::decay_t<decltype(field)>;
+                        lua_rawgeti(l, keys, i);
+                        lua_rawget(l, index);
+                        const bool valid = StackType<typename Field::Type>::Check(l, -1);
+                        lua_pop(l, 1);
+                        return valid;
+                    });
+                lua_pop(l, 1);
+                return valid;
+            }
+
+            static T Get(lua_State* l, int index)
+            {
+                index = lua_absindex(l, index);
+                luaL_checktype(l, index, LUA_TTABLE);
+
+                T result{};
+                const int keys = PushKeys(l);
+                ForEachField([l, index, keys, &result](const auto& field, lua_Integer i)
+                    {
+                        using Field = std::decay_t<decltype(field)>;
+                        lua_rawgeti(l, keys, i);
+                        lua_rawget(l, index);
+                        result.*Field::member = StackType<typename Field::Type>::Get(l, -1);
+                        lua_pop(l, 1);
+                        return true;
+                    });
+                lua_pop(l, 1);
+                return result;
+            }
+
+            static void Push(lua_State* l, const T& value)
+            {
+                lua_createtable(l, 0, static_cast<int>(Size));
+                const int table = lua_gettop(l);
+                const int keys = PushKeys(l);
+                ForEachField([l, table, keys, &value](const auto& field, lua_Integer i)
+                    {
+                        using Field = std::decay_t<decltype(field)>;
+                        lua_rawgeti(l, keys, i);
+                        PushValue(l, value.*Field::member);
+                        lua_rawset(l, table);
+                        return true;
+                    });
+                lua_pop(l, 1);
+            }
+
+        private:
+            template<typename F>
+            static bool ForEachField(F&& f)
+            {
+                return ForEachField(std::forward<F>(f), std::make_index_sequence<Size>{});
+            }
+
+            template<typename F, size_t ...Is>
+            static bool ForEachField(F&& f, std::index_sequence<Is...>)
+            {
+                return (f(std::get<Is>(StructFields<T>::fields), static_cast<lua_Integer>(Is + 1)) && ...);
+            }
+        };
+    }
+
+    template<typename T>
+    struct StackType<T, EnableIfReflected<T>> : Internal::StructCodec<T> {};
+}
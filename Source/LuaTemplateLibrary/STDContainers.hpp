@@ -2,12 +2,31 @@
 #include "Types.hpp"
 #include <map>
 #include <unordered_map>
+#include <set>
+#include <unordered_set>
+#include <iterator>
 #include <optional>
+#include <array>
+#include <tuple>
+#include <utility>
 #include "StackObject.hpp"
 #include "FuncArguments.hpp"
+#include "NumericArray.hpp"
+#include "ScratchArena.hpp"
 
 namespace LTL
 {
+    namespace Internal
+    {
+        /**
+         * @brief Имеет ли смысл перемещать элементы временного контейнера при помещении на стек.
+         * Тривиально копируемые элементы (в том числе числа) и bool помещаются как обычно.
+         *
+         * @tparam T
+         */
+        template<typename T>
+        struct IsMovedOnPush : std::bool_constant<!std::is_trivially_copyable_v<T> && !std::is_same_v<T, bool>> {};
+    }
 
     struct TableChecker
     {
@@ -17,62 +36,439 @@ namespace LTL
         }
     };
 
-    template<typename T>
-    struct StackType<std::vector<T>> :TableChecker
+    template<typename T, typename A>
+    struct StackType<std::vector<T, A>> :TableChecker
     {
-        static std::vector<T> Get(lua_State* l, int index)
+        using Type = std::vector<T, A>;
+
+        static Type Get(lua_State* l, int index)
         {
-            StackObjectView table{ l , index };
+            if constexpr (Internal::IsNumericElement<T>::value)
+            {
+                return Internal::NumericArray<T>::GetVector(l, index, Internal::MakeContainer<Type>(l).get_allocator());
+            }
+            else
+            {
+                StackObjectView table{ l , index };
 
-            auto size = table.RawLen();
-            std::vector<T> result(size);
-            for (size_t i = 0; i < size; i++) {
-                result[i] = table.RawGetI<T>(i + 1);
+                auto size = table.RawLen();
+                Type result = Internal::MakeContainer<Type>(l);
+                result.resize(size);
+                for (size_t i = 0; i < size; i++) {
+                    result[i] = table.RawGetI<T>(i + 1);
+                }
+
+                return result;
             }
+        }
 
-            return result;
+        static void Push(lua_State* l, const Type& value)
+        {
+            if constexpr (Internal::IsNumericElement<T>::value)
+            {
+                Internal::NumericArray<T>::Push(l, value.data(), value.size());
+            }
+            else
+            {
+                lua_createtable(l, value.size(), 0);
+                StackObjectView table{ l };
+                for (size_t i = 0; i < value.size(); i++) {
+                    table.RawSetI(i + 1, value[i]);
+                }
+            }
         }
 
-        static void Push(lua_State* l, const std::vector<T>& value)
+        /**
+         * @brief Элементы временного вектора перемещаются при помещении на стек
+         */
+        static void Push(lua_State* l, Type&& value)
         {
-            lua_createtable(l, value.size(), 0);
-            StackObjectView table{ l };
-            for (size_t i = 0; i < value.size(); i++) {
-                table.RawSetI(i + 1, value[i]);
+            if constexpr (Internal::IsMovedOnPush<T>::value)
+            {
+                lua_createtable(l, static_cast<int>(value.size()), 0);
+                for (size_t i = 0; i < value.size(); i++)
+                {
+                    PushValue(l, std::move(value[i]));
+                    lua_rawseti(l, -2, static_cast<lua_Integer>(i + 1));
+                }
+            }
+            else
+            {
+                Push(l, static_cast<const Type&>(value));
             }
         }
     };
 
-    template<typename K, typename V>
-    struct StackType<std::unordered_map<K, V>> :TableChecker
+    /**
+     * @brief Массив фиксированного размера.
+     * Таблица должна содержать ровно N элементов, память в куче не выделяется.
+     *
+     * @tparam T
+     * @tparam N
+     */
+    template<typename T, size_t N>
+    struct StackType<std::array<T, N>>
     {
-        using Type = std::unordered_map<K, V>;
+        using Type = std::array<T, N>;
 
         static Type Get(lua_State* l, int index)
         {
-            StackObjectView table{ l, index };
+            index = lua_absindex(l, index);
+            luaL_checktype(l, index, LUA_TTABLE);
+            const size_t size = static_cast<size_t>(lua_rawlen(l, index));
+            if (size != N)
+            {
+                luaL_error(l, "expected array of %I elements but got %I", static_cast<lua_Integer>(N), static_cast<lua_Integer>(size));
+            }
+
             Type result{};
+            if constexpr (Internal::IsNumericElement<T>::value)
+            {
+                typename Internal::NumericArray<T>::Error error;
+                if (!Internal::NumericArray<T>::Read(l, index, result.data(), N, error))
+                {
+                    luaL_error(l, "%s at index %I", error.message, static_cast<lua_Integer>(error.position + 1));
+                }
+            }
+            else
+            {
+                for (size_t i = 0; i < N; i++)
+                {
+                    lua_rawgeti(l, index, static_cast<lua_Integer>(i + 1));
+                    result[i] = GetValue<T>(l, -1);
+                    lua_pop(l, 1);
+                }
+            }
+            return result;
+        }
+
+        static bool Check(lua_State* l, int index)
+        {
+            return lua_istable(l, index) && lua_rawlen(l, index) == N;
+        }
+
+        static void Push(lua_State* l, const Type& value)
+        {
+            if constexpr (Internal::IsNumericElement<T>::value)
+            {
+                Internal::NumericArray<T>::Push(l, value.data(), N);
+            }
+            else
+            {
+                lua_createtable(l, static_cast<int>(N), 0);
+                for (size_t i = 0; i < N; i++)
+                {
+                    PushValue(l, value[i]);
+                    lua_rawseti(l, -2, static_cast<lua_Integer>(i + 1));
+                }
+            }
+        }
+
+        static void Push(lua_State* l, Type&& value)
+        {
+            if constexpr (Internal::IsMovedOnPush<T>::value)
+            {
+                lua_createtable(l, static_cast<int>(N), 0);
+                for (size_t i = 0; i < N; i++)
+                {
+                    PushValue(l, std::move(value[i]));
+                    lua_rawseti(l, -2, static_cast<lua_Integer>(i + 1));
+                }
+            }
+            else
+            {
+                Push(l, static_cast<const Type&>(value));
+            }
+        }
+    };
+
+    namespace Internal
+    {
+        /**
+         * @brief Преобразование std::pair и std::tuple в таблицу {first, second, ...} и обратно.
+         * Для возврата нескольких значений используется MultReturn.
+         *
+         * @tparam T
+         */
+        template<typename T>
+        struct TupleTable
+        {
+            static constexpr size_t Size = std::tuple_size_v<T>;
+
+            static T Get(lua_State* l, int index)
+            {
+                index = lua_absindex(l, index);
+                luaL_checktype(l, index, LUA_TTABLE);
+                return GetElements(l, index, std::make_index_sequence<Size>{});
+            }
+
+            static bool Check(lua_State* l, int index)
+            {
+                if (!lua_istable(l, index))
+                    return false;
+                return CheckElements(l, lua_absindex(l, index), std::make_index_sequence<Size>{});
+            }
+
+            static void Push(lua_State* l, const T& value)
+            {
+                lua_createtable(l, static_cast<int>(Size), 0);
+                PushElements(l, value, std::make_index_sequence<Size>{});
+            }
+
+            static void Push(lua_State* l, T&& value)
+            {
+                lua_createtable(l, static_cast<int>(Size), 0);
+                MoveElements(l, value, std::make_index_sequence<Size>{});
+            }
+
+        private:
+            template<typename E>
+            static E GetElement(lua_State* l, int index, lua_Integer i)
+            {
+                lua_rawgeti(l, index, i);
+                E value = GetValue<E>(l, -1);
+                lua_pop(l, 1);
+                return value;
+            }
+
+            template<size_t ...Is>
+            static T GetElements(lua_State* l, int index, std::index_sequence<Is...>)
+            {
+                return T{ GetElement<std::tuple_element_t<Is, T>>(l, index, static_cast<lua_Integer>(Is + 1))... };
+            }
+
+            template<typename E>
+            static bool CheckElement(lua_State* l, int index, lua_Integer i)
+            {
+                lua_rawgeti(l, index, i);
+                const bool valid = StackType<E>::Check(l, -1);
+                lua_pop(l, 1);
+                return valid;
+            }
+
+            template<size_t ...Is>
+            static bool CheckElements(lua_State* l, int index, std::index_sequence<Is...>)
+            {
+                return (CheckElement<std::tuple_element_t<Is, T>>(l, index, static_cast<lua_Integer>(Is + 1)) && ...);
+            }
+
+            template<size_t ...Is>
+            static void PushElements(lua_State* l, const T& value, std::index_sequence<Is...>)
+            {
+                ((PushValue(l, std::get<Is>(value)), lua_rawseti(l, -2, static_cast<lua_Integer>(Is + 1))), ...);
+            }
+
+            template<size_t ...Is>
+            static void MoveElements(lua_State* l, T& value, std::index_sequence<Is...>)
+            {
+                ((PushValue(l, std::move(std::get<Is>(value))), lua_rawseti(l, -2, static_cast<lua_Integer>(Is + 1))), ...);
+            }
+        };
+    }
+
+    template<typename A, typename B>
+    struct StackType<std::pair<A, B>> : Internal::TupleTable<std::pair<A, B>> {};
+
+    template<typename ...Ts>
+    struct StackType<std::tuple<Ts...>> : Internal::TupleTable<std::tuple<Ts...>> {};
+
+    /**
+     * @brief Описание ассоциативного контейнера для преобразования в таблицу.
+     * Определено для типов с key_type и mapped_type (словари) и типов только с key_type (множества).
+     * Для других типов специализация должна содержать Key, Value (void для множеств),
+     * а также статические функции Reserve(container, n) и Insert(container, key[, value]).
+     * Контейнер перебирается range-for: словари дают пары ключ-значение, множества - ключи.
+     * Множества в Lua - таблицы вида { [key] = true }.
+     *
+     * @tparam T
+     */
+    template<typename T, typename = void>
+    struct AssociativeTraits {};
+
+    namespace Internal
+    {
+        template<typename T, typename = void>
+        struct HasMappedType : std::false_type {};
+
+        template<typename T>
+        struct HasMappedType<T, std::void_t<typename T::mapped_type>> : std::true_type {};
+
+        template<typename T, typename = void>
+        struct HasReserve : std::false_type {};
+
+        template<typename T>
+        struct HasReserve<T, std::void_t<decltype(std::declval<T&>().reserve(size_t{}))>> : std::true_type {};
 
+        template<typename T>
+        struct StandardAssociativeTraits
+        {
+            using Key = typename T::key_type;
+
+            static void Reserve(T& container, size_t n)
+            {
+                if constexpr (HasReserve<T>::value)
+                {
+                    container.reserve(n);
+                }
+            }
+        };
+
+        /// @brief Число ключей, которое TableSizeHint перебирает до выбора полного подсчета
+        inline constexpr size_t SizeHintProbe = 64;
+
+        /**
+         * @brief Оценка числа ключей таблицы для reserve.
+         * Обход начинается с первого ключа: целые ключи могут храниться в хеш-части,
+         * поэтому начинать с границы #t нельзя. Если таблица закончилась за SizeHintProbe ключей,
+         * это и есть ответ. Иначе таблица большая, и ключи подсчитываются полностью отдельным
+         * проходом lua_next без преобразований: он дешевле перехеширований контейнера.
+         *
+         * @param l
+         * @param index абсолютный индекс таблицы
+         * @return size_t
+         */
+        inline size_t TableSizeHint(lua_State* l, int index)
+        {
+            size_t count = 0;
             lua_pushnil(l);
-            while (lua_next(l, table.GetIndex()))
+            while (lua_next(l, index))
             {
-                StackObjectView key{ l,-2 };
-                StackObjectView value{ l,-1 };
-                result.insert({ key.To<K>(),value.To<V>() });
                 lua_pop(l, 1);
+                if (++count == SizeHintProbe)
+                {
+                    // большая таблица: полный подсчет с того же ключа
+                    while (lua_next(l, index))
+                    {
+                        lua_pop(l, 1);
+                        count++;
+                    }
+                    break;
+                }
+            }
+            return count;
+        }
+    }
+
+    template<typename T>
+    struct AssociativeTraits<T, std::enable_if_t<Internal::HasMappedType<T>::value>> : Internal::StandardAssociativeTraits<T>
+    {
+        using Key = typename T::key_type;
+        using Value = typename T::mapped_type;
+
+        static void Insert(T& container, Key&& key, Value&& value)
+        {
+            container.emplace(std::move(key), std::move(value));
+        }
+    };
+
+    template<typename T>
+    struct AssociativeTraits<T, std::void_t<typename T::key_type, std::enable_if_t<!Internal::HasMappedType<T>::value>>> : Internal::StandardAssociativeTraits<T>
+    {
+        using Key = typename T::key_type;
+        using Value = void;
+
+        static void Insert(T& container, Key&& key)
+        {
+            container.emplace(std::move(key));
+        }
+    };
+
+    template<typename T, typename = void>
+    struct IsAssociative : std::false_type {};
+
+    template<typename T>
+    struct IsAssociative<T, std::void_t<typename AssociativeTraits<T>::Key, typename AssociativeTraits<T>::Value>> : std::true_type {};
+
+    template<typename T>
+    using EnableIfAssociative = std::enable_if_t<IsAssociative<T>::value>;
+
+    /**
+     * @brief Преобразование словарей и множеств в таблицы и обратно.
+     * Перед заполнением контейнера резервируется место по TableSizeHint,
+     * если контейнер поддерживает reserve.
+     *
+     * @tparam T
+     */
+    template<typename T>
+    struct StackType<T, EnableIfAssociative<T>> : TableChecker
+    {
+        using Traits = AssociativeTraits<T>;
+        using Key = typename Traits::Key;
+        using Value = typename Traits::Value;
+        static constexpr bool IsSet = std::is_void_v<Value>;
+
+        static T Get(lua_State* l, int index)
+        {
+            index = lua_absindex(l, index);
+            luaL_checktype(l, index, LUA_TTABLE);
+
+            T result = Internal::MakeContainer<T>(l);
+            if constexpr (Internal::HasReserve<T>::value || !std::is_base_of_v<Internal::StandardAssociativeTraits<T>, Traits>)
+            {
+                Traits::Reserve(result, Internal::TableSizeHint(l, index));
+            }
+
+            lua_pushnil(l);
+            while (lua_next(l, index))
+            {
+                // ключ преобразуется из копии, чтобы lua_tostring не изменил ключ обхода
+                lua_pushvalue(l, -2);
+                if constexpr (IsSet)
+                {
+                    if (lua_toboolean(l, -2))
+                    {
+                        Traits::Insert(result, GetValue<Key>(l, -1));
+                    }
+                }
+                else
+                {
+                    Key key = GetValue<Key>(l, -1);
+                    Traits::Insert(result, std::move(key), GetValue<Value>(l, -2));
+                }
+                lua_pop(l, 2);
             }
 
             return result;
         }
 
-        static void Push(lua_State* l, const Type& value)
+        static void Push(lua_State* l, const T& value)
         {
-            lua_createtable(l, 0, value.size());
-            StackObjectView table{ l };
+            lua_createtable(l, 0, static_cast<int>(std::size(value)));
+            for (const auto& item : value)
+            {
+                if constexpr (IsSet)
+                {
+                    PushValue(l, item);
+                    lua_pushboolean(l, true);
+                }
+                else
+                {
+                    const auto& [k, v] = item;
+                    PushValue(l, k);
+                    PushValue(l, v);
+                }
+                lua_rawset(l, -3);
+            }
+        }
 
-            for (const auto& [k, v] : value)
+        /**
+         * @brief Значения временного словаря перемещаются при помещении на стек, ключи копируются
+         */
+        static void Push(lua_State* l, T&& value)
+        {
+            if constexpr (!IsSet && Internal::IsMovedOnPush<typename Traits::Value>::value)
             {
-                table.RawSet(k, v);
+                lua_createtable(l, 0, static_cast<int>(std::size(value)));
+                for (auto& [k, v] : value)
+                {
+                    PushValue(l, k);
+                    PushValue(l, std::move(v));
+                    lua_rawset(l, -3);
+                }
+            }
+            else
+            {
+                Push(l, static_cast<const T&>(value));
             }
         }
     };
@@ -102,6 +498,18 @@ namespace LTL
                 lua_pushnil(l);
             }
         }
+
+        static void Push(lua_State* l, Type&& value)
+        {
+            if (value.has_value())
+            {
+                StackType<T>::Push(l, std::move(value).value());
+            }
+            else
+            {
+                lua_pushnil(l);
+            }
+        }
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,360 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "Types.hpp"
+#include <memory_resource>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace LTL
+{
+    /**
+     * @brief Временная память вызова CFunction.
+     * Одна на ВМ, хранится в реестре. Функция получает ее аргументом ScratchArena*,
+     * который, как и lua_State*, не занимает место среди аргументов Lua.
+     * Пока активен вызов функции с аргументом ScratchArena* или контейнером с аллокатором std::pmr,
+     * такие контейнеры (std::pmr::vector, std::pmr::string, std::pmr::unordered_map и др.)
+     * создаются в этой памяти, и она освобождается целиком после возврата из самого внешнего вызова.
+     * Самый внешний вызов держит память на стеке после своих аргументов (см. Enter).
+     * Вне вызова контейнеры с аллокатором std::pmr используют std::pmr::get_default_resource().
+     */
+    class ScratchArena
+    {
+    public:
+        static constexpr size_t DefaultCapacity = 64 * 1024;
+        static constexpr size_t MaxCapacity = 16 * 1024 * 1024;
+
+        explicit ScratchArena(size_t capacity = DefaultCapacity)
+        {
+            Reset(capacity);
+        }
+
+        ScratchArena(const ScratchArena&) = delete;
+        ScratchArena(ScratchArena&&) = delete;
+        ScratchArena& operator=(const ScratchArena&) = delete;
+        ScratchArena& operator=(ScratchArena&&) = delete;
+
+        std::pmr::memory_resource* Resource() noexcept
+        {
+            return &*m_resource;
+        }
+
+        template<typename T>
+        std::pmr::polymorphic_allocator<T> Allocator() noexcept
+        {
+            return { Resource() };
+        }
+
+        /**
+         * @brief Активен ли вызов, использующий эту память.
+         */
+        bool IsActive()const noexcept
+        {
+            return m_depth != 0;
+        }
+
+        size_t Capacity()const noexcept
+        {
+            return m_capacity;
+        }
+
+        /**
+         * @brief Освобождает всю выделенную память.
+         * Если начального блока не хватило, он увеличивается (не более MaxCapacity),
+         * чтобы следующие вызовы обходились без обращений к куче.
+         */
+        void Release()
+        {
+            const size_t overflow = m_upstream.allocated;
+            if (overflow == 0)
+            {
+                m_resource->release();
+                return;
+            }
+
+            size_t capacity = m_capacity;
+            while (capacity < m_capacity + overflow && capacity < MaxCapacity)
+            {
+                capacity *= 2;
+            }
+            Reset(capacity < MaxCapacity ? capacity : MaxCapacity);
+        }
+
+        /**
+         * @brief Возвращает память данной ВМ, создавая ее при первом обращении.
+         *
+         * @param l
+         * @return ScratchArena&
+         */
+        static ScratchArena& Get(lua_State* l)
+        {
+            if (ScratchArena* const arena = Find(l))
+                return *arena;
+
+            ScratchArena* const arena = new (lua_newuserdatauv(l, sizeof(ScratchArena), 1)) ScratchArena{};
+            lua_createtable(l, 0, 2);
+            lua_pushcfunction(l, GC);
+            lua_setfield(l, -2, "__gc");
+            lua_pushcfunction(l, Close);
+            lua_setfield(l, -2, "__close");
+            lua_setmetatable(l, -2);
+            lua_setregp(l, GetKey());
+            return *arena;
+        }
+
+        /**
+         * @brief Возвращает память данной ВМ или nullptr, если она еще не создана.
+         *
+         * @param l
+         * @return ScratchArena*
+         */
+        static ScratchArena* Find(lua_State* l)
+        {
+            lua_getregp(l, GetKey());
+            ScratchArena* const arena = static_cast<ScratchArena*>(lua_touserdata(l, -1));
+            lua_pop(l, 1);
+            return arena;
+        }
+
+        /**
+         * @brief Отмечает начало вызова CFunction, использующей память.
+         * Самый внешний вызов дополняет аргументы до args значениями nil и помещает после них
+         * память как to-be-closed значение: при возврате из функции или ошибке Lua ее __close
+         * сбрасывает счетчик вложенности и освобождает память, так что функция не вызывается
+         * повторно под lua_pcall. Вложенные вызовы только увеличивают счетчик и уменьшают его в Leave;
+         * отметки, оставленные их ошибками, снимаются вместе с внешним вызовом.
+         * Если ошибка покинула сопрограмму внешнего вызова, __close не выполнится до ее закрытия,
+         * поэтому такой вызов считается завершенным при следующем входе.
+         *
+         * @param l
+         * @param args число аргументов Lua функции
+         * @return ScratchArena* для вложенного вызова или nullptr для внешнего
+         */
+        static ScratchArena* Enter(lua_State* l, int args)
+        {
+            ScratchArena& arena = Get(l);
+            if (arena.m_depth != 0)
+            {
+                if (arena.m_owner == l || lua_status(arena.m_owner) == LUA_OK)
+                {
+                    arena.m_depth++;
+                    return &arena;
+                }
+                arena.m_depth = 0;
+                arena.Release();
+            }
+
+            if (lua_gettop(l) < args)
+            {
+                lua_settop(l, args);
+            }
+            lua_getregp(l, GetKey());
+            lua_pushthread(l);
+            lua_setiuservalue(l, -2, 1);
+            arena.m_owner = l;
+            arena.m_depth = 1;
+            lua_toclose(l, -1);
+            return nullptr;
+        }
+
+        /**
+         * @brief Завершает вложенный вызов, начатый Enter
+         */
+        void Leave() noexcept
+        {
+            m_depth--;
+        }
+
+        /**
+         * @brief Отмечает вызов, использующий память, из C++ кода.
+         * При выходе из самого внешнего вызова память освобождается.
+         * Контейнеры из этой памяти должны быть уничтожены раньше.
+         * Ошибка Lua (longjmp) пропускает деструктор, поэтому Scope подходит для кода, где ошибок Lua нет;
+         * вызовы CFunction внутри него считаются вложенными.
+         */
+        class Scope
+        {
+        public:
+            explicit Scope(lua_State* l) : m_arena(Get(l)), m_depth(m_arena.m_depth)
+            {
+                if (m_depth == 0)
+                {
+                    m_arena.m_owner = l;
+                }
+                m_arena.m_depth++;
+            }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+            ~Scope()
+            {
+                m_arena.m_depth = m_depth;
+                if (m_depth == 0)
+                {
+                    m_arena.Release();
+                }
+            }
+
+        private:
+            ScratchArena& m_arena;
+            const size_t m_depth;
+        };
+
+    private:
+        /**
+         * @brief Источник памяти сверх начального блока, считающий выделенный объем.
+         */
+        struct Upstream : std::pmr::memory_resource
+        {
+            size_t allocated = 0;
+
+        protected:
+            void* do_allocate(size_t bytes, size_t alignment) override
+            {
+                allocated += bytes;
+                return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+            }
+
+            void do_deallocate(void* p, size_t bytes, size_t alignment) override
+            {
+                std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource& other)const noexcept override
+            {
+                return this == &other;
+            }
+        };
+
+        void Reset(size_t capacity)
+        {
+            m_resource.reset();
+            m_buffer.reset(new std::byte[capacity]);
+            m_capacity = capacity;
+            m_upstream.allocated = 0;
+            m_resource.emplace(m_buffer.get(), capacity, &m_upstream);
+        }
+
+        static int GC(lua_State* l)
+        {
+            static_cast<ScratchArena*>(lua_touserdata(l, 1))->~ScratchArena();
+            return 0;
+        }
+
+        /**
+         * @brief __close внешнего вызова. Закрытие в другом потоке относится
+         * к уже сброшенному вызову из сопрограммы с ошибкой и ничего не делает.
+         */
+        static int Close(lua_State* l)
+        {
+            ScratchArena* const arena = static_cast<ScratchArena*>(lua_touserdata(l, 1));
+            if (arena->m_owner == l && arena->m_depth != 0)
+            {
+                arena->m_depth = 0;
+                arena->Release();
+            }
+            return 0;
+        }
+
+        static const void* GetKey()
+        {
+            static const char key = 0;
+            return &key;
+        }
+
+        std::unique_ptr<std::byte[]> m_buffer;
+        size_t m_capacity = 0;
+        size_t m_depth = 0;
+        /// @brief Поток внешнего вызова; удерживается в user value памяти
+        lua_State* m_owner = nullptr;
+        Upstream m_upstream;
+        std::optional<std::pmr::monotonic_buffer_resource> m_resource;
+    };
+
+    template<>
+    struct StackType<ScratchArena*> : AlwaysValid
+    {
+        static ScratchArena* Get(lua_State* l, int index)
+        {
+            return &ScratchArena::Get(l);
+        }
+    };
+
+    namespace Internal
+    {
+        template<typename A>
+        struct IsPmrAllocator : std::false_type {};
+
+        template<typename T>
+        struct IsPmrAllocator<std::pmr::polymorphic_allocator<T>> : std::true_type {};
+
+        template<typename T, typename = void>
+        struct UsesScratchAllocator : std::false_type {};
+
+        template<typename T>
+        struct UsesScratchAllocator<T, std::void_t<typename T::allocator_type>> : IsPmrAllocator<typename T::allocator_type> {};
+
+        /**
+         * @brief Требует ли аргумент функции активной временной памяти.
+         *
+         * @tparam T
+         */
+        template<typename T>
+        struct IsScratchArgument : std::disjunction<std::is_same<T, ScratchArena*>, UsesScratchAllocator<T>> {};
+
+        /**
+         * @brief Возвращает временную память, если активен использующий ее вызов, иначе память по умолчанию.
+         *
+         * @param l
+         * @return std::pmr::memory_resource*
+         */
+        inline std::pmr::memory_resource* ScratchResource(lua_State* l)
+        {
+            ScratchArena* const arena = ScratchArena::Find(l);
+            return arena && arena->IsActive() ? arena->Resource() : std::pmr::get_default_resource();
+        }
+
+        /**
+         * @brief Создает пустой контейнер. Контейнеры с аллокатором std::pmr
+         * получают память из ScratchResource.
+         *
+         * @tparam T
+         * @param l
+         * @return T
+         */
+        template<typename T>
+        T MakeContainer(lua_State* l)
+        {
+            if constexpr (UsesScratchAllocator<T>::value)
+            {
+                return T(typename T::allocator_type{ ScratchResource(l) });
+            }
+            else
+            {
+                return T{};
+            }
+        }
+    }
+
+    template<>
+    struct StackType<std::pmr::string>
+    {
+        static std::pmr::string Get(lua_State* l, int index)
+        {
+            size_t len = 0;
+            const char* s = luaL_checklstring(l, index, &len);
+            return { s, len, std::pmr::polymorphic_allocator<char>{ Internal::ScratchResource(l) } };
+        }
+
+        static bool Check(lua_State* l, int index)
+        {
+            return lua_isstring(l, index);
+        }
+
+        static void Push(lua_State* l, const std::pmr::string& value)
+        {
+            lua_pushlstring(l, value.data(), value.size());
+        }
+    };
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "UserData.hpp"
+
+namespace LTL::Internal
+{
+    /**
+     * @brief Пул временных объектов класса T для вычислений без выделения памяти.
+     * Скрипт берет объект из пула, использует его как приемник операций
+     * (см. MethodInto, FunctionInto) и возвращает обратно.
+     * Свободные объекты хранятся в таблице реестра: массив для выдачи и множество для проверки
+     * повторного возврата. Объекты сверх MaxSize не удерживаются и собираются сборщиком мусора.
+     *
+     * @tparam T класс
+     */
+    template<typename T>
+    struct ScratchPool
+    {
+        using UData = UserData<T>;
+
+        static_assert(std::is_default_constructible_v<T>, "Pooled class must be default constructible");
+
+        /// @brief Наибольшее число свободных объектов в пуле
+        static constexpr lua_Integer MaxSize = 256;
+
+        /**
+         * @brief Помещает на стек объект из пула или новый объект, если пул пуст.
+         * Объект из пула сбрасывается к T{}.
+         *
+         * @param l
+         * @return int
+         */
+        static int Acquire(lua_State* l)
+        {
+            PushPool(l);
+            const lua_Integer size = static_cast<lua_Integer>(lua_rawlen(l, -1));
+            if (size == 0)
+            {
+                lua_pop(l, 1);
+                UData::New(l);
+                return 1;
+            }
+
+            lua_rawgeti(l, -1, size);
+            lua_pushnil(l);
+            lua_rawseti(l, -3, size);
+            lua_pushvalue(l, -1);
+            lua_pushnil(l);
+            lua_rawset(l, -4);
+            lua_remove(l, -2);
+
+            *UData::ValidateUserData(l, -1) = T{};
+            return 1;
+        }
+
+        /**
+         * @brief Возвращает объект (аргумент 1) в пул. После этого скрипт не должен его использовать.
+         * Принимаются только объекты T, хранящиеся в UserData; произвольные поля объекта удаляются.
+         *
+         * @param l
+         * @return int
+         */
+        static int Release(lua_State* l)
+        {
+            UData::ToUserData(l, 1);
+            UData::ValidateUserData(l, 1);
+
+            PushPool(l);
+            lua_pushvalue(l, 1);
+            if (lua_rawget(l, -2) != LUA_TNIL)
+            {
+                luaL_error(l, "%s object was already returned to the pool", UData::GetClassName(l));
+            }
+            lua_pop(l, 1);
+
+            const lua_Integer size = static_cast<lua_Integer>(lua_rawlen(l, -1));
+            if (size >= MaxSize)
+            {
+                lua_pop(l, 1);
+                return 0;
+            }
+
+            if (lua_getiuservalue(l, 1, UData::ExpandoSlot) == LUA_TTABLE)
+            {
+                lua_pushnil(l);
+                lua_setiuservalue(l, 1, UData::ExpandoSlot);
+            }
+            lua_pop(l, 1);
+
+            lua_pushvalue(l, 1);
+            lua_rawseti(l, -2, size + 1);
+            lua_pushvalue(l, 1);
+            lua_pushboolean(l, true);
+            lua_rawset(l, -3);
+            lua_pop(l, 1);
+            return 0;
+        }
+
+        /**
+         * @brief Возвращает число свободных объектов в пуле
+         *
+         * @param l
+         * @return size_t
+         */
+        static size_t Size(lua_State* l)
+        {
+            PushPool(l);
+            const size_t size = lua_rawlen(l, -1);
+            lua_pop(l, 1);
+            return size;
+        }
+
+    private:
+        struct PoolTable : public RegistryTableBase<PoolTable> {};
+
+        static void PushPool(lua_State* l)
+        {
+            if (PoolTable::Push(l) != LUA_TNIL)
+                return;
+
+            lua_pop(l, 1);
+            lua_newtable(l);
+            lua_pushvalue(l, -1);
+            lua_setregp(l, PoolTable::GetKey());
+        }
+    };
+}
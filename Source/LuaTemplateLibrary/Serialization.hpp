@@ -0,0 +1,663 @@
+#pragma once
+#include "LuaAux.hpp"
+#include "Types.hpp"
+#include "StackObject.hpp"
+#include "UserData.hpp"
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+namespace LTL
+{
+    /**
+     * @brief Запись данных в двоичном формате сериализации.
+     * Целые числа записываются в формате varint.
+     */
+    class BinaryWriter
+    {
+    public:
+        BinaryWriter(std::string& buffer) : m_buffer(buffer) {}
+
+        void WriteByte(uint8_t byte)
+        {
+            m_buffer.push_back(static_cast<char>(byte));
+        }
+
+        void WriteVarint(uint64_t value)
+        {
+            char bytes[10];
+            size_t n = 0;
+            while (value >= 0x80)
+            {
+                bytes[n++] = static_cast<char>((value & 0x7F) | 0x80);
+                value >>= 7;
+            }
+            bytes[n++] = static_cast<char>(value);
+            m_buffer.append(bytes, n);
+        }
+
+        void WriteInteger(int64_t value)
+        {
+            WriteVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+        }
+
+        void WriteNumber(double value)
+        {
+            char bytes[sizeof(double)];
+            std::memcpy(bytes, &value, sizeof(double));
+            m_buffer.append(bytes, sizeof(double));
+        }
+
+        void WriteBytes(const void* data, size_t size)
+        {
+            m_buffer.append(static_cast<const char*>(data), size);
+        }
+
+        void WriteString(std::string_view s)
+        {
+            WriteVarint(s.size());
+            WriteBytes(s.data(), s.size());
+        }
+
+        /**
+         * @brief Резервирует место под varint, значение которого станет известно позже.
+         *
+         * @return size_t позиция для Patch
+         */
+        size_t ReserveVarint()
+        {
+            const size_t pos = m_buffer.size();
+            m_buffer.append(PaddedVarintSize, '\x80');
+            return pos;
+        }
+
+        /**
+         * @brief Записывает значение в зарезервированное место.
+         * Используется дополненная кодировка, совместимая с обычным varint.
+         *
+         * @param pos
+         * @param value
+         */
+        void Patch(size_t pos, uint32_t value)
+        {
+            for (size_t i = 0; i < PaddedVarintSize - 1; i++)
+            {
+                m_buffer[pos + i] = static_cast<char>((value & 0x7F) | 0x80);
+                value >>= 7;
+            }
+            m_buffer[pos + PaddedVarintSize - 1] = static_cast<char>(value & 0x7F);
+        }
+
+    private:
+        static constexpr size_t PaddedVarintSize = 5;
+
+        std::string& m_buffer;
+    };
+
+    /**
+     * @brief Чтение данных в двоичном формате сериализации.
+     * При выходе за границы данных или некорректном varint
+     * устанавливается флаг ошибки, а методы возвращают нули.
+     */
+    class BinaryReader
+    {
+    public:
+        BinaryReader(std::string_view data) : m_pos(data.data()), m_end(data.data() + data.size()) {}
+
+        uint8_t ReadByte()
+        {
+            if (m_pos == m_end)
+            {
+                m_failed = true;
+                return 0;
+            }
+            return static_cast<uint8_t>(*m_pos++);
+        }
+
+        uint64_t ReadVarint()
+        {
+            uint64_t value = 0;
+            for (unsigned shift = 0; shift < 64; shift += 7)
+            {
+                if (m_pos == m_end)
+                    break;
+                const uint8_t byte = static_cast<uint8_t>(*m_pos++);
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                    return value;
+            }
+            m_failed = true;
+            return 0;
+        }
+
+        int64_t ReadInteger()
+        {
+            const uint64_t v = ReadVarint();
+            return static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1));
+        }
+
+        double ReadNumber()
+        {
+            double value = 0;
+            if (Remaining() < sizeof(double))
+            {
+                m_failed = true;
+                return value;
+            }
+            std::memcpy(&value, m_pos, sizeof(double));
+            m_pos += sizeof(double);
+            return value;
+        }
+
+        std::string_view ReadBytes(size_t size)
+        {
+            if (Remaining() < size)
+            {
+                m_failed = true;
+                return {};
+            }
+            std::string_view s{ m_pos, size };
+            m_pos += size;
+            return s;
+        }
+
+        std::string_view ReadString()
+        {
+            const uint64_t size = ReadVarint();
+            return ReadBytes(static_cast<size_t>(size));
+        }
+
+        size_t Remaining()const noexcept
+        {
+            return static_cast<size_t>(m_end - m_pos);
+        }
+
+        bool Failed()const noexcept
+        {
+            return m_failed;
+        }
+
+    private:
+        const char* m_pos;
+        const char* const m_end;
+        bool m_failed = false;
+    };
+
+    /**
+     * @brief Описывает сериализацию пользовательского типа.
+     * Специализация должна предоставлять функции
+     * static void Write(BinaryWriter&, const T&) и static T Read(BinaryReader&).
+     *
+     * @tparam T пользовательский тип, зарегистрированный через Class<T>
+     */
+    template<typename T>
+    struct UserDataSerializer;
+
+    /**
+     * @brief Набор пользовательских типов, доступных для сериализации.
+     * Порядок добавления типов должен совпадать при сериализации и десериализации.
+     */
+    class UserDataCodecs
+    {
+    public:
+        struct Codec
+        {
+            bool (*is)(lua_State* l, int index);
+            void (*write)(lua_State* l, int index, BinaryWriter& writer);
+            void (*read)(lua_State* l, BinaryReader& reader);
+        };
+
+        /**
+         * @brief Добавляет тип T, используя UserDataSerializer<T>.
+         *
+         * @tparam T
+         * @return UserDataCodecs&
+         */
+        template<typename T>
+        UserDataCodecs& Add()
+        {
+            m_codecs.push_back({
+                UserData<T>::IsUserData,
+                +[](lua_State* l, int index, BinaryWriter& writer)
+                {
+                    UserDataSerializer<T>::Write(writer, *UserData<T>::ValidateUserData(l, index));
+                },
+                +[](lua_State* l, BinaryReader& reader)
+                {
+                    UserData<T>::PushCopy(l, UserDataSerializer<T>::Read(reader));
+                }
+                });
+            return *this;
+        }
+
+        size_t Find(lua_State* l, int index)const
+        {
+            for (size_t i = 0; i < m_codecs.size(); i++)
+            {
+                if (m_codecs[i].is(l, index))
+                    return i;
+            }
+            return m_codecs.size();
+        }
+
+        size_t Size()const noexcept
+        {
+            return m_codecs.size();
+        }
+
+        const Codec& operator[](size_t i)const
+        {
+            return m_codecs[i];
+        }
+
+        static const UserDataCodecs& Empty()
+        {
+            static const UserDataCodecs empty{};
+            return empty;
+        }
+
+    private:
+        std::vector<Codec> m_codecs;
+    };
+
+    namespace Internal
+    {
+        enum class SerializedTag : uint8_t
+        {
+            Nil,
+            False,
+            True,
+            Integer,
+            Number,
+            String,
+            StringRef,
+            Table,
+            TableRef,
+            UserData,
+        };
+
+        constexpr uint8_t SerializationVersion = 1;
+
+        /// @brief Максимальная вложенность таблиц при записи и чтении
+        constexpr int SerializationMaxDepth = 200;
+
+        /**
+         * @brief Обходит значение на стеке и записывает его в буфер.
+         * Повторные строки и таблицы записываются ссылками на первое вхождение.
+         */
+        class Serializer
+        {
+        public:
+            Serializer(lua_State* l, std::string& out, const UserDataCodecs& codecs)
+                : m_state(l), m_writer(out), m_codecs(codecs) {}
+
+            bool Write(int index, int depth = 0)
+            {
+                lua_State* const l = m_state;
+                index = lua_absindex(l, index);
+                switch (lua_type(l, index))
+                {
+                case LUA_TNIL:
+                    Tag(SerializedTag::Nil);
+                    return true;
+                case LUA_TBOOLEAN:
+                    Tag(lua_toboolean(l, index) ? SerializedTag::True : SerializedTag::False);
+                    return true;
+                case LUA_TNUMBER:
+                    if (lua_isinteger(l, index))
+                    {
+                        Tag(SerializedTag::Integer);
+                        m_writer.WriteInteger(lua_tointeger(l, index));
+                    }
+                    else
+                    {
+                        Tag(SerializedTag::Number);
+                        m_writer.WriteNumber(lua_tonumber(l, index));
+                    }
+                    return true;
+                case LUA_TSTRING:
+                    return WriteString(index);
+                case LUA_TTABLE:
+                    return WriteTable(index, depth);
+                case LUA_TUSERDATA:
+                    return WriteUserData(index);
+                default:
+                    return Fail("can't serialize value of this type");
+                }
+            }
+
+            const char* Error()const noexcept
+            {
+                return m_error;
+            }
+
+        private:
+            void Tag(SerializedTag tag)
+            {
+                m_writer.WriteByte(static_cast<uint8_t>(tag));
+            }
+
+            bool Fail(const char* error)
+            {
+                m_error = error;
+                return false;
+            }
+
+            bool WriteString(int index)
+            {
+                size_t len = 0;
+                const char* s = lua_tolstring(m_state, index, &len);
+                // ВМ интернирует только короткие строки, поэтому сравнивается содержимое.
+                // Строки принадлежат сериализуемым таблицам и живут до конца записи
+                const auto [it, inserted] = m_strings.try_emplace(std::string_view{ s, len }, static_cast<uint32_t>(m_strings.size()));
+                if (!inserted)
+                {
+                    Tag(SerializedTag::StringRef);
+                    m_writer.WriteVarint(it->second);
+                    return true;
+                }
+                Tag(SerializedTag::String);
+                m_writer.WriteString({ s, len });
+                return true;
+            }
+
+            bool WriteTable(int index, int depth)
+            {
+                lua_State* const l = m_state;
+                const auto [it, inserted] = m_tables.try_emplace(lua_topointer(l, index), static_cast<uint32_t>(m_tables.size()));
+                if (!inserted)
+                {
+                    Tag(SerializedTag::TableRef);
+                    m_writer.WriteVarint(it->second);
+                    return true;
+                }
+
+                if (depth >= SerializationMaxDepth || !lua_checkstack(l, 3))
+                    return Fail("table nesting is too deep");
+
+                const lua_Integer narr = static_cast<lua_Integer>(lua_rawlen(l, index));
+                Tag(SerializedTag::Table);
+                m_writer.WriteVarint(static_cast<uint64_t>(narr));
+                const size_t count_pos = m_writer.ReserveVarint();
+
+                for (lua_Integer i = 1; i <= narr; i++)
+                {
+                    lua_rawgeti(l, index, i);
+                    if (!Write(-1, depth + 1))
+                        return false;
+                    lua_pop(l, 1);
+                }
+
+                uint32_t nhash = 0;
+                lua_pushnil(l);
+                while (lua_next(l, index))
+                {
+                    if (lua_isinteger(l, -2))
+                    {
+                        const lua_Integer key = lua_tointeger(l, -2);
+                        if (key >= 1 && key <= narr)
+                        {
+                            lua_pop(l, 1);
+                            continue;
+                        }
+                    }
+                    if (!Write(-2, depth + 1) || !Write(-1, depth + 1))
+                        return false;
+                    nhash++;
+                    lua_pop(l, 1);
+                }
+                m_writer.Patch(count_pos, nhash);
+                return true;
+            }
+
+            bool WriteUserData(int index)
+            {
+                const size_t codec = m_codecs.Find(m_state, index);
+                if (codec == m_codecs.Size())
+                    return Fail("can't serialize userdata without codec");
+
+                Tag(SerializedTag::UserData);
+                m_writer.WriteVarint(codec);
+                m_codecs[codec].write(m_state, index, m_writer);
+                return true;
+            }
+
+            lua_State* const m_state;
+            BinaryWriter m_writer;
+            const UserDataCodecs& m_codecs;
+            std::unordered_map<const void*, uint32_t> m_tables;
+            std::unordered_map<std::string_view, uint32_t> m_strings;
+            const char* m_error = nullptr;
+        };
+
+        /**
+         * @brief Восстанавливает значение из буфера на вершине стека.
+         * Прочитанные строки и таблицы хранятся в служебных таблицах
+         * для разрешения ссылок.
+         */
+        class Deserializer
+        {
+        public:
+            Deserializer(lua_State* l, std::string_view data, const UserDataCodecs& codecs)
+                : m_state(l), m_reader(data), m_codecs(codecs) {}
+
+            bool Read()
+            {
+                lua_State* const l = m_state;
+                if (!lua_checkstack(l, 4))
+                    return Fail("table nesting is too deep");
+
+                if (m_reader.ReadByte() != SerializationVersion || m_reader.Failed())
+                    return Fail("unsupported serialization format");
+
+                lua_createtable(l, 0, 0);
+                m_strings_index = lua_gettop(l);
+                lua_createtable(l, 0, 0);
+                m_tables_index = lua_gettop(l);
+
+                if (!ReadValue(0))
+                    return false;
+                if (m_reader.Remaining() != 0)
+                    return Fail("unexpected data after serialized value");
+
+                lua_replace(l, m_strings_index);
+                lua_settop(l, m_strings_index);
+                return true;
+            }
+
+            const char* Error()const noexcept
+            {
+                return m_error;
+            }
+
+        private:
+            bool Fail(const char* error)
+            {
+                m_error = error;
+                return false;
+            }
+
+            bool ReadValue(int depth)
+            {
+                lua_State* const l = m_state;
+                const SerializedTag tag = static_cast<SerializedTag>(m_reader.ReadByte());
+                if (m_reader.Failed())
+                    return Fail("unexpected end of data");
+
+                switch (tag)
+                {
+                case SerializedTag::Nil:
+                    lua_pushnil(l);
+                    break;
+                case SerializedTag::False:
+                    lua_pushboolean(l, false);
+                    break;
+                case SerializedTag::True:
+                    lua_pushboolean(l, true);
+                    break;
+                case SerializedTag::Integer:
+                    lua_pushinteger(l, static_cast<lua_Integer>(m_reader.ReadInteger()));
+                    break;
+                case SerializedTag::Number:
+                    lua_pushnumber(l, static_cast<lua_Number>(m_reader.ReadNumber()));
+                    break;
+                case SerializedTag::String:
+                {
+                    const std::string_view s = m_reader.ReadString();
+                    if (m_reader.Failed())
+                        return Fail("unexpected end of data");
+                    lua_pushlstring(l, s.data(), s.size());
+                    lua_pushvalue(l, -1);
+                    lua_rawseti(l, m_strings_index, ++m_strings);
+                    break;
+                }
+                case SerializedTag::StringRef:
+                    return ReadRef(m_strings_index, m_strings);
+                case SerializedTag::Table:
+                    return ReadTable(depth);
+                case SerializedTag::TableRef:
+                    return ReadRef(m_tables_index, m_tables);
+                case SerializedTag::UserData:
+                {
+                    const uint64_t codec = m_reader.ReadVarint();
+                    if (m_reader.Failed() || codec >= m_codecs.Size())
+                        return Fail("unknown userdata codec");
+                    m_codecs[static_cast<size_t>(codec)].read(l, m_reader);
+                    break;
+                }
+                default:
+                    return Fail("unknown value tag");
+                }
+                if (m_reader.Failed())
+                    return Fail("unexpected end of data");
+                return true;
+            }
+
+            bool ReadRef(int index, lua_Integer count)
+            {
+                const uint64_t id = m_reader.ReadVarint();
+                if (m_reader.Failed() || id >= static_cast<uint64_t>(count))
+                    return Fail("invalid reference");
+                lua_rawgeti(m_state, index, static_cast<lua_Integer>(id) + 1);
+                return true;
+            }
+
+            bool ReadTable(int depth)
+            {
+                lua_State* const l = m_state;
+                if (depth >= SerializationMaxDepth || !lua_checkstack(l, 4))
+                    return Fail("table nesting is too deep");
+
+                const uint64_t narr = m_reader.ReadVarint();
+                const uint64_t nhash = m_reader.ReadVarint();
+                // Каждый элемент занимает хотя бы один байт
+                if (m_reader.Failed() || narr > m_reader.Remaining() || nhash > m_reader.Remaining())
+                    return Fail("unexpected end of data");
+
+                lua_createtable(l, static_cast<int>(narr), static_cast<int>(nhash));
+                const int table = lua_gettop(l);
+                lua_pushvalue(l, table);
+                lua_rawseti(l, m_tables_index, ++m_tables);
+
+                for (uint64_t i = 1; i <= narr; i++)
+                {
+                    if (!ReadValue(depth + 1))
+                        return false;
+                    lua_rawseti(l, table, static_cast<lua_Integer>(i));
+                }
+
+                for (uint64_t i = 0; i < nhash; i++)
+                {
+                    if (!ReadValue(depth + 1))
+                        return false;
+                    if (lua_isnil(l, -1) || (lua_type(l, -1) == LUA_TNUMBER && lua_tonumber(l, -1) != lua_tonumber(l, -1)))
+                        return Fail("invalid table key");
+                    if (!ReadValue(depth + 1))
+                        return false;
+                    lua_rawset(l, table);
+                }
+                return true;
+            }
+
+            lua_State* const m_state;
+            BinaryReader m_reader;
+            const UserDataCodecs& m_codecs;
+            int m_strings_index = 0;
+            int m_tables_index = 0;
+            lua_Integer m_strings = 0;
+            lua_Integer m_tables = 0;
+            const char* m_error = nullptr;
+        };
+    }
+
+    /**
+     * @brief Записывает значение в конец буфера в двоичном формате.
+     * Поддерживаются nil, логические значения, числа, строки, таблицы
+     * (включая циклы и общие подтаблицы) и пользовательские типы из codecs.
+     * Метатаблицы не сохраняются.
+     *
+     * @param value
+     * @param out
+     * @param codecs
+     */
+    inline void Serialize(const StackObjectView& value, std::string& out, const UserDataCodecs& codecs = UserDataCodecs::Empty())
+    {
+        lua_State* const l = value.GetState();
+        const int top = lua_gettop(l);
+        const char* error = nullptr;
+        {
+            Internal::Serializer serializer{ l, out, codecs };
+            out.push_back(static_cast<char>(Internal::SerializationVersion));
+            if (!serializer.Write(value.GetIndex()))
+            {
+                error = serializer.Error();
+            }
+        }
+        lua_settop(l, top);
+        if (error)
+        {
+            luaL_error(l, "%s", error);
+        }
+    }
+
+    /**
+     * @brief Возвращает значение в двоичном формате.
+     *
+     * @param value
+     * @param codecs
+     * @return std::string
+     */
+    inline std::string Serialize(const StackObjectView& value, const UserDataCodecs& codecs = UserDataCodecs::Empty())
+    {
+        std::string out;
+        Serialize(value, out, codecs);
+        return out;
+    }
+
+    /**
+     * @brief Восстанавливает значение из двоичного формата и помещает его на стек.
+     *
+     * @param l
+     * @param data
+     * @param codecs
+     * @return StackObjectView
+     */
+    inline StackObjectView Deserialize(lua_State* l, std::string_view data, const UserDataCodecs& codecs = UserDataCodecs::Empty())
+    {
+        const int top = lua_gettop(l);
+        const char* error = nullptr;
+        {
+            Internal::Deserializer deserializer{ l, data, codecs };
+            if (!deserializer.Read())
+            {
+                error = deserializer.Error();
+            }
+        }
+        if (error)
+        {
+            lua_settop(l, top);
+            luaL_error(l, "%s", error);
+        }
+        return { l };
+    }
+}
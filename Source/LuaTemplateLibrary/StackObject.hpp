@@ -2,6 +2,7 @@
 #include "LuaAux.hpp"
 #include "Types.hpp"
 #include "CState.hpp"
+#include "Key.hpp"
 
 namespace LTL
 {
@@ -531,6 +532,34 @@ namespace LTL
             return PCallFunction<TReturn>(m_state, *this, std::forward<TArgs>(args)...);
         }
 
+        /**
+         * @brief Вызывает объект для каждого элемента диапазона.
+         *
+         * @tparam TReturn тип результата одного вызова. По ум. void.
+         * @tparam Range тип диапазона аргументов
+         * @param range диапазон аргументов, кортежи раскрываются в несколько аргументов
+         * @return BatchReturn<TReturn>
+         */
+        template <typename TReturn = void, typename Range>
+        BatchReturn<TReturn> CallBatch(const Range &range) const
+        {
+            return LTL::CallBatch<TReturn>(m_state, *this, range);
+        }
+
+        /**
+         * @brief Безопасно вызывает объект для каждого элемента диапазона.
+         *
+         * @tparam TReturn тип результата одного вызова. По ум. void.
+         * @tparam Range тип диапазона аргументов
+         * @param range диапазон аргументов, кортежи раскрываются в несколько аргументов
+         * @return std::vector<PCallReturn<TReturn>>
+         */
+        template <typename TReturn = void, typename Range>
+        std::vector<PCallReturn<TReturn>> PCallBatch(const Range &range) const
+        {
+            return LTL::PCallBatch<TReturn>(m_state, *this, range);
+        }
+
         /**
          * @brief Вызывает метод объекта по ключу с данными аргументами.
          *
@@ -569,6 +598,46 @@ namespace LTL
             return PCallStack<TReturn>(m_state, n);
         }
 
+        /**
+         * @brief Вызывает метод объекта по заранее созданному ключу с данными аргументами.
+         *
+         * @tparam TReturn тип возвращаемого значения. По ум. void.
+         * @tparam TArgs типы аргументов
+         * @param key имя метода
+         * @param args
+         * @return TReturn
+         */
+        template <typename TReturn = void, typename... TArgs>
+        TReturn SelfCall(const Key &key, TArgs &&...args) const
+        {
+            Push();
+            key.Push(m_state);
+            lua_gettable(m_state, -2);
+            lua_rotate(m_state, -2, 1);
+            const size_t n = PushArgs(m_state, std::forward<TArgs>(args)...) + 1;
+            return CallStack<TReturn>(m_state, n);
+        }
+
+        /**
+         * @brief Безопасно вызывает метод объекта по заранее созданному ключу с данными аргументами.
+         *
+         * @tparam TReturn тип возвращаемого значения. По ум. void.
+         * @tparam TArgs типы аргументов
+         * @param key имя метода
+         * @param args
+         * @return PCallReturn<TReturn>
+         */
+        template <typename TReturn = void, typename... TArgs>
+        PCallReturn<TReturn> SelfPCall(const Key &key, TArgs &&...args) const
+        {
+            Push();
+            key.Push(m_state);
+            lua_gettable(m_state, -2);
+            lua_rotate(m_state, -2, 1);
+            const size_t n = PushArgs(m_state, std::forward<TArgs>(args)...) + 1;
+            return PCallStack<TReturn>(m_state, n);
+        }
+
 #pragma endregion
 
         /**
@@ -10,9 +10,6 @@
 
 namespace LTL
 {
-    template <typename T>
-    struct UserData;
-
     struct OpNewAllocator
     {
         static void *Function(void *ud, void *ptr, size_t osize, size_t nsize)
@@ -167,6 +164,18 @@ namespace LTL
             return m_cstate->DoFile(path);
         }
 
+        /**
+         * @brief Исполняет файл с ограничением исполнения и возвращает результат работы
+         *
+         * @param path путь к файлу
+         * @param budget ограничение исполнения
+         * @return PCallResult
+         */
+        PCallResult DoFile(const char *const path, const ExecutionBudget &budget)
+        {
+            return m_cstate->DoFile(path, budget);
+        }
+
         /**
          * @brief Вызывает глобальную функцию с данными аргументами и возвращает результат
          *
@@ -197,6 +206,54 @@ namespace LTL
             return m_cstate->PCall<TReturn>(name, std::forward<Ts>(args)...);
         }
 
+        /**
+         * @brief Вызывает глобальную функцию для каждого элемента диапазона
+         *
+         * @tparam TReturn Тип результата одного вызова
+         * @tparam Range тип диапазона аргументов
+         * @param name имя функции
+         * @param range диапазон аргументов, кортежи раскрываются в несколько аргументов
+         * @return BatchReturn<TReturn>
+         */
+        template <typename TReturn = void, typename Range>
+        BatchReturn<TReturn> CallBatch(const char *name, const Range &range)
+        {
+            return m_cstate->CallBatch<TReturn>(name, range);
+        }
+
+        /**
+         * @brief Безопасно вызывает глобальную функцию для каждого элемента диапазона.
+         * Ошибки собираются для каждого элемента отдельно.
+         *
+         * @tparam TReturn Тип результата одного вызова
+         * @tparam Range тип диапазона аргументов
+         * @param name имя функции
+         * @param range диапазон аргументов, кортежи раскрываются в несколько аргументов
+         * @return std::vector<PCallReturn<TReturn>>
+         */
+        template <typename TReturn = void, typename Range>
+        std::vector<PCallReturn<TReturn>> PCallBatch(const char *name, const Range &range)
+        {
+            return m_cstate->PCallBatch<TReturn>(name, range);
+        }
+
+        /**
+         * @brief Безопасно вызывает глобальную функцию с ограничением исполнения.
+         * Если бюджет исчерпан, статус результата PCallResult::ERRBUDGET.
+         *
+         * @tparam TReturn Тип результата функции
+         * @tparam Ts типы аргументов
+         * @param budget ограничение исполнения
+         * @param name имя функции
+         * @param args
+         * @return PCallReturn<TReturn>
+         */
+        template <typename TReturn = void, typename... Ts>
+        PCallReturn<TReturn> PCall(const ExecutionBudget &budget, const char *name, Ts &&...args)
+        {
+            return m_cstate->PCall<TReturn>(budget, name, std::forward<Ts>(args)...);
+        }
+
         /**
          * @brief Выполняет данную строку.
          * 
@@ -77,6 +77,15 @@ namespace LTL
           }*/
     };
 
+    /**
+     * @brief Пользовательский тип в Lua.
+     *
+     * @tparam T пользовательский тип
+     * @tparam Holder владеющий T указатель или void, если объект хранится в UserData
+     */
+    template<typename T, typename Holder = void>
+    struct UserData;
+
     template<>
     struct StackType<lua_State*> : AlwaysValid
     {
@@ -4,6 +4,7 @@
 #include "FuncArguments.hpp"
 #include "Exception.hpp"
 #include "RefObject.hpp"
+#include <cstdint>
 
 namespace LTL
 {
@@ -22,13 +23,187 @@ namespace LTL
         }
     };
 
+    namespace Internal
+    {
+        struct StorageType;
+
+        /**
+         * @brief Заголовок памяти UserData: способ хранения объекта и признак его уничтожения.
+         * Одинаков для всех классов, поэтому читается без знания точного типа объекта.
+         * Признак хранится в младшем бите указателя, так что заголовок занимает одно слово.
+         */
+        struct UserDataHeader
+        {
+            void Init(const StorageType* storage) noexcept
+            {
+                m_bits = reinterpret_cast<uintptr_t>(storage);
+            }
+
+            const StorageType* Storage()const noexcept
+            {
+                return reinterpret_cast<const StorageType*>(m_bits & ~DestroyedBit);
+            }
+
+            bool IsDestroyed()const noexcept
+            {
+                return (m_bits & DestroyedBit) != 0;
+            }
+
+            void MarkDestroyed() noexcept
+            {
+                m_bits |= DestroyedBit;
+            }
+
+            /**
+             * @brief Хранится ли объект способом storage и не уничтожен ли он. Одно сравнение.
+             */
+            bool Is(const StorageType* storage)const noexcept
+            {
+                return m_bits == reinterpret_cast<uintptr_t>(storage);
+            }
+
+        private:
+            static constexpr uintptr_t DestroyedBit = 1;
+
+            uintptr_t m_bits;
+        };
+
+        /**
+         * @brief Описание класса в иерархии одиночного наследования.
+         * chain содержит цепочку предков от корня до самого класса, так что
+         * класс D является наследником B тогда и только тогда, когда chain[B.depth] == &B.
+         * Проверка не зависит от глубины иерархии и не обходит метатаблицы.
+         */
+        struct ClassType
+        {
+            static constexpr size_t MaxDepth = 16;
+
+            size_t depth = 0;
+            const ClassType* chain[MaxDepth]{};
+            /// @brief Смещение подобъекта предка относительно объекта класса
+            ptrdiff_t offsets[MaxDepth]{};
+
+            bool IsA(const ClassType& base)const noexcept
+            {
+                return base.depth <= depth && chain[base.depth] == &base;
+            }
+
+            /**
+             * @brief Ключ, которым помечаются метатаблицы классов.
+             * Объект с такой метатаблицей начинается с UserDataHeader.
+             */
+            static const void* MarkerKey()
+            {
+                static const char key = 0;
+                return &key;
+            }
+
+            /**
+             * @brief Ключ метатаблицы класса, объекты которого могут получать произвольные поля.
+             * Такие объекты создаются с одним user value, в котором при первой записи
+             * неизвестного поля создается таблица этих полей.
+             */
+            static const void* ExpandoKey()
+            {
+                static const char key = 0;
+                return &key;
+            }
+
+            /**
+             * @brief Ключ метатаблицы класса с отслеживанием записей (DirtyTracker).
+             * Объекты такого класса создаются со словом маски измененных свойств после объекта.
+             */
+            static const void* DirtyKey()
+            {
+                static const char key = 0;
+                return &key;
+            }
+        };
+
+        /**
+         * @brief Способ хранения объекта класса type в UserData:
+         * сам объект, владеющий им указатель или ссылка на часть другого объекта.
+         * object возвращает nullptr, если объект больше недоступен.
+         */
+        struct StorageType
+        {
+            const ClassType* type = nullptr;
+            void* (*object)(UserDataHeader*) = nullptr;
+            void (*destroy)(UserDataHeader*) = nullptr;
+            /// @brief Отмечает владельца объекта по индексу на стеке после записи свойства; есть только у ссылок
+            void (*touch)(lua_State*, int) = nullptr;
+
+            /**
+             * @brief Возвращает указатель на подобъект предка base в объекте с заголовком header
+             * или nullptr, если объект недоступен
+             */
+            void* Cast(UserDataHeader* header, const ClassType& base)const noexcept
+            {
+                char* const p = static_cast<char*>(object(header));
+                return p == nullptr ? nullptr : p + type->offsets[base.depth];
+            }
+        };
+
+        static_assert(alignof(StorageType) > 1, "Destroyed flag requires aligned StorageType");
+
+        /// @brief Выравнивание, которое Lua гарантирует для памяти userdata
+        constexpr size_t LuaUserDataAlignment = alignof(lua_Number) > alignof(void*) ? alignof(lua_Number) : alignof(void*);
+
+        /**
+         * @brief Размещение объекта T после заголовка в памяти UserData.
+         * Если T требует выравнивания больше, чем дает Lua, память выделяется с запасом
+         * и объект выравнивается по фактическому адресу, который у userdata не меняется.
+         *
+         * @tparam T
+         */
+        template<typename T>
+        struct UserDataLayout
+        {
+            static constexpr size_t HeaderSize = sizeof(UserDataHeader);
+            static constexpr bool OverAligned = alignof(T) > LuaUserDataAlignment;
+            static constexpr size_t Offset = (HeaderSize + alignof(T) - 1) / alignof(T) * alignof(T);
+            /// @brief Размер памяти userdata
+            static constexpr size_t Size = OverAligned ? HeaderSize + (alignof(T) - LuaUserDataAlignment) + sizeof(T) : Offset + sizeof(T);
+            /// @brief Смещение слова маски измененных свойств, которое есть только у объектов классов с отслеживанием
+            static constexpr size_t MaskOffset = (Size + alignof(uint64_t) - 1) / alignof(uint64_t) * alignof(uint64_t);
+            /// @brief Размер памяти userdata со словом маски
+            static constexpr size_t TrackedSize = MaskOffset + sizeof(uint64_t);
+
+            static uint64_t* Mask(UserDataHeader* header) noexcept
+            {
+                return reinterpret_cast<uint64_t*>(reinterpret_cast<char*>(header) + MaskOffset);
+            }
+
+            static T* Object(UserDataHeader* header) noexcept
+            {
+                char* const base = reinterpret_cast<char*>(header);
+                if constexpr (OverAligned)
+                {
+                    const uintptr_t p = reinterpret_cast<uintptr_t>(base + HeaderSize);
+                    constexpr uintptr_t mask = static_cast<uintptr_t>(alignof(T)) - 1;
+                    return reinterpret_cast<T*>((p + mask) & ~mask);
+                }
+                else
+                {
+                    return reinterpret_cast<T*>(base + Offset);
+                }
+            }
+        };
+
+        template<typename Base, typename Derived, typename = void>
+        struct IsNonVirtualBase : std::false_type {};
+
+        template<typename Base, typename Derived>
+        struct IsNonVirtualBase<Base, Derived, std::void_t<decltype(static_cast<Derived*>(std::declval<Base*>()))>> : std::is_base_of<Base, Derived> {};
+    }
+
     /**
      * @brief Класс представляющий пользовательский тип в Lua
      *
      * @tparam T пользовательский тип
      */
     template<typename T>
-    struct UserData : Internal::UserDataPtr<T>
+    struct UserData<T, void> : Internal::UserDataPtr<T>
     {
         using _UserDataValue = Internal::UserDataPtr<T>;
         using _UserDataValue::_UserDataValue;
@@ -39,27 +214,82 @@ namespace LTL
         struct IndexTable : public RegistryTableBase<IndexTable> {};
         struct NewIndexTable : public RegistryTableBase<NewIndexTable> {};
 
-        struct Data
-        {
-            T object;
-            bool isDestroyed = false;
-        };
+        using Layout = Internal::UserDataLayout<T>;
     private:
+        static void* ObjectOf(Internal::UserDataHeader* header)
+        {
+            return Layout::Object(header);
+        }
+
+        static void DestroyObject(Internal::UserDataHeader* header)
+        {
+            if constexpr (!std::is_trivially_destructible_v<T>)
+            {
+                Layout::Object(header)->~T();
+            }
+        }
+
+        static inline Internal::ClassType s_type{ 0, { &s_type }, {} };
+        static inline const Internal::StorageType s_storage{ &s_type, &ObjectOf, &DestroyObject };
+
         /**
          * @brief Помещает на стек UserData<T> и возвращает указатель на его место
-         * в памяти для дальнейшего использования с оператором new
+         * в памяти для дальнейшего использования с оператором new.
+         * Userdata создается без user value, если у класса не включены произвольные поля.
          *
          * @param l
          * @return void* const
          */
         static T* const  Allocate(lua_State* l)
         {
-            Data* const data = (Data*)lua_newuserdata(l, sizeof(Data));
-            data->isDestroyed = false;
-            SetClassMetaTable(l);
-            return &data->object;
+            const int uservalues = PushNewObjectMetaTable(l);
+            const bool tracked = lua_rawgetp(l, -1, Internal::ClassType::DirtyKey()) != LUA_TNIL;
+            lua_pop(l, 1);
+            Internal::UserDataHeader* const header = static_cast<Internal::UserDataHeader*>(lua_newuserdatauv(l, tracked ? Layout::TrackedSize : Layout::Size, uservalues));
+            header->Init(&s_storage);
+            if (tracked)
+            {
+                *Layout::Mask(header) = 0;
+            }
+            lua_insert(l, -2);
+            lua_setmetatable(l, -2);
+            return Layout::Object(header);
         }
     public:
+        static constexpr const Internal::ClassType& GetType()
+        {
+            return s_type;
+        }
+
+        /**
+         * @brief Делает T наследником Base: объекты T принимаются там, где ожидается Base.
+         * Base должен быть настроен раньше своих наследников.
+         *
+         * @tparam Base
+         * @return false, если иерархия глубже ClassType::MaxDepth; тип T при этом не меняется
+         */
+        template<typename Base>
+        static bool SetBase()
+        {
+            static_assert(!std::is_same_v<Base, T> && std::is_base_of_v<Base, T>, "T must be derived from Base");
+            static_assert(Internal::IsNonVirtualBase<Base, T>::value, "Virtual inheritance isn't supported");
+
+            const Internal::ClassType& base = UserData<Base>::GetType();
+            if (base.depth + 1 >= Internal::ClassType::MaxDepth)
+                return false;
+
+            const ptrdiff_t offset = UpcastOffset<Base>();
+            s_type.depth = base.depth + 1;
+            for (size_t i = 0; i <= base.depth; i++)
+            {
+                s_type.chain[i] = base.chain[i];
+                s_type.offsets[i] = offset + base.offsets[i];
+            }
+            s_type.chain[s_type.depth] = &s_type;
+            s_type.offsets[s_type.depth] = 0;
+            return true;
+        }
+
         /**
          * @brief Помещает на стек UserData<T> через move copy данного объекта
          *
@@ -127,6 +357,23 @@ namespace LTL
             return GRefObject::FromTop(l);
         }
 
+        /**
+         * @brief Помещает на стек метатаблицу класса для нового объекта
+         *
+         * @param l
+         * @return int число user value, с которым создается объект
+         */
+        static int PushNewObjectMetaTable(lua_State* l)
+        {
+            if (MetaTable::Push(l) != LUA_TTABLE)
+            {
+                luaL_error(l, "%s", "The class was't registered");
+            }
+            const int expando = lua_rawgetp(l, -1, Internal::ClassType::ExpandoKey());
+            lua_pop(l, 1);
+            return expando == LUA_TNIL ? 0 : ExpandoSlot;
+        }
+
         /**
          * @brief Устанавливает метатаблицу класса на объект на стеке
          *
@@ -142,25 +389,38 @@ namespace LTL
         }
 
         /**
-         * @brief Функция для уничтожения UserData<T>
+         * @brief Уничтожает объект UserData<T> (или его наследника) по индексу на стеке, не дожидаясь сборщика мусора.
+         * Дальнейшие обращения к объекту из Lua вызывают ошибку, повторное уничтожение ничего не делает.
+         * Для UserData, владеющих T через указатель, освобождается указатель.
          *
          * @param l
-         * @return int
+         * @param index
+         * @return true если объект был уничтожен этим вызовом
          */
-        static int DestructorFunction(lua_State* l)
+        static bool Destroy(lua_State* l, int index)
         {
+            Internal::UserDataHeader* header = ToHeader(l, index);
 
-            Data* data = ToUserData(l, 1);
-
-            if (data != nullptr)
+            if (header == nullptr || header->IsDestroyed())
             {
-                if (!data->isDestroyed)
-                {
-                    data->object.~T();
-                    data->isDestroyed = true;
-                }
+                return false;
             }
 
+            header->Storage()->destroy(header);
+            header->MarkDestroyed();
+            return true;
+        }
+
+        /**
+         * @brief Функция для уничтожения UserData<T>, в том числе владеющих T через указатель.
+         * Используется как __gc и __close.
+         *
+         * @param l
+         * @return int
+         */
+        static int DestructorFunction(lua_State* l)
+        {
+            Destroy(l, 1);
             return 0;
         }
 
@@ -194,7 +454,28 @@ namespace LTL
             return r;
         }
 
-        static Data* ToUserData(lua_State* l, int index)
+        /**
+         * @brief Проверяет является ли объект по индексу на стеке UserData<T> или его наследника
+         *
+         * @param l
+         * @param index
+         * @return true
+         * @return false
+         */
+        static bool IsInstance(lua_State* l, int index)
+        {
+            const Internal::UserDataHeader* header = FindHeader(l, index);
+            return header != nullptr && header->Storage()->type->IsA(s_type);
+        }
+
+        /**
+         * @brief Возвращает заголовок UserData<T> или его наследника
+         *
+         * @param l
+         * @param index
+         * @return Internal::UserDataHeader*
+         */
+        static Internal::UserDataHeader* ToHeader(lua_State* l, int index)
         {
             if (!lua_isuserdata(l, index))
             {
@@ -208,34 +489,69 @@ namespace LTL
                 return nullptr;
             }
 
-            if (MetaTable::Push(l) == LUA_TNIL)
+            const int marker = lua_rawgetp(l, -1, Internal::ClassType::MarkerKey());
+            lua_pop(l, 2);
+            if (marker == LUA_TNIL)
             {
+                if (MetaTable::Push(l) == LUA_TNIL)
+                {
+                    lua_pop(l, 1);
+                    ThrowNoMetaTableForUD(l, index);
+                    return nullptr;
+                }
                 lua_pop(l, 1);
-                ThrowNoMetaTableForUD(l, index);
+                ThrowWrongUserDataType(l, index);
                 return nullptr;
             }
 
-            bool res = lua_rawequal(l, -2, -1);
-            lua_pop(l, 2);
+            Internal::UserDataHeader* header = static_cast<Internal::UserDataHeader*>(lua_touserdata(l, index));
+            if (!header->Storage()->type->IsA(s_type))
+            {
+                ThrowWrongUserDataType(l, index);
+                return nullptr;
+            }
+            return header;
+        }
 
-            if (!res)
+        /**
+         * @brief Возвращает заголовок UserData<T>, хранящего объект в себе.
+         * Объекты наследников и указатели не принимаются.
+         *
+         * @param l
+         * @param index
+         * @return Internal::UserDataHeader*
+         */
+        static Internal::UserDataHeader* ToUserData(lua_State* l, int index)
+        {
+            Internal::UserDataHeader* header = ToHeader(l, index);
+            if (header != nullptr && header->Storage() != &s_storage)
             {
                 ThrowWrongUserDataType(l, index);
                 return nullptr;
             }
-            return static_cast<Data*>(lua_touserdata(l, index));
+            return header;
         }
 
         static T* ValidateUserData(lua_State* l, int index)
         {
-            Data* data = ToUserData(l, index);
-            if (data == nullptr || data->isDestroyed)
+            Internal::UserDataHeader* header = ToHeader(l, index);
+            if (header != nullptr && header->Is(&s_storage))
+            {
+                return Layout::Object(header);
+            }
+
+            if (header == nullptr || header->IsDestroyed())
             {
                 ThrowUDDestroyed(l, index);
                 return nullptr;
             }
 
-            return &data->object;
+            T* const object = static_cast<T*>(header->Storage()->Cast(header, s_type));
+            if (object == nullptr)
+            {
+                ThrowUDDestroyed(l, index);
+            }
+            return object;
         }
 
         static int IndexMethod(lua_State* l)
@@ -249,10 +565,21 @@ namespace LTL
 
                 MethodsTable::Push(l);
                 lua_pushvalue(l, 2);
-                lua_rawget(l, -2); // get value in metatable
+                type = lua_rawget(l, -2); // get value in metatable
 
                 lua_remove(l, -2); // remove metatable
 
+                if (type != LUA_TNIL)
+                    return 1;
+
+                if (lua_getiuservalue(l, 1, ExpandoSlot) != LUA_TTABLE)
+                {
+                    lua_pushnil(l);
+                    return 1;
+                }
+                lua_pushvalue(l, 2);
+                lua_rawget(l, -2);
+
                 return 1;
             }
 
@@ -274,6 +601,9 @@ namespace LTL
             int type = lua_rawget(l, -2);
             if (type == LUA_TNIL)
             {
+                if (SetExpandoField(l))
+                    return 0;
+
                 const char* s = luaL_tolstring(l, 2, nullptr);
                 luaL_error(l, "Attempt to set field '%s' on %s", s ? s : "UNCONVRTIBLE_KEY", GetClassName(l));
             }
@@ -286,9 +616,34 @@ namespace LTL
 
             lua_call(l, 2, 0);
 
+            const Internal::StorageType* const storage = static_cast<Internal::UserDataHeader*>(lua_touserdata(l, 1))->Storage();
+            if (storage->touch != nullptr)
+            {
+                storage->touch(l, 1);
+            }
             return 0;
         }
 
+        /**
+         * @brief Возвращает слово маски измененных свойств объекта T по индексу на стеке
+         * или nullptr, если объект не хранится на месте, уничтожен или создан без отслеживания.
+         * Объект по индексу должен иметь метатаблицу зарегистрированного класса.
+         *
+         * @param l
+         * @param index
+         * @return uint64_t*
+         */
+        static uint64_t* DirtyMask(lua_State* l, int index)
+        {
+            Internal::UserDataHeader* const header = static_cast<Internal::UserDataHeader*>(lua_touserdata(l, index));
+            if (!header->Is(&s_storage) || lua_rawlen(l, index) != Layout::TrackedSize)
+                return nullptr;
+            return Layout::Mask(header);
+        }
+
+        /// @brief Номер user value с таблицей произвольных полей объекта
+        static constexpr int ExpandoSlot = 1;
+
         static const char* GetClassName(lua_State* l)
         {
             if (ClassTable::Push(l) == LUA_TNIL)
@@ -306,6 +661,57 @@ namespace LTL
         }
 
     private:
+        static Internal::UserDataHeader* FindHeader(lua_State* l, int index)
+        {
+            if (!lua_isuserdata(l, index) || !lua_getmetatable(l, index))
+            {
+                return nullptr;
+            }
+            const int marker = lua_rawgetp(l, -1, Internal::ClassType::MarkerKey());
+            lua_pop(l, 2);
+            return marker == LUA_TNIL ? nullptr : static_cast<Internal::UserDataHeader*>(lua_touserdata(l, index));
+        }
+
+        /**
+         * @brief Записывает поле (аргументы 2 и 3) в таблицу произвольных полей объекта (аргумент 1),
+         * создавая ее при первой записи.
+         *
+         * @param l
+         * @return false если объект не может хранить произвольные поля
+         */
+        static bool SetExpandoField(lua_State* l)
+        {
+            const int type = lua_getiuservalue(l, 1, ExpandoSlot);
+            if (type == LUA_TNIL)
+            {
+                lua_pop(l, 1);
+                if (lua_isnil(l, 3))
+                    return true;
+
+                lua_newtable(l);
+                lua_pushvalue(l, -1);
+                lua_setiuservalue(l, 1, ExpandoSlot);
+            }
+            else if (type != LUA_TTABLE)
+            {
+                lua_pop(l, 1);
+                return false;
+            }
+            lua_pushvalue(l, 2);
+            lua_pushvalue(l, 3);
+            lua_rawset(l, -3);
+            lua_pop(l, 1);
+            return true;
+        }
+
+        template<typename Base>
+        static ptrdiff_t UpcastOffset()
+        {
+            alignas(T) unsigned char storage[sizeof(T)];
+            T* const derived = reinterpret_cast<T*>(storage);
+            return reinterpret_cast<char*>(static_cast<Base*>(derived)) - reinterpret_cast<char*>(derived);
+        }
+
 #pragma region ThrowFunctions
         static void ThrowInvalidUserData(lua_State* l, int index)
         {
@@ -341,7 +747,7 @@ namespace LTL
 
         static bool Check(lua_State* l, int index)
         {
-            return UD::IsUserData(l, index);
+            return UD::IsInstance(l, index);
         }
 
         static UD Get(lua_State* l, int index)
@@ -364,6 +770,18 @@ namespace LTL
                 static_assert(!std::is_move_constructible_v <T> && !std::is_copy_constructible_v<T>, "Can't create copy of userdata! Use direct creation of userdata on stack with UserData<T>::New.");
             }
         }
+
+        static void Push(lua_State* l, T&& value)
+        {
+            if constexpr (std::is_move_constructible_v<T>)
+            {
+                UD::PushCopy(l, std::move(value));
+            }
+            else
+            {
+                Push(l, value);
+            }
+        }
     };
 
 }
\ No newline at end of file
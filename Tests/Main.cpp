@@ -1100,6 +1100,934 @@ void MetatableTest()
         )");
 }
 
+void SerializationBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    s.Run(R"(
+        local function Make(depth)
+            local t = {}
+            for i = 1, 8 do
+                t[i] = i * 0.5
+            end
+            t.name = "node"
+            t.id = depth
+            t.flag = depth % 2 == 0
+            if depth > 0 then
+                t.children = {}
+                for i = 1, 4 do
+                    t.children[i] = Make(depth - 1)
+                end
+            end
+            return t
+        end
+        data = Make(7)
+
+        local function Dump(v, out)
+            local tv = type(v)
+            if tv == "table" then
+                out[#out + 1] = "{"
+                for k, x in pairs(v) do
+                    out[#out + 1] = "["
+                    Dump(k, out)
+                    out[#out + 1] = "]="
+                    Dump(x, out)
+                    out[#out + 1] = ","
+                end
+                out[#out + 1] = "}"
+            elseif tv == "string" then
+                out[#out + 1] = string.format("%q", v)
+            else
+                out[#out + 1] = tostring(v)
+            end
+        end
+
+        function ToSource(v)
+            local out = {}
+            Dump(v, out)
+            return table.concat(out)
+        end
+    )");
+
+    lua_State* l = s.GetState()->Unwrap();
+    const int n = 20;
+
+    double start = GetSystemTime();
+    size_t lua_size = 0;
+    for (int i = 0; i < n; i++)
+    {
+        auto source = s.Call<std::string>("ToSource", s.GetGlobal("data"));
+        lua_size = source.size();
+        s.Run("local _ = " + source);
+    }
+    double lua_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    size_t binary_size = 0;
+    std::string bytes;
+    for (int i = 0; i < n; i++)
+    {
+        bytes.clear();
+        lua_getglobal(l, "data");
+        Serialize(StackObjectView{ l }, bytes);
+        lua_pop(l, 1);
+        binary_size = bytes.size();
+        Deserialize(l, bytes);
+        lua_pop(l, 1);
+    }
+    double binary_time = GetSystemTime() - start;
+
+    cout << "Lua source: " << lua_time / n << "s per round trip, " << lua_size << " bytes" << endl;
+    cout << "Binary: " << binary_time / n << "s per round trip, " << binary_size << " bytes" << endl;
+}
+
+void JsonBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    s.OpenLib(Libs::json);
+    s.Run(R"(
+        local function Make(depth)
+            local t = { values = {}, name = "node \"" .. depth .. "\"", id = depth, flag = depth % 2 == 0 }
+            for i = 1, 8 do
+                t.values[i] = i * 0.5
+            end
+            if depth > 0 then
+                t.children = {}
+                for i = 1, 4 do
+                    t.children[i] = Make(depth - 1)
+                end
+            end
+            return t
+        end
+        data = Make(7)
+
+        local escapes = { ['"'] = '\\"', ['\\'] = '\\\\', ['\n'] = '\\n', ['\r'] = '\\r', ['\t'] = '\\t' }
+
+        local function Encode(v, out)
+            local tv = type(v)
+            if tv == "table" then
+                if #v > 0 then
+                    out[#out + 1] = "["
+                    for i = 1, #v do
+                        if i > 1 then out[#out + 1] = "," end
+                        Encode(v[i], out)
+                    end
+                    out[#out + 1] = "]"
+                else
+                    out[#out + 1] = "{"
+                    local first = true
+                    for k, x in pairs(v) do
+                        if not first then out[#out + 1] = "," end
+                        first = false
+                        Encode(tostring(k), out)
+                        out[#out + 1] = ":"
+                        Encode(x, out)
+                    end
+                    out[#out + 1] = "}"
+                end
+            elseif tv == "string" then
+                out[#out + 1] = '"' .. v:gsub('[%c"\\]', escapes) .. '"'
+            else
+                out[#out + 1] = tostring(v)
+            end
+        end
+
+        function LuaEncode(v)
+            local out = {}
+            Encode(v, out)
+            return table.concat(out)
+        end
+
+        function NativeEncode(v)
+            return json.encode(v)
+        end
+    )");
+
+    const int n = 20;
+
+    double start = GetSystemTime();
+    size_t lua_size = 0;
+    for (int i = 0; i < n; i++)
+    {
+        lua_size = s.Call<std::string>("LuaEncode", s.GetGlobal("data")).size();
+    }
+    double lua_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    size_t native_size = 0;
+    for (int i = 0; i < n; i++)
+    {
+        native_size = s.Call<std::string>("NativeEncode", s.GetGlobal("data")).size();
+    }
+    double native_time = GetSystemTime() - start;
+
+    lua_State* l = s.GetState()->Unwrap();
+    std::string text;
+    auto data = s.GetGlobal("data");
+    start = GetSystemTime();
+    for (int i = 0; i < n; i++)
+    {
+        text.clear();
+        Json::Encode(data, text);
+    }
+    double cpp_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    for (int i = 0; i < n; i++)
+    {
+        Json::Decode(l, text);
+        lua_pop(l, 1);
+    }
+    double decode_time = GetSystemTime() - start;
+
+    cout << "Lua encoder: " << lua_time / n << "s per call, " << lua_size << " bytes" << endl;
+    cout << "json.encode: " << native_time / n << "s per call, " << native_size << " bytes" << endl;
+    cout << "Json::Encode: " << cpp_time / n << "s per call, " << text.size() * n / cpp_time / 1e6 << " MB/s" << endl;
+    cout << "Json::Decode: " << decode_time / n << "s per call, " << text.size() * n / decode_time / 1e6 << " MB/s" << endl;
+}
+
+struct BenchEvent
+{
+    int id = 0;
+    int kind = 0;
+    double x = 0;
+    double y = 0;
+    bool handled = false;
+};
+
+template<>
+struct LTL::StructFields<BenchEvent>
+{
+    static constexpr auto fields = std::make_tuple(
+        StructField<&BenchEvent::id>{ "id" },
+        StructField<&BenchEvent::kind>{ "kind" },
+        StructField<&BenchEvent::x>{ "x" },
+        StructField<&BenchEvent::y>{ "y" },
+        StructField<&BenchEvent::handled>{ "handled" }
+    );
+};
+
+void ReflectionBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    lua_State* l = s.GetState()->Unwrap();
+    const int n = 1000000;
+    BenchEvent event{ 1, 2, 0.5, 1.5, false };
+
+    double start = GetSystemTime();
+    for (int i = 0; i < n; i++)
+    {
+        lua_newtable(l);
+        lua_pushinteger(l, event.id);
+        lua_setfield(l, -2, "id");
+        lua_pushinteger(l, event.kind);
+        lua_setfield(l, -2, "kind");
+        lua_pushnumber(l, event.x);
+        lua_setfield(l, -2, "x");
+        lua_pushnumber(l, event.y);
+        lua_setfield(l, -2, "y");
+        lua_pushboolean(l, event.handled);
+        lua_setfield(l, -2, "handled");
+
+        lua_getfield(l, -1, "id");
+        event.id = static_cast<int>(lua_tointeger(l, -1));
+        lua_getfield(l, -2, "kind");
+        event.kind = static_cast<int>(lua_tointeger(l, -1));
+        lua_getfield(l, -3, "x");
+        event.x = lua_tonumber(l, -1);
+        lua_getfield(l, -4, "y");
+        event.y = lua_tonumber(l, -1);
+        lua_getfield(l, -5, "handled");
+        event.handled = lua_toboolean(l, -1);
+        lua_pop(l, 6);
+    }
+    double manual_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    for (int i = 0; i < n; i++)
+    {
+        PushValue(l, event);
+        event = GetValue<BenchEvent>(l, -1);
+        lua_pop(l, 1);
+    }
+    double reflected_time = GetSystemTime() - start;
+
+    cout << "lua_setfield: " << manual_time << "s" << endl;
+    cout << "StructFields: " << reflected_time << "s" << endl;
+}
+
+void KeyBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    s.Run(R"(
+        event = {
+            id = 1, kind = 2, source = 3, target = 4, x = 5,
+            y = 6, z = 7, flags = 8, time = 9, value = 10,
+        }
+    )");
+
+    lua_State* l = s.GetState()->Unwrap();
+    const char* names[] = { "id", "kind", "source", "target", "x", "y", "z", "flags", "time", "value" };
+    vector<Key> keys;
+    for (const char* name : names)
+    {
+        keys.emplace_back(l, name);
+    }
+
+    const int n = 1000000;
+    StackObjectView event = StackObjectView::Global(l, "event");
+
+    double start = GetSystemTime();
+    lua_Integer sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        for (const char* name : names)
+        {
+            sum += event.RawGet<lua_Integer>(name);
+        }
+    }
+    double string_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    lua_Integer key_sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        for (const Key& key : keys)
+        {
+            key_sum += event.RawGet<lua_Integer>(key);
+        }
+    }
+    double key_time = GetSystemTime() - start;
+    lua_pop(l, 1);
+
+    cout << "const char*: " << string_time << "s (" << sum << ")" << endl;
+    cout << "Key: " << key_time << "s (" << key_sum << ")" << endl;
+}
+
+void FunctionHandleBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    s.Run(R"(
+        local count = 0
+        function OnInput(id) count = count + id end
+        function OnUpdate(id) count = count + id end
+        function OnRender(id) count = count + id end
+    )");
+
+    const int n = 1000000;
+
+    double start = GetSystemTime();
+    for (int i = 0; i < n; i++)
+    {
+        s.Call("OnInput", i);
+        s.Call("OnUpdate", i);
+        s.Call("OnRender", i);
+    }
+    double name_time = GetSystemTime() - start;
+
+    FunctionHandle on_input{ s, "OnInput" };
+    FunctionHandle on_update{ s, "OnUpdate" };
+    FunctionHandle on_render{ s, "OnRender", true };
+
+    start = GetSystemTime();
+    for (int i = 0; i < n; i++)
+    {
+        on_input.Call(i);
+        on_update.Call(i);
+        on_render.Call(i);
+    }
+    double handle_time = GetSystemTime() - start;
+
+    cout << "Call by name: " << name_time << "s" << endl;
+    cout << "FunctionHandle: " << handle_time << "s" << endl;
+}
+
+void LuaFunctionBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    s.Run("function Handler(id, x, y) return id + x * y end");
+
+    const int n = 1000000;
+    GRefObject handler = s.GetGlobal("Handler");
+    LuaFunction<double(int, double, double)> typed{ handler };
+
+    double start = GetSystemTime();
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        sum += handler.Call<double>(i, 0.5, 2.0);
+    }
+    double ref_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    double typed_sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        typed_sum += typed(i, 0.5, 2.0);
+    }
+    double typed_time = GetSystemTime() - start;
+
+    cout << "RefObject::Call: " << ref_time << "s (" << sum << ")" << endl;
+    cout << "LuaFunction: " << typed_time << "s (" << typed_sum << ")" << endl;
+}
+
+void CallBatchBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    s.Run("function Transform(id, value) return id * 0.5 + value end");
+
+    const int n = 1000000;
+    vector<tuple<int, double>> records(n);
+    for (int i = 0; i < n; i++)
+    {
+        records[i] = { i, i * 0.25 };
+    }
+
+    double start = GetSystemTime();
+    vector<double> single;
+    single.reserve(n);
+    for (const auto& [id, value] : records)
+    {
+        single.push_back(s.Call<double>("Transform", id, value));
+    }
+    double single_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    vector<double> batch = s.CallBatch<double>("Transform", records);
+    double batch_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    auto protected_batch = s.PCallBatch<double>("Transform", records);
+    double protected_time = GetSystemTime() - start;
+
+    cout << "Call per record: " << single_time << "s" << endl;
+    cout << "CallBatch: " << batch_time << "s" << endl;
+    cout << "PCallBatch: " << protected_time << "s (" << protected_batch.size() << ")" << endl;
+}
+
+void CollectionsBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    s.OpenLib(Libs::collections);
+    s.Run(R"(
+        local n = 1000000
+        data = {}
+        for i = 1, n do
+            data[i] = i * 0.001
+        end
+        buffer = collections.buffer(data)
+
+        function LuaLoop(t)
+            local scaled = {}
+            for i = 1, #t do
+                scaled[i] = t[i] * 2
+            end
+            local sum = 0
+            for i = 1, #scaled do
+                sum = sum + scaled[i] * t[i]
+            end
+            return sum
+        end
+
+        function NativeLoop(t)
+            return collections.dot(collections.map(t, "mul", 2), t)
+        end
+    )");
+
+    const int n = 10;
+    double result = 0;
+
+    double start = GetSystemTime();
+    for (int i = 0; i < n; i++)
+    {
+        result = s.Call<double>("LuaLoop", s.GetGlobal("data"));
+    }
+    double lua_time = GetSystemTime() - start;
+    cout << "Lua loop: " << lua_time << "s " << result << endl;
+
+    start = GetSystemTime();
+    for (int i = 0; i < n; i++)
+    {
+        result = s.Call<double>("NativeLoop", s.GetGlobal("data"));
+    }
+    double table_time = GetSystemTime() - start;
+    cout << "collections on table: " << table_time << "s " << result << endl;
+
+    start = GetSystemTime();
+    for (int i = 0; i < n; i++)
+    {
+        result = s.Call<double>("NativeLoop", s.GetGlobal("buffer"));
+    }
+    double buffer_time = GetSystemTime() - start;
+    cout << "collections on NumberBuffer: " << buffer_time << "s " << result << endl;
+}
+
+void NumericVectorBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    s.Run(R"(
+        mesh = {}
+        for i = 1, 100000 do
+            mesh[i] = i * 0.01
+        end
+    )");
+
+    lua_State* l = s.GetState()->Unwrap();
+    const int n = 100;
+    lua_getglobal(l, "mesh");
+
+    double start = GetSystemTime();
+    size_t total = 0;
+    for (int i = 0; i < n; i++)
+    {
+        StackObjectView table{ l, -1 };
+        const size_t size = table.RawLen();
+        vector<float> result(size);
+        for (size_t j = 0; j < size; j++)
+        {
+            result[j] = table.RawGetI<float>(j + 1);
+        }
+        total += result.size();
+    }
+    double element_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    for (int i = 0; i < n; i++)
+    {
+        total += GetValue<vector<float>>(l, -1).size();
+    }
+    double numeric_time = GetSystemTime() - start;
+
+    vector<float> values = GetValue<vector<float>>(l, -1);
+    lua_pop(l, 1);
+
+    start = GetSystemTime();
+    for (int i = 0; i < n; i++)
+    {
+        PushValue(l, values);
+        lua_pop(l, 1);
+    }
+    double push_time = GetSystemTime() - start;
+
+    cout << "Element-wise vector<float>: " << element_time << "s" << endl;
+    cout << "Numeric vector<float>: " << numeric_time << "s" << endl;
+    cout << "Push vector<float>: " << push_time << "s (" << total << ")" << endl;
+}
+
+void AssociativeBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    s.Run(R"(
+        routes = {}
+        for i = 1, 50000 do
+            routes["/api/v1/resource/" .. i] = i
+        end
+    )");
+
+    lua_State* l = s.GetState()->Unwrap();
+    const int n = 20;
+    lua_getglobal(l, "routes");
+    const int table = lua_gettop(l);
+
+    double start = GetSystemTime();
+    size_t total = 0;
+    for (int i = 0; i < n; i++)
+    {
+        unordered_map<string, int> result;
+        lua_pushnil(l);
+        while (lua_next(l, table))
+        {
+            result.insert({ GetValue<string>(l, -2), GetValue<int>(l, -1) });
+            lua_pop(l, 1);
+        }
+        total += result.size();
+    }
+    double insert_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    for (int i = 0; i < n; i++)
+    {
+        total += GetValue<unordered_map<string, int>>(l, table).size();
+    }
+    double reserved_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    for (int i = 0; i < n; i++)
+    {
+        total += GetValue<map<string, int>>(l, table).size();
+    }
+    double sorted_time = GetSystemTime() - start;
+    lua_pop(l, 1);
+
+    cout << "unordered_map without reserve: " << insert_time << "s" << endl;
+    cout << "unordered_map with size hint: " << reserved_time << "s" << endl;
+    cout << "map: " << sorted_time << "s (" << total << ")" << endl;
+}
+
+long long TotalLength(const std::vector<std::string>& values)
+{
+    long long n = 0;
+    for (const auto& s : values)
+    {
+        n += s.size();
+    }
+    return n;
+}
+
+long long TotalLengthPmr(const std::pmr::vector<std::pmr::string>& values)
+{
+    long long n = 0;
+    for (const auto& s : values)
+    {
+        n += s.size();
+    }
+    return n;
+}
+
+void ScratchArenaBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    s.AddFunction("Ingest", CFunction<TotalLength, vector<string>>::Function)
+        .AddFunction("IngestPmr", CFunction<TotalLengthPmr, pmr::vector<pmr::string>>::Function);
+    s.Run(R"(
+        records = {}
+        for i = 1, 1000 do
+            records[i] = "sensor record with a payload longer than SSO #" .. i
+        end
+    )");
+
+    const int n = 2000;
+
+    double start = GetSystemTime();
+    s.Run("for i = 1, " + to_string(n) + " do Ingest(records) end");
+    double heap_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    s.Run("for i = 1, " + to_string(n) + " do IngestPmr(records) end");
+    double arena_time = GetSystemTime() - start;
+
+    constexpr auto plain = +[](int x) { return x + 1; };
+    constexpr auto scoped = +[](ScratchArena*, int x) { return x + 1; };
+    s.AddFunction("Plain", CFunction<plain, int>::Function)
+        .AddFunction("Scoped", CFunction<scoped, ScratchArena*, int>::Function);
+
+    const int calls = 1000000;
+
+    start = GetSystemTime();
+    s.Run("local x = 0 for i = 1, " + to_string(calls) + " do x = Plain(x) end");
+    double plain_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    s.Run("local x = 0 for i = 1, " + to_string(calls) + " do x = Scoped(x) end");
+    double scoped_time = GetSystemTime() - start;
+
+    cout << "vector<string>: " << heap_time << "s" << endl;
+    cout << "pmr::vector<pmr::string> in ScratchArena: " << arena_time << "s" << endl;
+    cout << "call without ScratchArena: " << plain_time << "s" << endl;
+    cout << "call with ScratchArena: " << scoped_time << "s" << endl;
+}
+
+template<int Tag>
+struct WideObject
+{
+    float values[20] = {};
+
+    template<int I>
+    float Get()const
+    {
+        return values[I];
+    }
+
+    template<int I>
+    static int GetField(lua_State* l)
+    {
+        LTL::PushValue(l, LTL::UserData<WideObject>::ValidateUserData(l, 1)->values[I]);
+        return 1;
+    }
+
+    template<size_t ...Is>
+    static void Register(LTL::Class<WideObject>& c, std::index_sequence<Is...>)
+    {
+        (c.AddGetter(("f" + std::to_string(Is)).c_str(), GetField<Is>), ...);
+        (c.Add(("m" + std::to_string(Is)).c_str(), LTL::Method<&WideObject::Get<Is>>{}), ...);
+    }
+};
+
+void FrozenIndexBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    {
+        Class<WideObject<0>> plain(s, "Plain");
+        plain.AddConstructor<>();
+        WideObject<0>::Register(plain, make_index_sequence<20>{});
+    }
+    {
+        Class<WideObject<1>> frozen(s, "Frozen");
+        frozen.AddConstructor<>();
+        WideObject<1>::Register(frozen, make_index_sequence<20>{});
+        frozen.Finalize();
+    }
+    s.Run(R"(
+        function Access(o, n)
+            local sum = 0
+            for i = 1, n do
+                sum = sum + o.f3 + o.f17 + o:m5() + o:m19()
+            end
+            return sum
+        end
+    )");
+
+    const int n = 1000000;
+
+    double start = GetSystemTime();
+    s.Run("Access(Plain(), " + to_string(n) + ")");
+    double plain_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    s.Run("Access(Frozen(), " + to_string(n) + ")");
+    double frozen_time = GetSystemTime() - start;
+
+    cout << "Two-table __index: " << plain_time << "s" << endl;
+    cout << "Finalized __index: " << frozen_time << "s" << endl;
+}
+
+struct Blob
+{
+    std::vector<char> bytes;
+
+    Blob() :bytes(1024 * 1024, 'x') {}
+
+    int Size()const noexcept
+    {
+        return static_cast<int>(bytes.size());
+    }
+};
+
+Blob MakeBlob()
+{
+    return {};
+}
+
+const Blob& MakeBlobRef()
+{
+    static Blob blob;
+    blob = Blob{};
+    return blob;
+}
+
+void MoveResultBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    Class<Blob>(s, "Blob")
+        .Add("Size", Method<&Blob::Size>{});
+    s.AddFunction("MakeBlob", CFunction<MakeBlob, UserData<Blob>()>::Function)
+        .AddFunction("MakeBlobRef", CFunction<MakeBlobRef, UserData<Blob>()>::Function);
+    s.Run(R"(
+        function Fetch(f, n)
+            local size = 0
+            for i = 1, n do
+                size = size + f():Size()
+                if i % 64 == 0 then
+                    collectgarbage()
+                end
+            end
+            return size
+        end
+    )");
+
+    const int n = 2000;
+
+    double start = GetSystemTime();
+    s.Run("Fetch(MakeBlobRef, " + to_string(n) + ")");
+    double copy_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    s.Run("Fetch(MakeBlob, " + to_string(n) + ")");
+    double move_time = GetSystemTime() - start;
+
+    cout << "1 MB result returned by reference and copied: " << copy_time << "s" << endl;
+    cout << "1 MB temporary result moved: " << move_time << "s" << endl;
+}
+
+struct PackedVector
+{
+    float x = 0, y = 0, z = 0, w = 0;
+};
+
+void UserDataLayoutBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    Class<PackedVector>(s, "Vector")
+        .AddConstructor<>()
+        .Add("x", AProperty<&PackedVector::x>{});
+
+    lua_State* l = s.GetState()->Unwrap();
+    const auto memory = [l]()
+        {
+            lua_gc(l, LUA_GCCOLLECT);
+            return static_cast<double>(lua_gc(l, LUA_GCCOUNT)) * 1024 + lua_gc(l, LUA_GCCOUNTB);
+        };
+
+    const int n = 1000000;
+    lua_createtable(l, n, 0);
+    const double before = memory();
+
+    double start = GetSystemTime();
+    for (int i = 1; i <= n; i++)
+    {
+        UserData<PackedVector>::New(l);
+        lua_rawseti(l, -2, i);
+    }
+    double create_time = GetSystemTime() - start;
+    const double after = memory();
+    lua_pop(l, 1);
+
+    cout << "Payload: " << sizeof(PackedVector) << " bytes, userdata block: " << Internal::UserDataLayout<PackedVector>::Size << " bytes" << endl;
+    cout << "Memory per object (with Lua header): " << (after - before) / n << " bytes" << endl;
+    cout << "Creation of " << n << " objects: " << create_time << "s" << endl;
+}
+
+void OperatorsBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    const string script = R"(
+        local v = Vector(0, 0, 0)
+        local d = Vector(1, 2, 3)
+        for i = 1, 1000000 do
+            v = v + d
+        end
+    )";
+
+    double manual_time = 0;
+    {
+        State s;
+        s.OpenLibs();
+        Class<Vector3f>(s, "Vector")
+            .AddConstructor<Default<float>, Default<float>, Default<float>>()
+            .Add("__add", Method<&Vector3f::operator+, Vector3f(Vector3f)>{});
+        double start = GetSystemTime();
+        s.Run(script);
+        manual_time = GetSystemTime() - start;
+    }
+
+    double operators_time = 0;
+    {
+        State s;
+        s.OpenLibs();
+        Class<Vector3f>(s, "Vector")
+            .AddConstructor<Default<float>, Default<float>, Default<float>>()
+            .AddOperators();
+        double start = GetSystemTime();
+        s.Run(script);
+        operators_time = GetSystemTime() - start;
+    }
+
+    cout << "Hand-registered __add: " << manual_time << "s" << endl;
+    cout << "AddOperators __add: " << operators_time << "s" << endl;
+}
+
+void InPlaceMathBenchmark()
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.OpenLibs();
+    Class<Vector3f>(s, "Vector")
+        .AddConstructor<Default<float>, Default<float>, Default<float>>()
+        .Add("add_to", MethodInto<&Vector3f::operator+, Vector3f>{})
+        .AddOperators()
+        .AddScratchPool("TempVector", "Release");
+    s.Run(R"(
+        function Allocating(n)
+            local p = Vector(0, 0, 0)
+            local v = Vector(0.5, 0.25, 0.125)
+            for i = 1, n do
+                p = p + v
+            end
+            return p
+        end
+
+        function InPlace(n)
+            local p = TempVector()
+            local v = Vector(0.5, 0.25, 0.125)
+            for i = 1, n do
+                p:add_to(p, v)
+            end
+            p:Release()
+        end
+    )");
+
+    const int n = 1000000;
+
+    double start = GetSystemTime();
+    s.Run("Allocating(" + to_string(n) + ")");
+    double allocating_time = GetSystemTime() - start;
+
+    start = GetSystemTime();
+    s.Run("InPlace(" + to_string(n) + ")");
+    double in_place_time = GetSystemTime() - start;
+
+    cout << "p = p + v: " << allocating_time << "s" << endl;
+    cout << "p:add_to(p, v): " << in_place_time << "s" << endl;
+}
+
 int main()
 {
     //ClassTest();
@@ -1124,5 +2052,21 @@ int main()
     //AltException();
     //LibsTest();
    // OnlyMethods();
+    //SerializationBenchmark();
+    //JsonBenchmark();
+    //ReflectionBenchmark();
+    //KeyBenchmark();
+    //FunctionHandleBenchmark();
+    //LuaFunctionBenchmark();
+    //CallBatchBenchmark();
+    //CollectionsBenchmark();
+    //NumericVectorBenchmark();
+    //AssociativeBenchmark();
+    //ScratchArenaBenchmark();
+    //FrozenIndexBenchmark();
+    //MoveResultBenchmark();
+    //UserDataLayoutBenchmark();
+    //OperatorsBenchmark();
+    //InPlaceMathBenchmark();
     MetatableTest();
 }
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "TestBase.hpp"
+
+struct CollectionsTests : TestBase
+{
+    void SetUp() override
+    {
+        TestBase::SetUp();
+        luaL_requiref(l, "collections", LTL::Internal::OpenCollectionsLib, 1);
+        lua_pop(l, 1);
+    }
+};
+
+TEST_F(CollectionsTests, Buffer)
+{
+    using namespace LTL;
+
+    Run(R"(
+        local b = collections.buffer(3, 1.5)
+        b[2] = 4
+        b[#b + 1] = 8
+        local copy = collections.buffer({ 1, 2, 3 })
+        local t = collections.totable(b)
+        result = #b == 4 and b[1] == 1.5 and b[2] == 4 and b[4] == 8 and b[5] == nil
+            and #copy == 3 and copy[3] == 3 and #t == 4 and t[4] == 8
+            and not pcall(function() b[7] = 1 end)
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+
+    lua_getglobal(l, "collections");
+    lua_getfield(l, -1, "buffer");
+    lua_pushinteger(l, 5);
+    lua_call(l, 1, 1);
+    ASSERT_TRUE(StackType<NumberBuffer*>::Check(l, -1));
+    NumberBuffer* buffer = StackType<NumberBuffer*>::Get(l, -1);
+    ASSERT_EQ(buffer->Size(), 5u);
+    lua_pop(l, 2);
+    ASSERT_EQ(Top(), 0);
+}
+
+TEST_F(CollectionsTests, BuiltinOperators)
+{
+    using namespace LTL;
+
+    Run(R"(
+        local t = { 1, 4, 9, 16, 25 }
+        local b = collections.buffer(t)
+        local roots = collections.map(t, "sqrt")
+        local scaled = collections.map(b, "mul", 2)
+        local big = collections.filter(b, "gt", 5)
+        local small = collections.filter(t, "le", 4)
+        result = type(roots) == "table" and roots[3] == 3 and roots[5] == 5
+            and getmetatable(scaled) ~= nil and scaled[5] == 50
+            and #big == 3 and big[1] == 9
+            and type(small) == "table" and #small == 2 and small[2] == 4
+            and collections.sum(t) == 55 and collections.sum(b) == 55
+            and collections.reduce(t, "add", 5) == 60
+            and collections.reduce(b, "mul") == 1 * 4 * 9 * 16 * 25
+            and collections.reduce(t, "min") == 1 and collections.reduce(b, "max") == 25
+            and collections.dot(t, b) == 1 + 16 + 81 + 256 + 625
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+
+    ASSERT_THROW(Run("collections.sum({ 1, 'x' })"), Exception);
+    ASSERT_THROW(Run("collections.map({ 1 }, 'unknown')"), Exception);
+    ASSERT_THROW(Run("collections.dot({ 1, 2 }, { 1 })"), Exception);
+}
+
+TEST_F(CollectionsTests, ReduceWithoutInit)
+{
+    using namespace LTL;
+
+    // таблица копируется во временный буфер на стеке, init не должен читаться из его слота
+    Run(R"(
+        local t = { 3, 1, 4, 2 }
+        result = collections.reduce(t, "add") == 10
+            and collections.reduce(t, "mul") == 24
+            and collections.reduce(t, "min") == 1
+            and collections.reduce(t, "max") == 4
+            and collections.reduce({}, "add") == 0
+            and collections.reduce(t, "min", 0) == 0
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+
+    ASSERT_THROW(Run("collections.reduce({ 1 }, 'add', 'x')"), Exception);
+}
+
+TEST_F(CollectionsTests, MissingArguments)
+{
+    using namespace LTL;
+
+    // временная копия первой таблицы не должна подменять отсутствующий аргумент
+    ASSERT_THROW(Run("collections.dot({ 1, 2, 3 })"), Exception);
+    ASSERT_THROW(Run("collections.axpy(2, { 1, 2 })"), Exception);
+    ASSERT_THROW(Run("collections.axpy(2, collections.buffer({ 1, 2 }))"), Exception);
+
+    Run(R"(
+        local ok, err = pcall(collections.dot, { 1, 2, 3 })
+        result = not ok and err:find("#2") ~= nil
+            and collections.dot({ 1, 2, 3 }, { 1, 2, 3 }) == 14
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+    ASSERT_EQ(Top(), 0);
+}
+
+TEST_F(CollectionsTests, Axpy)
+{
+    using namespace LTL;
+
+    Run(R"(
+        local x = collections.buffer({ 1, 2, 3 })
+        local y = collections.buffer({ 10, 20, 30 })
+        local t = { 1, 1, 1 }
+        local same = collections.axpy(2, x, y) == y
+        collections.axpy(-1, { 1, 2, 3 }, t)
+        result = same and y[1] == 12 and y[3] == 36 and t[1] == 0 and t[3] == -2
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+}
+
+TEST_F(CollectionsTests, Callbacks)
+{
+    using namespace LTL;
+
+    Run(R"(
+        local names = collections.map({ "a", "b" }, function(s, i) return s .. i end)
+        local odd = collections.filter(collections.buffer({ 1, 2, 3, 4, 5 }), function(x) return x % 2 == 1 end)
+        local words = collections.filter({ "x", "yy", "zzz" }, function(s) return #s > 1 end)
+        local joined = collections.reduce({ "a", "b", "c" }, function(acc, s) return acc .. s end)
+        local total = collections.reduce(collections.buffer({ 1, 2, 3 }), function(acc, x) return acc + x end, 10)
+        result = names[1] == "a1" and names[2] == "b2"
+            and #odd == 3 and odd[3] == 5
+            and #words == 2 and words[1] == "yy"
+            and joined == "abc" and total == 16
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+
+    ASSERT_THROW(Run("collections.map(collections.buffer(2), function() return 'x' end)"), Exception);
+    ASSERT_THROW(Run("collections.reduce({}, function(a, b) return a end)"), Exception);
+    ASSERT_EQ(Top(), 0);
+}
+
+TEST_F(CollectionsTests, NumberView)
+{
+    using namespace LTL;
+
+    constexpr auto scale = +[](NumberView<lua_Number> values, double factor)
+        {
+            for (lua_Number& x : values)
+            {
+                x *= factor;
+            }
+        };
+    constexpr auto total = +[](NumberView<const lua_Number, 3> values)
+        {
+            return values[0] + values[1] + values[2];
+        };
+    RegisterFunction(l, "Scale", CFunction<scale, NumberView<lua_Number>, double>::Function);
+    RegisterFunction(l, "Total", CFunction<total, NumberView<const lua_Number, 3>>::Function);
+
+    Run(R"(
+        local b = collections.buffer({ 1, 2, 3 })
+        Scale(b, 2)
+        result = b[3] == 6 and Total(b) == 12
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+    ASSERT_THROW(Run("Total(collections.buffer(4))"), Exception);
+    ASSERT_THROW(Run("Scale({ 1, 2 }, 2)"), Exception);
+
+    lua_settop(l, 0);
+    lua_Number values[] = { 1, 2 };
+    PushValue(l, NumberView<lua_Number>{ values, 2 });
+    ASSERT_TRUE(lua_istable(l, -1));
+    ASSERT_EQ(lua_rawlen(l, -1), 2u);
+    lua_pop(l, 1);
+}
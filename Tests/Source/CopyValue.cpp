@@ -0,0 +1,149 @@
+#include "TestBase.hpp"
+
+struct CopyValueTests : TestBase
+{
+
+};
+
+TEST_F(CopyValueTests, Values)
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.ThrowExceptions();
+    lua_State* other = s.GetState()->Unwrap();
+
+    Run(R"(
+        local shared = { 1, 2, 3 }
+        value = { 10, 20, "x", a = shared, b = shared, c = { d = true, e = 0.25 }, f = print }
+    )");
+
+    lua_getglobal(l, "value");
+    StackObjectView copy = CopyValue(StackObjectView{ l }, other);
+    lua_pop(l, 1);
+    ASSERT_EQ(Top(), 0);
+    ASSERT_EQ(lua_gettop(other), 1);
+    ASSERT_EQ(copy.GetState(), other);
+    lua_setglobal(other, "value");
+
+    auto value = s.GetGlobal("value");
+    ASSERT_EQ(value[1].To<int>(), 10);
+    ASSERT_EQ(value[3].To<string>(), "x");
+    ASSERT_EQ(value["a"][3].To<int>(), 3);
+    ASSERT_TRUE(value["c"]["d"].To<bool>());
+    ASSERT_EQ(value["c"]["e"].To<double>(), 0.25);
+    ASSERT_TRUE(value["f"].Is<lua_CFunction>());
+    ASSERT_FALSE(value["a"] == value["b"]);
+}
+
+TEST_F(CopyValueTests, Shared)
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.ThrowExceptions();
+    s.OpenLibs();
+    lua_State* other = s.GetState()->Unwrap();
+
+    Run(R"(
+        local shared = { 1, 2, 3 }
+        value = { a = shared, b = shared }
+        value.self = value
+    )");
+
+    lua_getglobal(l, "value");
+    ASSERT_THROW(CopyValue(StackObjectView{ l }, other), Exception);
+    ASSERT_EQ(Top(), 1);
+
+    CopyValueShared(StackObjectView{ l }, other);
+    lua_pop(l, 1);
+    ASSERT_EQ(lua_gettop(other), 1);
+    lua_setglobal(other, "value");
+
+    s.Run("result = value.a == value.b and value.self == value and value.a[2] == 2");
+    ASSERT_TRUE(s.GetGlobal("result").To<bool>());
+}
+
+TEST_F(CopyValueTests, Depth)
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.ThrowExceptions();
+    lua_State* other = s.GetState()->Unwrap();
+
+    Run(R"(
+        deep = {}
+        local t = deep
+        for i = 1, 100000 do
+            t[1] = {}
+            t = t[1]
+        end
+        shallow = { { { 1 } } }
+    )");
+
+    lua_getglobal(l, "deep");
+    ASSERT_THROW(CopyValue(StackObjectView{ l }, other), Exception);
+    ASSERT_THROW(CopyValueShared(StackObjectView{ l }, other), Exception);
+    lua_pop(l, 1);
+    ASSERT_EQ(lua_gettop(other), 0);
+
+    lua_getglobal(l, "shallow");
+    CopyValue(StackObjectView{ l }, other);
+    lua_pop(l, 1);
+    ASSERT_EQ(lua_rawlen(other, -1), 1u);
+    lua_pop(other, 1);
+    ASSERT_EQ(Top(), 0);
+}
+
+TEST_F(CopyValueTests, UserData)
+{
+    using namespace LTL;
+    using namespace std;
+
+    struct Point
+    {
+        int x = 0;
+        Point(int x) :x(x) {}
+    };
+
+    State s;
+    s.ThrowExceptions();
+    lua_State* other = s.GetState()->Unwrap();
+
+    Class<Point>(l, "Point").AddConstructor<int>().Add("x", AProperty<&Point::x>{});
+    Class<Point>(s, "Point").AddConstructor<int>().Add("x", AProperty<&Point::x>{});
+
+    Run("value = { p = Point(4) }");
+    lua_getglobal(l, "value");
+    ASSERT_THROW(CopyValue(StackObjectView{ l }, other), Exception);
+
+    CopyValue<CopyUserData<Point>>(StackObjectView{ l }, other);
+    lua_pop(l, 1);
+    lua_setglobal(other, "value");
+
+    s.Run("result = value.p.x");
+    ASSERT_EQ(s.GetGlobal("result").To<int>(), 4);
+    Run("value.p.x = 5");
+    ASSERT_EQ(s.GetGlobal("result").To<int>(), 4);
+    s.Run("result = value.p.x");
+    ASSERT_EQ(s.GetGlobal("result").To<int>(), 4);
+}
+
+TEST_F(CopyValueTests, SameState)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Run("value = { 1, { 2, { 3 } }, k = { v = 'v' } }");
+    lua_getglobal(l, "value");
+    CopyValue(StackObjectView{ l }, l);
+    lua_setglobal(l, "copy");
+    lua_pop(l, 1);
+
+    Run("result = copy ~= value and copy[2][2][1] == 3 and copy.k.v == 'v'");
+    ASSERT_TRUE(Result().To<bool>());
+}
@@ -0,0 +1,81 @@
+#include "TestBase.hpp"
+
+struct FunctionHandleTests : TestBase
+{
+
+};
+
+TEST_F(FunctionHandleTests, Global)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Run("function Handler(a, b) return a + b end");
+
+    FunctionHandle handle{ l, "Handler" };
+    FunctionHandle tracked{ l, "Handler", true };
+    ASSERT_FALSE(handle.IsTracked());
+    ASSERT_TRUE(tracked.IsTracked());
+    ASSERT_EQ(Top(), 0);
+
+    ASSERT_EQ(handle.Call<int>(1, 2), 3);
+    ASSERT_EQ(tracked.PCall<int>(3, 4).result.value(), 7);
+
+    // версии ведутся вручную: без Touch обе ссылки вызывают прежнюю функцию
+    Run("function Handler(a, b) return a * b end");
+    ASSERT_EQ(handle.Call<int>(2, 5), 7);
+    ASSERT_EQ(tracked.Call<int>(2, 5), 7);
+
+    lua_pushglobaltable(l);
+    TableVersion::Touch(l, -1);
+    lua_pop(l, 1);
+    ASSERT_EQ(handle.Call<int>(2, 5), 7);
+    ASSERT_EQ(tracked.Call<int>(2, 5), 10);
+
+    handle.Resolve();
+    ASSERT_EQ(handle.Call<int>(3, 5), 15);
+    ASSERT_EQ(Top(), 0);
+}
+
+TEST_F(FunctionHandleTests, TouchFromLua)
+{
+    using namespace LTL;
+    using namespace std;
+
+    RegisterFunction(l, "touch", TableVersion::TouchFunction);
+    Run(R"(
+        handlers = { OnEvent = function() return 1 end }
+    )");
+
+    StackObjectView handlers = StackObjectView::Global(l, "handlers");
+    FunctionHandle handle{ handlers, "OnEvent", true };
+    lua_pop(l, 1);
+
+    ASSERT_EQ(handle.Call<int>(), 1);
+    Run("handlers.OnEvent = function() return 2 end");
+    ASSERT_EQ(handle.Call<int>(), 1);
+    Run("touch(handlers)");
+    ASSERT_EQ(handle.Call<int>(), 2);
+    ASSERT_EQ(Top(), 0);
+}
+
+TEST_F(FunctionHandleTests, BoundMethod)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Run(R"(
+        result = { value = 1 }
+        function result:Add(n)
+            self.value = self.value + n
+            return self.value
+        end
+    )");
+
+    BoundMethod add{ Result(), "Add" };
+    ASSERT_EQ(Top(), 0);
+    ASSERT_EQ(add.Call<int>(2), 3);
+    ASSERT_EQ(add.PCall<int>(3).result.value(), 6);
+    ASSERT_EQ(Result()["value"].To<int>(), 6);
+    ASSERT_EQ(Top(), 0);
+}
@@ -0,0 +1,92 @@
+#include "TestBase.hpp"
+
+struct JsonTests : TestBase
+{
+
+};
+
+TEST_F(JsonTests, Encode)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Run(R"(
+        array = { 1, 2.5, "three", true, false }
+        object = { key = "va\"l\nue" }
+        nested = { list = { 1.0, { x = -7 } } }
+        empty = {}
+        text = "\1tab\t\\"
+    )");
+
+    ASSERT_EQ(Json::Encode(GRefObject::Global(l, "array")), R"([1,2.5,"three",true,false])");
+    ASSERT_EQ(Json::Encode(GRefObject::Global(l, "object")), R"({"key":"va\"l\nue"})");
+    ASSERT_EQ(Json::Encode(GRefObject::Global(l, "nested")), R"({"list":[1.0,{"x":-7}]})");
+    ASSERT_EQ(Json::Encode(GRefObject::Global(l, "empty")), "{}");
+    ASSERT_EQ(Json::Encode(GRefObject::Global(l, "text")), R"("\u0001tab\t\\")");
+
+    string buffer = "prefix:";
+    lua_pushinteger(l, 42);
+    Json::Encode(StackObjectView{ l }, buffer);
+    lua_pop(l, 1);
+    ASSERT_EQ(buffer, "prefix:42");
+    ASSERT_EQ(Top(), 0);
+
+    Run("cycle = {} cycle.self = cycle");
+    ASSERT_THROW(Json::Encode(GRefObject::Global(l, "cycle")), Exception);
+    Run("bad = { [2.5] = 1 }");
+    ASSERT_THROW(Json::Encode(GRefObject::Global(l, "bad")), Exception);
+    Run("bad = { f = print }");
+    ASSERT_THROW(Json::Encode(GRefObject::Global(l, "bad")), Exception);
+}
+
+TEST_F(JsonTests, Decode)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Json::Decode(l, R"( {"a": [1, 2.5, -3e2, "x\u00e9\ud83d\ude00", null], "b": {"c": true}, "d": "plain"} )");
+    lua_setglobal(l, "result");
+    ASSERT_EQ(Top(), 0);
+
+    Run(R"(
+        result = result.a[1] == 1 and math.type(result.a[1]) == "integer"
+            and result.a[2] == 2.5 and result.a[3] == -300.0
+            and result.a[4] == "x\u{e9}\u{1F600}"
+            and result.a[5] ~= nil and #result.a == 5
+            and result.b.c == true and result.d == "plain"
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+
+    ASSERT_THROW(Json::Decode(l, "[1, 2"), Exception);
+    ASSERT_THROW(Json::Decode(l, "{\"a\" 1}"), Exception);
+    ASSERT_THROW(Json::Decode(l, "\"\\ud800\""), Exception);
+    ASSERT_THROW(Json::Decode(l, "01"), Exception);
+    ASSERT_THROW(Json::Decode(l, "[] []"), Exception);
+    ASSERT_EQ(Top(), 0);
+
+    Json::Decode(l, "123456789012345678901234567890");
+    ASSERT_FALSE(lua_isinteger(l, -1));
+    lua_pop(l, 1);
+}
+
+TEST_F(JsonTests, Lib)
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.ThrowExceptions();
+    s.OpenLibs(Libs::base, Libs::math, Libs::json);
+
+    s.Run(R"(
+        local value = { name = "point", coords = { 1, 2, 3 }, nothing = json.null, scale = 0.5 }
+        local copy = json.decode(json.encode(value))
+        result = copy.name == "point" and copy.coords[3] == 3 and copy.nothing == json.null
+            and copy.scale == 0.5 and math.type(copy.coords[1]) == "integer"
+
+        local ok, err = pcall(json.decode, "[1,]")
+        error_message = err
+    )");
+    ASSERT_TRUE(s.GetGlobal("result").To<bool>());
+    ASSERT_EQ(s.GetGlobal("error_message").To<string>(), "unexpected character at position 4");
+}
@@ -0,0 +1,83 @@
+#include "TestBase.hpp"
+
+struct KeyTests : TestBase
+{
+
+};
+
+TEST_F(KeyTests, GetSet)
+{
+    using namespace LTL;
+    using namespace std;
+
+    const Key x{ l, "x" };
+    const Key name{ l, "name" };
+    ASSERT_EQ(x.Name(), "x");
+
+    Run("result = { x = 4, name = 'point' }");
+
+    StackObjectView table = StackObjectView::Global(l, "result");
+    ASSERT_EQ(table.Get<int>(x), 4);
+    ASSERT_EQ(table.RawGet<string>(name), "point");
+    table.Set(x, 5);
+    table.RawSet(name, "vector");
+    lua_pop(l, 1);
+    ASSERT_EQ(Top(), 0);
+
+    auto obj = Result();
+    ASSERT_EQ(obj[x].To<int>(), 5);
+    ASSERT_EQ(obj[name].To<string>(), "vector");
+    obj[x] = 10;
+    ASSERT_EQ(obj["x"].To<int>(), 10);
+    ASSERT_EQ(Top(), 0);
+}
+
+TEST_F(KeyTests, SelfCall)
+{
+    using namespace LTL;
+    using namespace std;
+
+    const Key add{ l, "Add" };
+    Run(R"(
+        result = { value = 1 }
+        function result:Add(n)
+            self.value = self.value + n
+            return self.value
+        end
+    )");
+
+    auto obj = Result();
+    ASSERT_EQ(obj.SelfCall<int>(add, 2), 3);
+    ASSERT_EQ(obj.SelfPCall<int>(add, 3).result.value(), 6);
+
+    StackObjectView table = StackObjectView::Global(l, "result");
+    ASSERT_EQ(table.SelfCall<int>(add, 4), 10);
+    ASSERT_TRUE(table.SelfPCall<int>(add, 5).IsOk());
+    lua_pop(l, 1);
+    ASSERT_EQ(Top(), 0);
+}
+
+TEST_F(KeyTests, Copy)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Key a{ l, "key" };
+    Key b = a;
+    Key c;
+    ASSERT_FALSE(c.IsValid());
+    c = b;
+    Key d = std::move(a);
+    ASSERT_FALSE(a.IsValid());
+    ASSERT_TRUE(d.IsValid());
+
+    ASSERT_EQ(b.Name(), "key");
+    ASSERT_EQ(c.Name(), "key");
+    ASSERT_EQ(d.Name(), "key");
+
+    lua_State* thread = lua_newthread(l);
+    PushValue(thread, d);
+    ASSERT_EQ(GetValue<string>(thread, -1), "key");
+    lua_pop(l, 1);
+    ASSERT_EQ(Top(), 0);
+}
@@ -0,0 +1,120 @@
+#include "TestBase.hpp"
+
+struct LuaFunctionTests : TestBase
+{
+
+};
+
+TEST_F(LuaFunctionTests, Call)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Run(R"(
+        function Add(a, b) return a + b end
+        function Concat(a, b) return a .. b end
+        function Fail() error("failed") end
+    )");
+
+    LuaFunction<int(int, int)> add{ GRefObject::Global(l, "Add") };
+    LuaFunction<string(const char*, string)> concat{ GRefObject::Global(l, "Concat") };
+    LuaFunction<void()> fail{ GRefObject::Global(l, "Fail") };
+    LuaFunction<int(int, int)> wrong{ GRefObject::Global(l, "Concat") };
+
+    ASSERT_EQ(add(1, 2), 3);
+    ASSERT_EQ(concat("a", "b"), "ab");
+    ASSERT_EQ(Top(), 0);
+
+    auto sum = add.PCall(3, 4);
+    ASSERT_TRUE(sum.IsOk());
+    ASSERT_EQ(sum.result.value(), 7);
+
+    auto failed = fail.PCall();
+    ASSERT_FALSE(failed.IsOk());
+    ASSERT_EQ(failed.status, PCallResult::ERRRUN);
+    ASSERT_NE(failed.error.find("failed"), string::npos);
+    ASSERT_EQ(Top(), 0);
+
+    auto mismatch = wrong.PCall(1, 2);
+    ASSERT_FALSE(mismatch.IsOk());
+    ASSERT_FALSE(mismatch.result.has_value());
+    ASSERT_EQ(Top(), 0);
+
+    auto copy = add;
+    ASSERT_EQ(copy(5, 5), 10);
+}
+
+TEST_F(LuaFunctionTests, Argument)
+{
+    using namespace LTL;
+    using namespace std;
+
+    static LuaFunction<int(int)> stored;
+
+    constexpr auto subscribe = +[](LuaFunction<int(int)> callback) -> int
+        {
+            stored = callback;
+            return callback(1);
+        };
+
+    RegisterFunction(l, "Subscribe", CFunction<subscribe, LuaFunction<int(int)>>::Function);
+
+    Run(R"(
+        local offset = 10
+        result = Subscribe(function(x) return x + offset end)
+    )");
+    ASSERT_EQ(Result().To<int>(), 11);
+    ASSERT_EQ(stored(5), 15);
+
+    Run(R"(
+        local co = coroutine.create(function()
+            return Subscribe(function(x) return x * 2 end)
+        end)
+        local _, value = coroutine.resume(co)
+        result = value
+    )");
+    ASSERT_EQ(Result().To<int>(), 2);
+    ASSERT_EQ(stored(21), 42);
+    ASSERT_EQ(Top(), 0);
+
+    stored = {};
+}
+
+TEST_F(LuaFunctionTests, CallInCoroutine)
+{
+    using namespace LTL;
+    using namespace std;
+
+    constexpr auto invoke = +[](CState* s, LuaFunction<int(int)> callback) -> int
+        {
+            return callback.Call(s->Unwrap(), 1);
+        };
+
+    constexpr auto protect = +[](CState* s, LuaFunction<int(int)> callback) -> bool
+        {
+            return callback.PCall(s->Unwrap(), 1).IsOk();
+        };
+
+    RegisterFunction(l, "Invoke", CFunction<invoke, CState*, LuaFunction<int(int)>>::Function);
+    RegisterFunction(l, "Protect", CFunction<protect, CState*, LuaFunction<int(int)>>::Function);
+
+    Run(R"(
+        local co = coroutine.create(function()
+            coroutine.yield(Invoke(function(x) return x + 1 end))
+            coroutine.yield(Protect(function(x) error("caught") end))
+            return Invoke(function(x) error("inner") end)
+        end)
+        local ok1, value = coroutine.resume(co)
+        local ok2, protected = coroutine.resume(co)
+        local ok3, message = coroutine.resume(co)
+        result = ok1 and value == 2
+            and ok2 and protected == false
+            and not ok3 and message:find("inner") ~= nil
+            and coroutine.status(co) == "dead"
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+
+    Run("result = Invoke(function(x) return x * 3 end)");
+    ASSERT_EQ(Result().To<int>(), 3);
+    ASSERT_EQ(Top(), 0);
+}
@@ -0,0 +1,106 @@
+#include "TestBase.hpp"
+
+struct ReflectionTests : TestBase
+{
+
+};
+
+struct ReflectedSize
+{
+    int width = 0;
+    int height = 0;
+};
+
+struct ReflectedConfig
+{
+    std::string name;
+    double scale = 1;
+    bool enabled = false;
+    ReflectedSize size;
+    std::optional<int> limit;
+};
+
+template<>
+struct LTL::StructFields<ReflectedSize>
+{
+    static constexpr auto fields = std::make_tuple(
+        StructField<&ReflectedSize::width>{ "width" },
+        StructField<&ReflectedSize::height>{ "height" }
+    );
+};
+
+template<>
+struct LTL::StructFields<ReflectedConfig>
+{
+    static constexpr auto fields = std::make_tuple(
+        StructField<&ReflectedConfig::name>{ "name" },
+        StructField<&ReflectedConfig::scale>{ "scale" },
+        StructField<&ReflectedConfig::enabled>{ "enabled" },
+        StructField<&ReflectedConfig::size>{ "size" },
+        StructField<&ReflectedConfig::limit>{ "limit" }
+    );
+};
+
+TEST_F(ReflectionTests, Push)
+{
+    using namespace LTL;
+    using namespace std;
+
+    ReflectedConfig config{ "window", 2.5, true, { 640, 480 }, std::nullopt };
+    PushValue(l, config);
+    lua_setglobal(l, "config");
+    ASSERT_EQ(Top(), 0);
+
+    Run(R"(
+        result = config.name == "window" and config.scale == 2.5 and config.enabled
+            and config.size.width == 640 and config.size.height == 480 and config.limit == nil
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+}
+
+TEST_F(ReflectionTests, Get)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Run("result = { name = 'panel', scale = 0.5, enabled = false, size = { width = 10, height = 20 }, limit = 3 }");
+
+    lua_getglobal(l, "result");
+    ASSERT_TRUE(StackType<ReflectedConfig>::Check(l, -1));
+    ReflectedConfig config = GetValue<ReflectedConfig>(l, -1);
+    lua_pop(l, 1);
+    ASSERT_EQ(Top(), 0);
+
+    ASSERT_EQ(config.name, "panel");
+    ASSERT_EQ(config.scale, 0.5);
+    ASSERT_FALSE(config.enabled);
+    ASSERT_EQ(config.size.width, 10);
+    ASSERT_EQ(config.size.height, 20);
+    ASSERT_EQ(config.limit, 3);
+
+    Run("result = { name = 'panel', scale = 0.5, enabled = false, size = { width = 'wide', height = 20 } }");
+    lua_getglobal(l, "result");
+    ASSERT_FALSE(StackType<ReflectedConfig>::Check(l, -1));
+    lua_pop(l, 1);
+    ASSERT_EQ(Top(), 0);
+}
+
+TEST_F(ReflectionTests, Function)
+{
+    using namespace LTL;
+    using namespace std;
+
+    constexpr auto f = +[](ReflectedSize size, int by) -> ReflectedSize
+        {
+            size.width += by;
+            size.height += by;
+            return size;
+        };
+
+    RegisterFunction(l, "Grow", CFunction<f, ReflectedSize, int>::Function);
+
+    Run("result = Grow({ width = 1, height = 2 }, 10)");
+    auto size = Result().To<ReflectedSize>();
+    ASSERT_EQ(size.width, 11);
+    ASSERT_EQ(size.height, 12);
+}
@@ -1,4 +1,6 @@
 #include "TestBase.hpp"
+#include <algorithm>
+#include <cctype>
 
 struct STDContainersTests : TestBase
 {
@@ -22,6 +24,141 @@ TEST_F(STDContainersTests, VectorTests)
 
 }
 
+TEST_F(STDContainersTests, NumericVectorTests)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Run(R"(
+        floats = {}
+        ints = {}
+        for i = 1, 1000 do
+            floats[i] = i * 0.5
+            ints[i] = i - 500
+        end
+        ints[1000] = 2.0
+        big = { 1, 2, 2 ^ 40 }
+        fractional = { 1, 2.5 }
+        huge = { 1, 1e300 }
+        mixed = { 1, "2", "x" }
+    )");
+
+    {
+        StackTopRestorer rst{ l };
+        lua_getglobal(l, "floats");
+        auto v = GetValue<vector<float>>(l, -1);
+        ASSERT_EQ(v.size(), 1000u);
+        ASSERT_FLOAT_EQ(v[0], 0.5f);
+        ASSERT_FLOAT_EQ(v[999], 500.f);
+
+        lua_getglobal(l, "ints");
+        auto i32 = GetValue<vector<int>>(l, -1);
+        ASSERT_EQ(i32.size(), 1000u);
+        ASSERT_EQ(i32[0], -499);
+        ASSERT_EQ(i32[999], 2);
+
+        auto d = GetValue<vector<double>>(l, -2);
+        PushValue(l, d);
+        ASSERT_EQ(GetValue<vector<double>>(l, -1), d);
+    }
+
+    {
+        StackTopRestorer rst{ l };
+        lua_getglobal(l, "big");
+        ASSERT_EQ(GetValue<vector<long long>>(l, -1)[2], 1ll << 40);
+        ASSERT_THROW(GetValue<vector<int>>(l, -1), Exception);
+    }
+
+    {
+        StackTopRestorer rst{ l };
+        lua_getglobal(l, "ints");
+        ASSERT_THROW(GetValue<vector<unsigned int>>(l, -1), Exception);
+    }
+
+    {
+        StackTopRestorer rst{ l };
+        lua_getglobal(l, "fractional");
+        ASSERT_THROW(GetValue<vector<int>>(l, -1), Exception);
+        ASSERT_EQ(GetValue<vector<float>>(l, -1)[1], 2.5f);
+    }
+
+    {
+        StackTopRestorer rst{ l };
+        lua_getglobal(l, "huge");
+        ASSERT_THROW(GetValue<vector<float>>(l, -1), Exception);
+        ASSERT_EQ(GetValue<vector<double>>(l, -1)[1], 1e300);
+    }
+
+    {
+        StackTopRestorer rst{ l };
+        lua_getglobal(l, "mixed");
+        ASSERT_THROW(GetValue<vector<short>>(l, -1), Exception);
+    }
+}
+
+TEST_F(STDContainersTests, ArrayTests)
+{
+    using namespace LTL;
+    using namespace std;
+
+    {
+        StackTopRestorer rst{ l };
+        array<float, 3> v1 = { 1.f, 2.5f, -3.f };
+        PushValue(l, v1);
+        ASSERT_EQ(lua_rawlen(l, -1), 3u);
+        ASSERT_TRUE((StackType<array<float, 3>>::Check(l, -1)));
+        ASSERT_FALSE((StackType<array<float, 4>>::Check(l, -1)));
+        ASSERT_EQ((GetValue<array<float, 3>>(l, -1)), v1);
+        ASSERT_THROW((GetValue<array<float, 2>>(l, -1)), Exception);
+    }
+
+    {
+        StackTopRestorer rst{ l };
+        array<string, 2> v1 = { "a", "bc" };
+        PushValue(l, v1);
+        ASSERT_EQ((GetValue<array<string, 2>>(l, -1)), v1);
+    }
+
+    constexpr auto cross = +[](array<float, 3> a, array<float, 3> b)->array<float, 3>
+        {
+            return { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+        };
+    RegisterFunction(l, "Cross", CFunction<cross, array<float, 3>, array<float, 3>>::Function);
+    Run(R"(
+        local c = Cross({ 1, 0, 0 }, { 0, 1, 0 })
+        result = #c == 3 and c[1] == 0 and c[2] == 0 and c[3] == 1
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+    ASSERT_THROW(Run("Cross({ 1, 0 }, { 0, 1, 0 })"), Exception);
+}
+
+TEST_F(STDContainersTests, TupleTests)
+{
+    using namespace LTL;
+    using namespace std;
+
+    {
+        StackTopRestorer rst{ l };
+        pair<int, string> v1 = { 7, "seven" };
+        PushValue(l, v1);
+        ASSERT_EQ((GetValue<pair<int, string>>(l, -1)), v1);
+        ASSERT_TRUE((StackType<pair<int, string>>::Check(l, -1)));
+        ASSERT_FALSE((StackType<pair<string, int>>::Check(l, -1)));
+    }
+
+    {
+        StackTopRestorer rst{ l };
+        tuple<double, bool, string> v1 = { 0.5, true, "x" };
+        PushValue(l, v1);
+        ASSERT_EQ((GetValue<tuple<double, bool, string>>(l, -1)), v1);
+    }
+
+    Run("result = { 1, { 2, 3 } }");
+    auto nested = Result().To<pair<int, array<int, 2>>>();
+    ASSERT_EQ(nested.first, 1);
+    ASSERT_EQ(nested.second[1], 3);
+}
+
 TEST_F(STDContainersTests, UnorderedMapTests)
 {
     using namespace LTL;
@@ -74,6 +211,171 @@ TEST_F(STDContainersTests, UnorderedMapTests)
 }
 
 
+struct CaseInsensitiveHash
+{
+    size_t operator()(const std::string& s)const
+    {
+        size_t h = 0;
+        for (char c : s)
+        {
+            h = h * 31 + static_cast<size_t>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        return h;
+    }
+};
+
+struct CaseInsensitiveEqual
+{
+    bool operator()(const std::string& a, const std::string& b)const
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y)
+            {
+                return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+            });
+    }
+};
+
+struct SortedPairs
+{
+    std::vector<std::pair<std::string, int>> items;
+
+    auto begin()const { return items.begin(); }
+    auto end()const { return items.end(); }
+    size_t size()const { return items.size(); }
+};
+
+namespace LTL
+{
+    template<>
+    struct AssociativeTraits<SortedPairs>
+    {
+        using Key = std::string;
+        using Value = int;
+
+        static void Reserve(SortedPairs& container, size_t n)
+        {
+            container.items.reserve(n);
+        }
+
+        static void Insert(SortedPairs& container, Key&& key, Value&& value)
+        {
+            auto it = std::lower_bound(container.items.begin(), container.items.end(), key, [](const auto& item, const std::string& k) { return item.first < k; });
+            container.items.insert(it, { std::move(key), value });
+        }
+    };
+}
+
+TEST_F(STDContainersTests, TableSizeHint)
+{
+    using namespace LTL;
+
+    // целые ключи, записанные в обратном порядке, попадают в хеш-часть
+    Run(R"(
+        result = {}
+        for i = 10, 1, -1 do
+            result[i] = i
+        end
+        result.name = "x"
+    )");
+    Result().Push();
+    ASSERT_EQ(Internal::TableSizeHint(l, lua_gettop(l)), 11u);
+    lua_pop(l, 1);
+
+    Run(R"(
+        result = {}
+        for i = 1, 1000 do
+            result["k" .. i] = i
+            result[i] = i
+        end
+    )");
+    Result().Push();
+    ASSERT_EQ(Internal::TableSizeHint(l, lua_gettop(l)), 2000u);
+    lua_pop(l, 1);
+    ASSERT_EQ(Top(), 0);
+}
+
+TEST_F(STDContainersTests, MapTests)
+{
+    using namespace LTL;
+    using namespace std;
+
+    {
+        StackTopRestorer rst{ l };
+        using TestType = map<string, double>;
+        TestType v1 = { {"a", 1.5}, {"b", -2}, {"c", 3} };
+        PushValue(l, v1);
+        ASSERT_EQ(GetValue<TestType>(l, -1), v1);
+    }
+
+    {
+        StackTopRestorer rst{ l };
+        using TestType = map<int, string>;
+        TestType v1 = { {1, "one"}, {2, "two"}, {10, "ten"} };
+        PushValue(l, v1);
+        ASSERT_EQ(GetValue<TestType>(l, -1), v1);
+    }
+
+    {
+        StackTopRestorer rst{ l };
+        using TestType = unordered_map<string, int, CaseInsensitiveHash, CaseInsensitiveEqual>;
+        Run("result = { Key = 1, other = 2 }");
+        auto v = Result().To<TestType>();
+        ASSERT_EQ(v.size(), 2u);
+        ASSERT_EQ(v.at("KEY"), 1);
+    }
+
+    {
+        StackTopRestorer rst{ l };
+        Run(R"(
+            result = {}
+            for i = 1, 5000 do
+                result["route" .. i] = i
+            end
+            for i = 1, 100 do
+                result[i] = -i
+            end
+        )");
+        auto v = Result().To<unordered_map<string, int>>();
+        ASSERT_EQ(v.size(), 5100u);
+        ASSERT_EQ(v.at("route4999"), 4999);
+        ASSERT_EQ(v.at("100"), -100);
+    }
+
+    {
+        StackTopRestorer rst{ l };
+        Run("result = { b = 2, a = 1, c = 3 }");
+        auto v = Result().To<SortedPairs>();
+        ASSERT_EQ(v.items.size(), 3u);
+        ASSERT_EQ(v.items[0].first, "a");
+        ASSERT_EQ(v.items[2].second, 3);
+        PushValue(l, v);
+        ASSERT_EQ((GetValue<map<string, int>>(l, -1).at("b")), 2);
+    }
+}
+
+TEST_F(STDContainersTests, SetTests)
+{
+    using namespace LTL;
+    using namespace std;
+
+    {
+        StackTopRestorer rst{ l };
+        using TestType = set<int>;
+        TestType v1 = { 1, 5, 7 };
+        PushValue(l, v1);
+        ASSERT_EQ(GetValue<TestType>(l, -1), v1);
+        lua_rawgeti(l, -1, 5);
+        ASSERT_TRUE(lua_toboolean(l, -1));
+    }
+
+    {
+        StackTopRestorer rst{ l };
+        Run("result = { red = true, green = false, blue = 1 }");
+        auto v = Result().To<unordered_set<string>>();
+        ASSERT_EQ(v, (unordered_set<string>{ "red", "blue" }));
+    }
+}
+
 struct MultReturnTests :TestBase
 {
 
@@ -0,0 +1,106 @@
+#include "TestBase.hpp"
+#include <numeric>
+
+struct ScratchArenaTests : TestBase
+{
+
+};
+
+TEST_F(ScratchArenaTests, ContainerArguments)
+{
+    using namespace LTL;
+
+    static bool from_arena = false;
+    constexpr auto join = +[](ScratchArena* arena, const std::pmr::vector<std::pmr::string>& names)->int
+        {
+            from_arena = arena->IsActive()
+                && names.get_allocator().resource() == arena->Resource()
+                && (names.empty() || names[0].get_allocator().resource() == arena->Resource());
+            return std::accumulate(names.begin(), names.end(), 0, [](int n, const std::pmr::string& s) { return n + static_cast<int>(s.size()); });
+        };
+    RegisterFunction(l, "Join", CFunction<join, ScratchArena*, std::pmr::vector<std::pmr::string>>::Function);
+
+    Run("result = Join({ 'a', 'bb', 'ccc' })");
+    ASSERT_EQ(Result().To<int>(), 6);
+    ASSERT_TRUE(from_arena);
+    ASSERT_FALSE(ScratchArena::Get(l).IsActive());
+
+    constexpr auto count = +[](const std::pmr::unordered_map<std::pmr::string, int>& routes)
+        {
+            return static_cast<int>(routes.size());
+        };
+    RegisterFunction(l, "Count", CFunction<count, std::pmr::unordered_map<std::pmr::string, int>>::Function);
+    Run("result = Count({ a = 1, b = 2 })");
+    ASSERT_EQ(Result().To<int>(), 2);
+    ASSERT_EQ(Top(), 0);
+}
+
+TEST_F(ScratchArenaTests, ErrorInArguments)
+{
+    using namespace LTL;
+
+    constexpr auto sum = +[](ScratchArena* arena, const std::pmr::vector<int>& values)
+        {
+            return std::accumulate(values.begin(), values.end(), 0);
+        };
+    RegisterFunction(l, "Sum", CFunction<sum, ScratchArena*, std::pmr::vector<int>>::Function);
+
+    // ошибка Lua при чтении аргумента не должна оставлять память активной
+    ASSERT_THROW(Run("Sum({ 1, 'x' })"), Exception);
+    ASSERT_FALSE(ScratchArena::Get(l).IsActive());
+    ASSERT_THROW(Run("Sum(1)"), Exception);
+    ASSERT_FALSE(ScratchArena::Get(l).IsActive());
+
+    Run(R"(
+        local ok = pcall(Sum, { 'x' })
+        result = not ok and Sum({ 1, 2, 3 }) == 6
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+    ASSERT_FALSE(ScratchArena::Get(l).IsActive());
+
+    // ошибка, покинувшая сопрограмму, не закрывает ее стек
+    Run(R"(
+        co = coroutine.create(function() return Sum({ 'x' }) end)
+        local ok = coroutine.resume(co)
+        result = not ok and Sum({ 1, 2 }) == 3
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+    ASSERT_FALSE(ScratchArena::Get(l).IsActive());
+
+    Run(R"(
+        coroutine.close(co)
+        co = nil
+        result = Sum({ 4 }) == 4
+    )");
+    ASSERT_TRUE(Result().To<bool>());
+    ASSERT_FALSE(ScratchArena::Get(l).IsActive());
+    ASSERT_EQ(Top(), 0);
+}
+
+TEST_F(ScratchArenaTests, OutsideCall)
+{
+    using namespace LTL;
+
+    Run("result = { 1, 2, 3 }");
+    auto values = Result().To<std::pmr::vector<int>>();
+    ASSERT_EQ(values.size(), 3u);
+    ASSERT_EQ(values.get_allocator().resource(), std::pmr::get_default_resource());
+}
+
+TEST_F(ScratchArenaTests, Growth)
+{
+    using namespace LTL;
+
+    constexpr auto fill = +[](ScratchArena* arena, int n)
+        {
+            std::pmr::vector<double> values{ arena->Allocator<double>() };
+            values.resize(n);
+            return static_cast<int>(values.size());
+        };
+    RegisterFunction(l, "Fill", CFunction<fill, ScratchArena*, int>::Function);
+
+    const size_t initial = ScratchArena::Get(l).Capacity();
+    Run("Fill(100000)");
+    ASSERT_GT(ScratchArena::Get(l).Capacity(), initial);
+    ASSERT_LE(ScratchArena::Get(l).Capacity(), ScratchArena::MaxCapacity);
+}
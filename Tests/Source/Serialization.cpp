@@ -0,0 +1,218 @@
+#include "TestBase.hpp"
+
+struct SerializationTests : TestBase
+{
+
+};
+
+struct SerializedVector
+{
+    float x, y, z;
+
+    SerializedVector(float x, float y, float z) :x(x), y(y), z(z) {}
+};
+
+template<>
+struct LTL::UserDataSerializer<SerializedVector>
+{
+    static void Write(BinaryWriter& w, const SerializedVector& v)
+    {
+        w.WriteNumber(v.x);
+        w.WriteNumber(v.y);
+        w.WriteNumber(v.z);
+    }
+
+    static SerializedVector Read(BinaryReader& r)
+    {
+        float x = static_cast<float>(r.ReadNumber());
+        float y = static_cast<float>(r.ReadNumber());
+        float z = static_cast<float>(r.ReadNumber());
+        return { x, y, z };
+    }
+};
+
+TEST_F(SerializationTests, Values)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Run(R"(
+        value = {
+            1, 2.5, "three", true, false,
+            name = "name",
+            nested = { a = 1, b = { "name", "name" } },
+            [10] = -100,
+            [0.5] = math.maxinteger,
+        }
+    )");
+
+    lua_getglobal(l, "value");
+    string bytes = Serialize(StackObjectView{ l });
+    lua_pop(l, 1);
+    ASSERT_EQ(Top(), 0);
+
+    State s;
+    s.ThrowExceptions();
+    lua_State* other = s.GetState()->Unwrap();
+    Deserialize(other, bytes);
+    lua_setglobal(other, "value");
+    ASSERT_EQ(lua_gettop(other), 0);
+
+    auto value = s.GetGlobal("value");
+    ASSERT_EQ(value[1].To<int>(), 1);
+    ASSERT_EQ(value[2].To<double>(), 2.5);
+    ASSERT_EQ(value[3].To<string>(), "three");
+    ASSERT_TRUE(value[4].To<bool>());
+    ASSERT_TRUE(value[5].Is<bool>());
+    ASSERT_FALSE(value[5].To<bool>());
+    ASSERT_EQ(value["name"].To<string>(), "name");
+    ASSERT_EQ(value["nested"]["a"].To<int>(), 1);
+    ASSERT_EQ(value["nested"]["b"][2].To<string>(), "name");
+    ASSERT_EQ(value[10].To<int>(), -100);
+    ASSERT_EQ(value[0.5].To<long long>(), LUA_MAXINTEGER);
+    ASSERT_EQ(value.RawLen(), 5u);
+}
+
+TEST_F(SerializationTests, SharedAndCycles)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Run(R"(
+        local shared = { x = 1 }
+        value = { a = shared, b = shared }
+        value.self = value
+    )");
+
+    lua_getglobal(l, "value");
+    string bytes = Serialize(StackObjectView{ l });
+    lua_pop(l, 1);
+
+    Deserialize(l, bytes);
+    lua_setglobal(l, "copy");
+    Run("result = copy.a == copy.b and copy.self == copy and copy ~= value and copy.a.x == 1");
+    ASSERT_TRUE(Result().To<bool>());
+}
+
+TEST_F(SerializationTests, LongStrings)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Run(R"(
+        local a = string.rep("x", 64)
+        local b = string.rep("x", 32) .. string.rep("x", 32)
+        value = { a, b, [a] = b }
+    )");
+
+    lua_getglobal(l, "value");
+    string bytes = Serialize(StackObjectView{ l });
+    lua_pop(l, 1);
+
+    const string text(64, 'x');
+    const size_t first = bytes.find(text);
+    ASSERT_NE(first, string::npos);
+    ASSERT_EQ(bytes.find(text, first + 1), string::npos);
+
+    Deserialize(l, bytes);
+    lua_setglobal(l, "copy");
+    Run("result = copy[1] == string.rep('x', 64) and copy[2] == copy[1] and copy[copy[1]] == copy[1]");
+    ASSERT_TRUE(Result().To<bool>());
+    ASSERT_EQ(Top(), 0);
+}
+
+TEST_F(SerializationTests, UserData)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Class<SerializedVector>(l, "Vector")
+        .AddConstructor<float, float, float>()
+        .Add("x", AProperty<&SerializedVector::x>{});
+
+    UserDataCodecs codecs;
+    codecs.Add<SerializedVector>();
+
+    Run("value = { Vector(1, 2, 3) }");
+    lua_getglobal(l, "value");
+    string bytes = Serialize(StackObjectView{ l }, codecs);
+    lua_pop(l, 1);
+
+    Deserialize(l, bytes, codecs);
+    lua_setglobal(l, "copy");
+    Run("result = copy[1].x");
+    ASSERT_FLOAT_EQ(Result().To<float>(), 1.f);
+    Run("result = copy[1] ~= value[1]");
+    ASSERT_TRUE(Result().To<bool>());
+
+    lua_getglobal(l, "value");
+    ASSERT_THROW(Serialize(StackObjectView{ l }), Exception);
+    lua_pop(l, 1);
+}
+
+TEST_F(SerializationTests, Errors)
+{
+    using namespace LTL;
+    using namespace std;
+
+    Run("value = { f = print }");
+    lua_getglobal(l, "value");
+    ASSERT_THROW(Serialize(StackObjectView{ l }), Exception);
+    lua_pop(l, 1);
+    ASSERT_EQ(Top(), 0);
+
+    lua_pushinteger(l, 12345);
+    string bytes = Serialize(StackObjectView{ l });
+    lua_pop(l, 1);
+
+    ASSERT_THROW(Deserialize(l, bytes.substr(0, bytes.size() - 1)), Exception);
+    ASSERT_THROW(Deserialize(l, bytes + "x"), Exception);
+    ASSERT_THROW(Deserialize(l, ""), Exception);
+    ASSERT_EQ(Top(), 0);
+
+    Deserialize(l, bytes);
+    ASSERT_EQ(GetValue<int>(l, -1), 12345);
+    lua_pop(l, 1);
+}
+
+TEST_F(SerializationTests, Depth)
+{
+    using namespace LTL;
+    using namespace std;
+
+    // 3 байта на уровень: тег таблицы, один элемент массива, ноль ключей
+    string crafted(1, static_cast<char>(Internal::SerializationVersion));
+    for (int i = 0; i < 100000; i++)
+    {
+        crafted += string("\x07\x01\x00", 3);
+    }
+    crafted.push_back('\x00');
+    ASSERT_THROW(Deserialize(l, crafted), Exception);
+    ASSERT_EQ(Top(), 0);
+
+    Run(R"(
+        deep = {}
+        local t = deep
+        for i = 1, 300 do
+            t[1] = {}
+            t = t[1]
+        end
+        shallow = {}
+        t = shallow
+        for i = 1, 100 do
+            t[1] = {}
+            t = t[1]
+        end
+    )");
+    lua_getglobal(l, "deep");
+    ASSERT_THROW(Serialize(StackObjectView{ l }), Exception);
+    lua_pop(l, 1);
+
+    lua_getglobal(l, "shallow");
+    string bytes = Serialize(StackObjectView{ l });
+    lua_pop(l, 1);
+    Deserialize(l, bytes);
+    ASSERT_TRUE(lua_istable(l, -1));
+    lua_pop(l, 1);
+    ASSERT_EQ(Top(), 0);
+}
@@ -36,4 +36,222 @@ TEST_F(StateTests, AllocTest)
     ASSERT_TRUE(s.GetGlobal("result").Is<int>());
     ASSERT_EQ(s.GetGlobal("result").To<int>(), 4);
 
-}
\ No newline at end of file
+}
+
+TEST_F(StateTests, ExecutionBudget)
+{
+    using namespace LTL;
+
+    State s;
+    s.OpenLibs();
+    s.Run(R"(
+        function Forever()
+            while true do end
+        end
+
+        function Sum(n)
+            local r = 0
+            for i = 1, n do r = r + i end
+            return r
+        end
+
+        function Protected()
+            local ok = pcall(Forever)
+            while true do end
+        end
+    )");
+
+    {
+        auto r = s.PCall(ExecutionBudget::Instructions(10000), "Forever");
+        ASSERT_EQ(r, PCallResult::ERRBUDGET);
+        ASSERT_FALSE(r.IsOk());
+    }
+    {
+        auto r = s.PCall(ExecutionBudget::For(std::chrono::milliseconds(20)), "Forever");
+        ASSERT_EQ(r, PCallResult::ERRBUDGET);
+    }
+    {
+        auto r = s.PCall(ExecutionBudget::Instructions(10000), "Protected");
+        ASSERT_EQ(r, PCallResult::ERRBUDGET);
+    }
+    {
+        auto r = s.PCall<int>(ExecutionBudget::Instructions(100000), "Sum", 10);
+        ASSERT_TRUE(r.IsOk());
+        ASSERT_EQ(r.result.value(), 55);
+    }
+    {
+        auto r = s.PCall<int>(ExecutionBudget{}, "Sum", 10);
+        ASSERT_TRUE(r.IsOk());
+        ASSERT_EQ(r.result.value(), 55);
+    }
+    {
+        auto r = s.PCall(ExecutionBudget::Instructions(10), "error");
+        ASSERT_EQ(r, PCallResult::ERRRUN);
+    }
+
+    lua_State* l = s.GetState()->Unwrap();
+    lua_settop(l, 0);
+    ASSERT_EQ(lua_gethook(l), nullptr);
+    ASSERT_EQ(lua_gethookmask(l), 0);
+
+    ASSERT_EQ(s.GetState()->DoString("while true do end", ExecutionBudget::Instructions(1000)), PCallResult::ERRBUDGET);
+    lua_settop(l, 0);
+    ASSERT_EQ(s.GetState()->DoString("x = 1", ExecutionBudget::Instructions(1000)), PCallResult::Ok);
+    ASSERT_EQ(s.GetGlobal("x").To<int>(), 1);
+}
+
+TEST_F(StateTests, ExecutionBudgetCoroutines)
+{
+    using namespace LTL;
+
+    State s;
+    s.OpenLibs();
+    s.Run(R"(
+        function Workers()
+            while true do
+                local co = coroutine.create(function()
+                    while true do coroutine.yield() end
+                end)
+                for i = 1, 10 do coroutine.resume(co) end
+            end
+        end
+
+        function Swallow()
+            local co = coroutine.create(function() while true do end end)
+            swallowed = not coroutine.resume(co)
+            while true do end
+        end
+
+        function Spawn()
+            leftover = coroutine.create(function(n)
+                local r = 0
+                for i = 1, n do r = r + i end
+                return r
+            end)
+        end
+    )");
+
+    {
+        auto r = s.PCall(ExecutionBudget::Instructions(100000), "Workers");
+        ASSERT_EQ(r, PCallResult::ERRBUDGET);
+    }
+    {
+        auto r = s.PCall(ExecutionBudget::For(std::chrono::milliseconds(20)), "Workers");
+        ASSERT_EQ(r, PCallResult::ERRBUDGET);
+    }
+    {
+        auto r = s.PCall(ExecutionBudget::Instructions(100000), "Swallow");
+        ASSERT_EQ(r, PCallResult::ERRBUDGET);
+        ASSERT_TRUE(s.GetGlobal("swallowed").To<bool>());
+    }
+
+    ASSERT_EQ(s.PCall(ExecutionBudget::Instructions(100000), "Spawn"), PCallResult::Ok);
+    lua_State* l = s.GetState()->Unwrap();
+    lua_settop(l, 0);
+    s.Run("ok, sum = coroutine.resume(leftover, 1000000)");
+    ASSERT_TRUE(s.GetGlobal("ok").To<bool>());
+    ASSERT_EQ(s.GetGlobal("sum").To<lua_Integer>(), lua_Integer{ 500000500000 });
+
+    lua_getglobal(l, "leftover");
+    ASSERT_EQ(lua_gethook(lua_tothread(l, -1)), nullptr);
+    lua_pop(l, 1);
+
+    // обработчик ошибок исполняется после исчерпания бюджета
+    s.Run("function Handler(m) return 'handled: ' .. tostring(m) end");
+    lua_getglobal(l, "Handler");
+    lua_getglobal(l, "Workers");
+    ASSERT_EQ(PCallWithBudget(l, 0, 0, ExecutionBudget::Instructions(10000), 1), PCallResult::ERRBUDGET);
+    lua_settop(l, 0);
+    ASSERT_EQ(lua_gethook(l), nullptr);
+}
+
+TEST_F(StateTests, ExecutionBudgetExistingCoroutines)
+{
+    using namespace LTL;
+
+    State s;
+    s.OpenLibs();
+    // корутины созданы до вызова с бюджетом
+    s.Run(R"(
+        loop = coroutine.create(function() while true do end end)
+        wrapped = coroutine.wrap(function() while true do end end)
+        keeper = coroutine.create(function() while true do coroutine.yield() end end)
+
+        function ResumeLoop()
+            local resume = coroutine.resume
+            local ok = resume(loop)
+            return ok
+        end
+
+        function CallWrapped()
+            wrapped()
+        end
+
+        function ResumeKeeper()
+            for i = 1, 10 do coroutine.resume(keeper) end
+        end
+    )");
+    lua_State* l = s.GetState()->Unwrap();
+
+    ASSERT_EQ(s.PCall(ExecutionBudget::Instructions(100000), "ResumeLoop"), PCallResult::ERRBUDGET);
+    lua_settop(l, 0);
+    ASSERT_EQ(s.PCall(ExecutionBudget::For(std::chrono::milliseconds(20)), "CallWrapped"), PCallResult::ERRBUDGET);
+    lua_settop(l, 0);
+
+    // хук пользователя в корутине восстанавливается после снятия бюджета
+    constexpr lua_Hook user_hook = +[](lua_State*, lua_Debug*) {};
+    lua_getglobal(l, "keeper");
+    lua_State* const keeper = lua_tothread(l, -1);
+    lua_pop(l, 1);
+    lua_sethook(keeper, user_hook, LUA_MASKCOUNT, 1000000);
+
+    ASSERT_EQ(s.PCall(ExecutionBudget::Instructions(100000), "ResumeKeeper"), PCallResult::Ok);
+    ASSERT_EQ(lua_gethook(keeper), user_hook);
+    ASSERT_EQ(lua_gethookmask(keeper), LUA_MASKCOUNT);
+    ASSERT_EQ(lua_gethookcount(keeper), 1000000);
+    ASSERT_EQ(lua_gethook(l), nullptr);
+}
+
+TEST_F(StateTests, CallBatch)
+{
+    using namespace LTL;
+    using namespace std;
+
+    State s;
+    s.ThrowExceptions();
+    s.OpenLibs();
+    s.Run(R"(
+        function Mul(a, b) return a * b end
+        function Square(a) return a * a end
+        function Check(a)
+            if a < 0 then error("negative") end
+            return a
+        end
+        count = 0
+        function Count(a) count = count + a end
+    )");
+    lua_State* l = s.GetState()->Unwrap();
+
+    vector<tuple<int, int>> pairs{ { 1, 2 }, { 3, 4 }, { 5, 6 } };
+    ASSERT_EQ(s.CallBatch<int>("Mul", pairs), (vector<int>{ 2, 12, 30 }));
+    ASSERT_EQ(s.CallBatch<int>("Square", vector<int>{ 1, 2, 3 }), (vector<int>{ 1, 4, 9 }));
+    s.CallBatch("Count", vector<int>{ 1, 2, 3 });
+    ASSERT_EQ(s.GetGlobal("count").To<int>(), 6);
+    ASSERT_EQ(lua_gettop(l), 0);
+
+    auto results = s.PCallBatch<int>("Check", vector<int>{ 1, -2, 3 });
+    ASSERT_EQ(results.size(), 3);
+    ASSERT_TRUE(results[0].IsOk());
+    ASSERT_EQ(results[0].result.value(), 1);
+    ASSERT_EQ(results[1], PCallResult::ERRRUN);
+    ASSERT_EQ(results[2].result.value(), 3);
+    ASSERT_EQ(lua_gettop(l), 0);
+
+    ASSERT_THROW(s.CallBatch<int>("Check", vector<int>{ 1, -2, 3 }), Exception);
+    lua_settop(l, 0);
+
+    auto mul = s.GetGlobal("Mul");
+    ASSERT_EQ(mul.CallBatch<int>(vector<pair<int, int>>{ { 2, 2 }, { 3, 3 } }), (vector<int>{ 4, 9 }));
+    ASSERT_EQ(mul.PCallBatch<int>(pairs).size(), 3);
+    ASSERT_EQ(lua_gettop(l), 0);
+}
@@ -784,3 +784,809 @@ TEST_F(UserDataTests, TestMetaMethodsSet)
 
 
 
+
+TEST_F(UserDataTests, FinalizeTest)
+{
+    struct MyClass
+    {
+        MyClass() = default;
+        MyClass(int a, int b) :a(a), b(b) {}
+
+        int a = 0;
+        int b = 0;
+
+        int Sum()const noexcept { return a + b; }
+        int Diff()const noexcept { return a - b; }
+    };
+    using namespace LTL;
+
+    const std::string long_name(64, 'x');
+    Class<MyClass>(l, "Class")
+        .AddConstructor<int, int>()
+        .Add("a", AProperty<&MyClass::a>{})
+        .Add("b", AGetter<&MyClass::b>{})
+        .Add("Sum", Method<&MyClass::Sum>{})
+        .Add(long_name.c_str(), Method<&MyClass::Diff>{})
+        .Finalize()
+        ;
+    ASSERT_EQ(0, lua_gettop(l));
+    ASSERT_TRUE(Internal::FrozenIndex<MyClass>::IsBuilt(l));
+
+    Run(R"===(
+    local u = Class(4, 5)
+    u.a = 10
+    result = u.a == 10 and u.b == 5 and u:Sum() == 15 and u.Sum == u.Sum
+        and u[")===" + long_name + R"===("](u) == 5 and u.missing == nil and u[1] == nil
+    )===");
+    ASSERT_TRUE(Result().To<bool>());
+    ASSERT_THROW(Run("Class(1, 2).b = 3"), Exception);
+
+    Class<MyClass>(l, "Class")
+        .Add("Diff", Method<&MyClass::Diff>{});
+    ASSERT_FALSE(Internal::FrozenIndex<MyClass>::IsBuilt(l));
+
+    Run("result = Class(4, 5):Diff() == -1 and Class(1, 2).a == 1");
+    ASSERT_TRUE(Result().To<bool>());
+    ASSERT_EQ(0, lua_gettop(l));
+}
+
+struct Animal
+{
+    Animal(int legs) :legs(legs) {}
+
+    int legs = 0;
+
+    int Legs()const noexcept { return legs; }
+    int Speak()const noexcept { return 1; }
+};
+
+struct Dog : Animal
+{
+    Dog() :Animal(4) {}
+    virtual ~Dog() = default;
+
+    int tricks = 0;
+
+    void Learn() noexcept { tricks++; }
+    int Speak()const noexcept { return 2; }
+};
+
+struct Puppy : Dog
+{
+    int age = 1;
+};
+
+TEST_F(UserDataTests, InheritanceTest)
+{
+    using namespace LTL;
+
+    constexpr auto feed = +[](Animal* animal) { return animal->legs; };
+    RegisterFunction(l, "Feed", CFunction<feed, UserData<Animal>>::Function);
+
+    Class<Animal>(l, "Animal")
+        .AddConstructor<int>()
+        .Add("legs", AProperty<&Animal::legs>{})
+        .Add("Legs", Method<&Animal::Legs>{})
+        .Add("Speak", Method<&Animal::Speak>{})
+        ;
+    Class<Dog>(l, "Dog")
+        .AddConstructor<>()
+        .Add("Speak", Method<&Dog::Speak>{})
+        .Inherits<Animal>()
+        .Add("Learn", Method<&Dog::Learn>{})
+        .Add("tricks", AGetter<&Dog::tricks>{})
+        ;
+    Class<Puppy>(l, "Puppy")
+        .AddConstructor<>()
+        .Inherits<Dog>()
+        .Add("age", AGetter<&Puppy::age>{})
+        .Finalize()
+        ;
+    ASSERT_EQ(0, lua_gettop(l));
+    ASSERT_NE(UserData<Dog>::GetType().offsets[0], 0);
+
+    Run(R"===(
+    local a, d, p = Animal(6), Dog(), Puppy()
+    d:Learn()
+    p.legs = 3
+    result = a:Legs() == 6 and a:Speak() == 1 and Feed(a) == 6
+        and d:Legs() == 4 and d:Speak() == 2 and d.tricks == 1 and Feed(d) == 4
+        and p:Legs() == 3 and p.legs == 3 and p:Speak() == 2 and p.age == 1 and Feed(p) == 3
+        and Animal(1).Legs(p) == 3 and d.Learn(p) == nil and p.tricks == 1
+    )===");
+    ASSERT_TRUE(Result().To<bool>());
+
+    ASSERT_THROW(Run("Dog().Learn(Animal(2))"), Exception);
+    ASSERT_THROW(Run("Puppy().age = 2"), Exception);
+
+    Run("result = Puppy()");
+    auto puppy = Result();
+    ASSERT_TRUE(puppy.Is<UserData<Animal>>());
+    puppy.Push();
+    ASSERT_FALSE(UserData<Animal>::IsUserData(l, -1));
+    ASSERT_TRUE(UserData<Animal>::IsInstance(l, -1));
+    ASSERT_EQ(UserData<Animal>::ValidateUserData(l, -1), static_cast<Animal*>(UserData<Puppy>::ValidateUserData(l, -1)));
+    lua_pop(l, 1);
+    ASSERT_EQ(0, lua_gettop(l));
+}
+
+template<int N>
+struct Level : Level<N - 1>
+{
+    int value = N;
+};
+
+template<>
+struct Level<0>
+{
+    int value = 0;
+};
+
+template<int ...N>
+void RegisterLevels(lua_State* l, std::integer_sequence<int, N...>)
+{
+    using namespace LTL;
+    (Class<Level<N + 1>>(l, ("Level" + std::to_string(N + 1)).c_str()).template Inherits<Level<N>>(), ...);
+}
+
+TEST_F(UserDataTests, InheritanceDepthTest)
+{
+    using namespace LTL;
+
+    constexpr int max_depth = static_cast<int>(Internal::ClassType::MaxDepth);
+    Class<Level<0>>(l, "Level0");
+    RegisterLevels(l, std::make_integer_sequence<int, max_depth - 1>{});
+    ASSERT_EQ(UserData<Level<max_depth - 1>>::GetType().depth, Internal::ClassType::MaxDepth - 1);
+    lua_settop(l, 0);
+
+    ASSERT_THROW(Class<Level<max_depth>>(l, "TooDeep").Inherits<Level<max_depth - 1>>(), Exception);
+    ASSERT_EQ(UserData<Level<max_depth>>::GetType().depth, 0u);
+}
+
+struct Engine
+{
+    int power = 0;
+    int refs = 0;
+
+    int Power()const noexcept { return power; }
+    void Boost(int value) noexcept { power += value; }
+};
+
+/// @brief Указатель с интрузивным счетчиком ссылок в Engine::refs
+struct EnginePtr
+{
+    EnginePtr(Engine* engine) :engine(engine) { engine->refs++; }
+    EnginePtr(const EnginePtr& other) :EnginePtr(other.engine) {}
+    ~EnginePtr() { engine->refs--; }
+
+    Engine* get()const noexcept { return engine; }
+
+    Engine* engine;
+};
+
+TEST_F(UserDataTests, HolderTest)
+{
+    using namespace LTL;
+
+    constexpr auto make = +[](int power) { return std::make_unique<Engine>(Engine{ power }); };
+    constexpr auto take = +[](std::unique_ptr<Engine>& engine) { return engine->power; };
+    RegisterFunction(l, "Make", CFunction<make, int>::Function);
+    RegisterFunction(l, "Take", CFunction<take, std::unique_ptr<Engine>>::Function);
+
+    Class<Engine>(l, "Engine")
+        .AddConstructor<>()
+        .Add("power", AGetter<&Engine::power>{})
+        .Add("Power", Method<&Engine::Power>{})
+        .Add("Boost", Method<&Engine::Boost, int>{})
+        ;
+
+    auto shared = std::make_shared<Engine>(Engine{ 5 });
+    PushValue(l, shared);
+    lua_setglobal(l, "shared");
+    ASSERT_EQ(shared.use_count(), 2);
+
+    Run(R"===(
+    shared:Boost(2)
+    local unique = Make(10)
+    unique:Boost(1)
+    local power = Take(unique)
+    result = shared:Power() == 7 and shared.power == 7 and power == 11
+        and Engine():Power() == 0 and not pcall(unique.Power, unique)
+    )===");
+    ASSERT_TRUE(Result().To<bool>());
+    ASSERT_EQ(shared->power, 7);
+    ASSERT_THROW(Run("Take(Engine())"), Exception);
+
+    Engine engine{ 3 };
+    UserData<Engine, EnginePtr>::Push(l, EnginePtr{ &engine });
+    ASSERT_EQ(engine.refs, 1);
+    ASSERT_TRUE(UserData<Engine>::IsInstance(l, -1));
+    ASSERT_FALSE(UserData<Engine>::IsUserData(l, -1));
+    ASSERT_EQ(UserData<Engine>::ValidateUserData(l, -1), &engine);
+    ASSERT_FALSE(StackType<std::shared_ptr<Engine>>::Check(l, -1));
+    lua_pop(l, 1);
+
+    Run("shared = nil");
+    lua_gc(l, LUA_GCCOLLECT);
+    ASSERT_EQ(shared.use_count(), 1);
+    ASSERT_EQ(engine.refs, 0);
+
+    // указатели освобождаются своими финализаторами, Engine по-прежнему без __gc
+    UserData<Engine>::MetaTable::Push(l);
+    ASSERT_EQ(lua_getfield(l, -1, "__gc"), LUA_TNIL);
+    lua_pop(l, 2);
+
+    UserData<Engine, EnginePtr>::Push(l, EnginePtr{ &engine });
+    ASSERT_EQ(engine.refs, 1);
+    lua_close(l);
+    l = nullptr;
+    ASSERT_EQ(engine.refs, 0);
+}
+
+TEST_F(UserDataTests, HolderArgumentErrorTest)
+{
+    using namespace LTL;
+
+    constexpr auto make = +[](int power) { return std::make_unique<Engine>(Engine{ power }); };
+    constexpr auto install = +[](std::unique_ptr<Engine>& engine, int slot) { return engine->power + slot; };
+    constexpr auto swap = +[](int slot, std::unique_ptr<Engine>& a, std::unique_ptr<Engine>& b) { return a->power + b->power + slot; };
+    RegisterFunction(l, "Make", CFunction<make, int>::Function);
+    RegisterFunction(l, "Install", CFunction<install, std::unique_ptr<Engine>, int>::Function);
+    RegisterFunction(l, "Swap", CFunction<swap, int, std::unique_ptr<Engine>, std::unique_ptr<Engine>>::Function);
+
+    Class<Engine>(l, "Engine")
+        .AddConstructor<>()
+        .Add("Power", Method<&Engine::Power>{})
+        ;
+
+    // ошибка в аргументе после std::unique_ptr не забирает объект у Lua
+    Run(R"===(
+    local engine = Make(4)
+    local ok = pcall(Install, engine, "slot")
+    local other = Make(5)
+    local swapped = pcall(Swap, 1, engine, Engine())
+    result = not ok and engine:Power() == 4
+        and not swapped and other:Power() == 5 and engine:Power() == 4
+        and Install(engine, 2) == 6 and not pcall(engine.Power, engine)
+        and Swap(1, other, Make(1)) == 7
+    )===");
+    ASSERT_TRUE(Result().To<bool>());
+
+    // один объект двумя забирающими аргументами
+    Run(R"===(
+    local engine = Make(3)
+    local ok, err = pcall(Swap, 1, engine, engine)
+    result = not ok and err:find("another owning argument") ~= nil and engine:Power() == 3
+    )===");
+    ASSERT_TRUE(Result().To<bool>());
+    ASSERT_EQ(0, lua_gettop(l));
+}
+
+struct Payload
+{
+    static inline int copies = 0;
+
+    Payload(int size) :data(size, 1) {}
+    Payload(const Payload& other) :data(other.data) { copies++; }
+    Payload(Payload&&) = default;
+
+    std::vector<int> data;
+
+    int Size()const noexcept { return static_cast<int>(data.size()); }
+    Payload Grown(int n)const { return Payload(Size() + n); }
+};
+
+TEST_F(UserDataTests, MoveResultTest)
+{
+    using namespace LTL;
+
+    constexpr auto make = +[](int size) { return Payload(size); };
+    constexpr auto make_many = +[](int n)
+        {
+            std::vector<std::unique_ptr<Payload>> result;
+            for (int i = 1; i <= n; i++)
+            {
+                result.push_back(std::make_unique<Payload>(i));
+            }
+            return result;
+        };
+    constexpr auto make_pair = +[]() -> MultReturn<std::unique_ptr<Payload>, int>
+        {
+            return { std::make_unique<Payload>(7), 7 };
+        };
+    RegisterFunction(l, "Make", CFunction<make, UserData<Payload>(int)>::Function);
+    RegisterFunction(l, "MakeMany", CFunction<make_many, int>::Function);
+    RegisterFunction(l, "MakePair", CFunction<make_pair>::Function);
+
+    Class<Payload>(l, "Payload")
+        .Add("Size", Method<&Payload::Size>{})
+        .Add("Grown", Method<&Payload::Grown, Payload(int)>{})
+        ;
+
+    Payload::copies = 0;
+    Run(R"===(
+    local p = Make(1000)
+    local g = p:Grown(24)
+    local many = MakeMany(3)
+    local q, n = MakePair()
+    result = p:Size() == 1000 and g:Size() == 1024
+        and #many == 3 and many[3]:Size() == 3 and q:Size() == n
+    )===");
+    ASSERT_TRUE(Result().To<bool>());
+    ASSERT_EQ(Payload::copies, 0);
+    ASSERT_EQ(0, lua_gettop(l));
+}
+
+struct Position
+{
+    float x = 0;
+    float y = 0;
+};
+
+struct Transform
+{
+    Position position;
+    Position scale{ 1, 1 };
+};
+
+struct Body
+{
+    static inline int alive = 0;
+
+    Body() { alive++; }
+    ~Body() { alive--; }
+
+    Transform transform;
+};
+
+TEST_F(UserDataTests, ViewTest)
+{
+    using namespace LTL;
+
+    Class<Position>(l, "Position")
+        .AddConstructor<>()
+        .Add("x", AProperty<&Position::x>{})
+        .Add("y", AProperty<&Position::y>{})
+        ;
+    Class<Transform>(l, "Transform")
+        .Add("position", AView<&Transform::position>{})
+        .Add("scale", AView<&Transform::scale>{})
+        ;
+    Class<Body>(l, "Body")
+        .AddConstructor<>()
+        .Add("transform", AView<&Body::transform>{})
+        ;
+
+    Body::alive = 0;
+    Run(R"===(
+    local b = Body()
+    b.transform.position.x = 5
+    b.transform.scale.y = 3
+    position = b.transform.position
+    result = b.transform.position.x == 5 and b.transform.scale.y == 3 and b.transform.scale.x == 1
+    )===");
+    ASSERT_TRUE(Result().To<bool>());
+
+    lua_gc(l, LUA_GCCOLLECT);
+    ASSERT_EQ(Body::alive, 1);
+
+    Run("position.y = 2");
+    GRefObject::Global(l, "position").Push();
+    Position* position = UserData<Position>::ValidateUserData(l, -1);
+    ASSERT_EQ(position->x, 5);
+    ASSERT_EQ(position->y, 2);
+    lua_pop(l, 1);
+
+    Run("position = nil; result = nil");
+    lua_gc(l, LUA_GCCOLLECT);
+    ASSERT_EQ(Body::alive, 0);
+    ASSERT_EQ(0, lua_gettop(l));
+}
+
+struct Vec4
+{
+    float x = 0, y = 0, z = 0, w = 0;
+};
+
+struct alignas(32) Wide
+{
+    double values[4] = {};
+};
+
+TEST_F(UserDataTests, LayoutTest)
+{
+    using namespace LTL;
+
+    static_assert(Internal::UserDataLayout<Vec4>::Size == sizeof(Internal::UserDataHeader) + sizeof(Vec4));
+    static_assert(Internal::UserDataLayout<Wide>::OverAligned);
+
+    Class<Vec4>(l, "Vec4")
+        .AddConstructor<>()
+        .Add("x", AProperty<&Vec4::x>{})
+        ;
+    Class<Wide>(l, "Wide")
+        .AddConstructor<>()
+        ;
+
+    Run("result = Vec4()");
+    Result().Push();
+    ASSERT_EQ(lua_rawlen(l, -1), Internal::UserDataLayout<Vec4>::Size);
+    ASSERT_EQ(lua_getiuservalue(l, -1, 1), LUA_TNONE);
+    lua_pop(l, 1);
+    lua_getmetatable(l, -1);
+    ASSERT_EQ(lua_getfield(l, -1, "__gc"), LUA_TNIL);
+    lua_pop(l, 3);
+
+    for (int i = 0; i < 16; i++)
+    {
+        Wide* wide = UserData<Wide>::New(l);
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(wide) % alignof(Wide), 0u);
+        ASSERT_EQ(UserData<Wide>::ValidateUserData(l, -1), wide);
+        wide->values[3] = i;
+    }
+    lua_pop(l, 16);
+    ASSERT_EQ(0, lua_gettop(l));
+}
+
+struct Resource
+{
+    static inline int open = 0;
+
+    Resource() { open++; }
+    ~Resource() { open--; }
+
+    int Read()const noexcept { return 42; }
+};
+
+TEST_F(UserDataTests, CloseTest)
+{
+    using namespace LTL;
+
+    Class<Resource>(l, "Resource")
+        .AddConstructor<>()
+        .Add("Read", Method<&Resource::Read>{})
+        ;
+
+    Resource::open = 0;
+    Run(R"===(
+    local value
+    do
+        local r <close> = Resource()
+        value = r:Read()
+        leaked = r
+    end
+    result = value
+    )===");
+    ASSERT_EQ(Result().To<int>(), 42);
+    ASSERT_EQ(Resource::open, 0);
+    ASSERT_THROW(Run("leaked:Read()"), Exception);
+
+    UserData<Resource>::New(l);
+    ASSERT_EQ(Resource::open, 1);
+    ASSERT_TRUE(UserData<Resource>::Destroy(l, -1));
+    ASSERT_FALSE(UserData<Resource>::Destroy(l, -1));
+    ASSERT_EQ(Resource::open, 0);
+    lua_pop(l, 1);
+
+    Run("leaked = nil");
+    lua_gc(l, LUA_GCCOLLECT);
+    ASSERT_EQ(Resource::open, 0);
+    ASSERT_EQ(0, lua_gettop(l));
+}
+
+struct Actor
+{
+    int hp = 10;
+
+    int Hit(int damage) noexcept { return hp -= damage; }
+};
+
+struct Player : Actor {};
+
+TEST_F(UserDataTests, ExpandoTest)
+{
+    using namespace LTL;
+
+    Class<Actor>(l, "Actor")
+        .AddConstructor<>()
+        .Add("hp", AProperty<&Actor::hp>{})
+        .Add("Hit", Method<&Actor::Hit, int>{})
+        .EnableExpando()
+        ;
+    Class<Player>(l, "Player")
+        .AddConstructor<>()
+        .Inherits<Actor>()
+        ;
+
+    Run(R"===(
+    local a = Actor()
+    local b = Actor()
+    local empty = a.name == nil
+    a.name = "orc"
+    a.hp = 7
+    a.loot = { "sword" }
+    b.name = "elf"
+    a:Hit(2)
+    a.name = nil
+    local p = Player()
+    p.level = 3
+    result = empty and a.name == nil and b.name == "elf" and a.loot[1] == "sword"
+        and a.hp == 5 and p.level == 3 and p:Hit(1) == 9
+    )===");
+    ASSERT_TRUE(Result().To<bool>());
+
+    UserData<Actor>::New(l);
+    ASSERT_EQ(lua_getiuservalue(l, -1, 1), LUA_TNIL);
+    lua_pop(l, 2);
+
+    Class<Vector3f>(l, "Vector")
+        .AddConstructor<Default<float>, Default<float>, Default<float>>()
+        .Add("x", AProperty<&Vector3f::x>{})
+        ;
+    ASSERT_THROW(Run("Vector().tag = 1"), Exception);
+
+    lua_gc(l, LUA_GCCOLLECT);
+    ASSERT_EQ(0, lua_gettop(l));
+}
+
+struct Vec2
+{
+    double x = 0, y = 0;
+
+    Vec2() = default;
+    Vec2(double x, double y) :x(x), y(y) {}
+
+    Vec2 operator+(const Vec2& other)const { return { x + other.x, y + other.y }; }
+    Vec2 operator-(const Vec2& other)const { return { x - other.x, y - other.y }; }
+    Vec2 operator-()const { return { -x, -y }; }
+    Vec2 operator*(double k)const { return { x * k, y * k }; }
+    friend Vec2 operator*(double k, const Vec2& v) { return v * k; }
+    double operator*(const Vec2& other)const { return x * other.x + y * other.y; }
+    bool operator==(const Vec2& other)const { return x == other.x && y == other.y; }
+};
+
+TEST_F(UserDataTests, OperatorsTest)
+{
+    using namespace LTL;
+
+    static_assert(Internal::Operators<Vec2>::HasBinary<std::plus<>, lua_Number>);
+    static_assert(!Internal::Operators<Vec2>::HasBinary<std::divides<>, lua_Number>);
+    static_assert(!Internal::Operators<Vec2>::HasBinary<std::less<>, lua_Number>);
+
+    constexpr auto sub = +[](const Vec2&, const Vec2&) { return 100.0; };
+    Class<Vec2>(l, "Vec2")
+        .AddConstructor<Default<double>, Default<double>>()
+        .Add("x", AProperty<&Vec2::x>{})
+        .Add("y", AProperty<&Vec2::y>{})
+        .Add(MetaMethods::sub, CFunction<sub, UserData<Vec2>, UserData<Vec2>>{})
+        .AddOperators()
+        ;
+
+    Run(R"===(
+    local a = Vec2(1, 2)
+    local b = Vec2(3, 4)
+    local c = a + b
+    local d = 2 * a
+    local e = a * 3
+    local n = -a
+    result = c.x == 4 and c.y == 6 and d.x == 2 and d.y == 4 and e.y == 6
+        and n.x == -1 and a * b == 11 and a - b == 100
+        and a == Vec2(1, 2) and a ~= b and a ~= 1
+    )===");
+    ASSERT_TRUE(Result().To<bool>());
+
+    lua_getglobal(l, "Vec2");
+    lua_call(l, 0, 1);
+    lua_getmetatable(l, -1);
+    ASSERT_EQ(lua_getfield(l, -1, "__div"), LUA_TNIL);
+    ASSERT_EQ(lua_getfield(l, -2, "__lt"), LUA_TNIL);
+    lua_pop(l, 4);
+
+    ASSERT_THROW(Run("local v = Vec2() + 1"), Exception);
+    ASSERT_THROW(Run("local v = Vec2() * 'x'"), Exception);
+    ASSERT_EQ(0, lua_gettop(l));
+}
+
+struct Money
+{
+    static inline int alive = 0;
+
+    double amount = 0;
+
+    Money(double amount = 0) :amount(amount) { alive++; }
+    Money(const Money& other) :amount(other.amount) { alive++; }
+    ~Money() { alive--; }
+
+    Money operator/(double k)const
+    {
+        if (k == 0)
+            throw std::domain_error("division by zero");
+        return { amount / k };
+    }
+};
+
+TEST_F(UserDataTests, ThrowingOperatorsTest)
+{
+    using namespace LTL;
+
+    Class<Money>(l, "Money")
+        .AddConstructor<Default<double>>()
+        .Add("amount", AGetter<&Money::amount>{})
+        .AddOperators()
+        ;
+
+    // исключение оператора становится ошибкой Lua, а недостроенный результат не попадает в Lua
+    Run(R"===(
+    local m = Money(10)
+    local ok, err = pcall(function() return m / 0 end)
+    result = not ok and err:find("division by zero") ~= nil and (m / 4).amount == 2.5
+    )===");
+    ASSERT_TRUE(Result().To<bool>());
+    Run("result = nil");
+    lua_gc(l, LUA_GCCOLLECT);
+    ASSERT_EQ(Money::alive, 0);
+    ASSERT_EQ(0, lua_gettop(l));
+}
+
+Vec2 Lerp(const Vec2& a, const Vec2& b, double t)
+{
+    return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t };
+}
+
+TEST_F(UserDataTests, InPlaceTest)
+{
+    using namespace LTL;
+
+    Class<Vec2>(l, "Vec2")
+        .AddConstructor<Default<double>, Default<double>>()
+        .Add("x", AProperty<&Vec2::x>{})
+        .Add("y", AProperty<&Vec2::y>{})
+        .Add("add_to", MethodInto<&Vec2::operator+, Vec2>{})
+        .Add("lerp_to", FunctionInto<Lerp, Vec2, Vec2, Vec2, double>{})
+        .AddScratchPool("TempVec2", "Release")
+        ;
+
+    Run(R"===(
+    local p = Vec2(0, 0)
+    local v = Vec2(1, 2)
+    local same = p
+    for i = 1, 10 do
+        p:add_to(p, v)
+    end
+    local t = TempVec2()
+    t:lerp_to(p, Vec2(0, 0), 0.5)
+    local mid = t.y
+    t.x = 3
+    t:Release()
+    local reused = TempVec2()
+    result = same == p and p.x == 10 and p.y == 20 and mid == 10
+        and reused == t and reused.x == 0
+        and not pcall(function() t:Release(); t:Release() end)
+    )===");
+    ASSERT_TRUE(Result().To<bool>());
+    ASSERT_EQ(Internal::ScratchPool<Vec2>::Size(l), 1u);
+
+    ASSERT_THROW(Run("Vec2():add_to(1, Vec2())"), Exception);
+    ASSERT_EQ(0, lua_gettop(l));
+}
+
+struct Unit
+{
+    int x = 0;
+    int y = 0;
+    int hp = 100;
+};
+
+TEST_F(UserDataTests, DirtyTrackingTest)
+{
+    using namespace LTL;
+
+    Class<Unit>(l, "Unit")
+        .AddConstructor<>()
+        .Add("x", AProperty<&Unit::x>{})
+        .Add("y", AProperty<&Unit::y>{})
+        .EnableDirtyTracking()
+        .Add("hp", AProperty<&Unit::hp>{})
+        ;
+
+    const int x = DirtyTracker<Unit>::Bit(l, "x");
+    const int y = DirtyTracker<Unit>::Bit(l, "y");
+    const int hp = DirtyTracker<Unit>::Bit(l, "hp");
+    ASSERT_NE(x, -1);
+    ASSERT_NE(y, -1);
+    ASSERT_NE(hp, -1);
+    ASSERT_NE(x, y);
+    ASSERT_NE(hp, x);
+    ASSERT_NE(hp, y);
+
+    Run(R"===(
+    a = Unit()
+    b = Unit()
+    c = Unit()
+    a.x = 5
+    a.hp = 50
+    b.y = 7
+    local read = c.x + c.y
+    )===");
+
+    GRefObject::Global(l, "a").Push();
+    ASSERT_EQ(DirtyTracker<Unit>::GetMask(l, -1), (uint64_t{ 1 } << x) | (uint64_t{ 1 } << hp));
+    lua_pop(l, 1);
+
+    int visited = 0;
+    uint64_t all = 0;
+    DirtyTracker<Unit>::ForEachDirty(l, [&](Unit& unit, uint64_t mask)
+        {
+            visited++;
+            all |= mask;
+            if (mask & (uint64_t{ 1 } << y))
+            {
+                ASSERT_EQ(unit.y, 7);
+            }
+        });
+    ASSERT_EQ(visited, 2);
+    ASSERT_EQ(all, (uint64_t{ 1 } << x) | (uint64_t{ 1 } << y) | (uint64_t{ 1 } << hp));
+
+    visited = 0;
+    DirtyTracker<Unit>::ForEachDirty(l, [&](Unit&, uint64_t) { visited++; });
+    ASSERT_EQ(visited, 0);
+
+    Run("c.y = 1");
+    DirtyTracker<Unit>::Clear(l);
+    DirtyTracker<Unit>::ForEachDirty(l, [&](Unit&, uint64_t) { visited++; });
+    ASSERT_EQ(visited, 0);
+
+    ASSERT_THROW(Run("a.z = 1"), Exception);
+    ASSERT_EQ(0, lua_gettop(l));
+}
+
+TEST_F(UserDataTests, DirtyTrackingViewTest)
+{
+    using namespace LTL;
+
+    Class<Position>(l, "Position")
+        .AddConstructor<>()
+        .Add("x", AProperty<&Position::x>{})
+        .Add("y", AProperty<&Position::y>{})
+        ;
+    Class<Transform>(l, "Transform")
+        .Add("position", AView<&Transform::position>{})
+        .Add("scale", AView<&Transform::scale>{})
+        ;
+    Class<Body>(l, "Body")
+        .AddConstructor<>()
+        .Add("transform", AView<&Body::transform>{})
+        .EnableDirtyTracking()
+        ;
+
+    const int transform = DirtyTracker<Body>::Bit(l, "transform");
+    ASSERT_NE(transform, -1);
+
+    Run(R"===(
+    a = Body()
+    b = Body()
+    local position = a.transform.position
+    a.transform.position.x = 1
+    position.y = 2
+    local read = b.transform.scale.x
+    )===");
+
+    GRefObject::Global(l, "a").Push();
+    ASSERT_EQ(DirtyTracker<Body>::GetMask(l, -1), uint64_t{ 1 } << transform);
+    lua_pop(l, 1);
+
+    int visited = 0;
+    DirtyTracker<Body>::ForEachDirty(l, [&](Body& body, uint64_t mask)
+        {
+            visited++;
+            ASSERT_EQ(mask, uint64_t{ 1 } << transform);
+            ASSERT_EQ(body.transform.position.x, 1);
+            ASSERT_EQ(body.transform.position.y, 2);
+        });
+    ASSERT_EQ(visited, 1);
+
+    GRefObject::Global(l, "a").Push();
+    ASSERT_EQ(DirtyTracker<Body>::GetMask(l, -1), uint64_t{ 0 });
+    lua_pop(l, 1);
+    ASSERT_EQ(0, lua_gettop(l));
+}